@@ -0,0 +1,51 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "texture_data.h"
+
+// Pack file the game reads its textures and skyboxes from, written by --bake-assets.
+const char *const ASSET_PACK_PATH = "assets.pak";
+
+// One image in the pack: a 2D texture, or the six faces of a cube map in GL face order.
+// Every face holds a chain of levels, each the blocks glCompressedTexImage2D takes (or
+// tightly packed pixels for an uncompressed format), starting on a PACK_ALIGNMENT boundary.
+struct PackImage
+{
+	char name[120];
+	uint32_t faces;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levels;
+	// Internal format of the level data, and the pixel type when it is not compressed.
+	uint32_t format;
+	uint32_t type;
+	uint64_t offset;
+	uint64_t size;
+};
+
+// Baked textures and skyboxes in a single memory-mapped file. Levels are block-compressed and
+// uploaded straight out of the mapping, with no decoding and no mipmap generation.
+// Anything not in the pack is loaded from the loose files under assets/ as before.
+class AssetPack
+{
+private:
+	static const PackImage *find(const std::string &name);
+	static const unsigned char *level_data(const PackImage *image, GLuint face, GLuint level, size_t &size);
+	static bool load(const PackImage *image, TextureData &data);
+public:
+	static bool open(const std::string &path);
+	static void close();
+
+	// Point data at every level of the named texture or cube map, without copying. Return
+	// false if the pack does not have it, or the driver cannot sample its format.
+	static bool load_texture(const std::string &path, TextureData &data);
+	static bool load_cubemap(const std::string &directory, TextureData &data);
+
+	// Reads the given textures and skybox directories (faces named as in the skyboxes, in .ppm)
+	// and writes them BC1-compressed with their mip chains to path. Needs no GL context.
+	static bool bake(const std::string &path, const std::vector<std::string> &textures, const std::vector<std::string> &cubemaps);
+};
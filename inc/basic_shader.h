@@ -5,9 +5,18 @@
 class BasicShader :
 	public Shader
 {
+private:
+	// Uniform handles resolved once after linking.
+	GLint material_diffuse_loc, material_specular_loc, material_ambient_loc, material_shininess_loc;
+	GLint shadows_enabled_loc, texture_enabled_loc, texture_noise_loc, noise_loc;
+	GLint model_loc, normal_matrix_loc, instanced_loc, part_count_loc, multi_draw_loc;
+
+	void prepare(Geometry *g, glm::mat4 model, bool instanced);
 public:
 	BasicShader(GLuint shader_id);
 	void set_material(Material m);
 	void draw(Geometry *g, glm::mat4 to_world);
+	void draw_instanced(Geometry *g, const InstanceBatch &batch, glm::mat4 to_world);
+	bool batchable(Geometry *g);
+	void draw_multi(MultiDraw &batch);
 };
-
@@ -0,0 +1,25 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Axis-aligned bounds used for frustum culling.
+class BoundingBox
+{
+public:
+	glm::vec3 min_pt;
+	glm::vec3 max_pt;
+	bool empty;
+	bool infinite;
+
+	BoundingBox();
+	~BoundingBox();
+
+	void reset();
+	void expand(glm::vec3 p);
+	void expand(const BoundingBox &b);
+	void inflate(GLfloat amount);
+	BoundingBox transform(glm::mat4 m) const;
+	glm::vec3 center() const;
+	glm::vec3 extent() const;
+	GLfloat distance(glm::vec3 p) const;
+};
@@ -1,14 +1,20 @@
 #pragma once
 #include "scene.h"
+#include "scene_terrain.h"
 class DesertScene :
 	public Scene
 {
 private:
 	SceneTransform *map;
+
+	SceneTerrain *build_terrain(const HeightMap &map);
+	void place_map(SceneTerrain *terrain);
 public:
 	void generate_planes();
 	void generate_map();
+	void regenerate_map();
 
+	void prepare();
 	void setup();
 	GLfloat get_size();
 };
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+// Generates a height map, tree variants and buildings from a fixed seed and hashes the
+// result, once on the main thread alone and then on the job system. Generation touches no
+// GL, so this runs without a window; the procedural cache is left off so nothing is reused.
+class DeterminismCheck
+{
+private:
+	// Hash of everything generated from seed, with the job system as it is set up now.
+	static uint64_t generate(uint32_t seed);
+public:
+	// True if every parallel run matches the serial one.
+	static bool run();
+};
@@ -8,6 +8,7 @@ public:
 	void generate_map();
 	void generate_forest();
 
+	void prepare();
 	void setup();
 	GLfloat get_size();
 };
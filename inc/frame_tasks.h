@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Long generation split into resumable steps that run on the main thread between frames,
+// for when uploads have to stay on the GL context and no worker thread can help. A task is
+// a step function that keeps its progress in its captures: it is called again until it
+// returns true, and each call should only do a small, bounded piece of the work.
+class FrameTasks
+{
+public:
+	// Tasks run one after the other, in the order they were added.
+	static void add(std::function<bool()> step);
+	// Runs steps until budget seconds have passed, always at least one.
+	// Returns how many tasks are left.
+	static size_t process(double budget);
+	// Runs every task to completion, e.g. before something depends on their results.
+	static void flush();
+	static size_t pending();
+};
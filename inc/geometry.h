@@ -1,29 +1,44 @@
 #pragma once
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include <atomic>
 #include <vector>
 
-class Geometry
+#include "mesh_data.h"
+#include "geometry_arena.h"
+
+// Mesh data plus the arena range it is drawn from. Creating and filling one makes no GL
+// calls; upload() does, on the GL thread, usually through the UploadQueue, which hands the
+// buffers to the ResourceLoader when there is one. Nothing draws it until it is uploaded.
+class Geometry :
+	public MeshData
 {
 public:
-	bool has_texture;
-	bool has_normals;
-	bool add_texture_noise; //For Water Specifically
-	GLuint texture;
-	std::vector<glm::vec3> vertices;
-	std::vector<glm::vec3> normals;
-	std::vector<glm::vec2> tex_coords;
-	std::vector<GLuint> indices;	
-	GLenum draw_type = GL_TRIANGLES;
-	GLint wrap_type = GL_REPEAT;
-	GLint filter_type = GL_NEAREST_MIPMAP_LINEAR;
+	GLuint texture = 0;
+	bool uploaded = false;
+	// Where the vertices and indices live once uploaded.
+	GeometryArena *arena = nullptr;
+	ArenaRange range = {};
+	// Counter of the UploadQueue::Batch this was pushed in, until it is uploaded.
+	std::atomic<unsigned int> *batch = nullptr;
 
 	Geometry();
+	Geometry(MeshData data);
 	~Geometry();
-	void populate_buffers();
-	void attach_texture(const char *texture_loc);
+	void upload();
+	// Fills the arena on the loader's context; uploaded turns true once the data is on the GPU.
+	void upload_async();
+	void bind_attributes();
+	// An empty texture with its sampler state set.
+	static GLuint create_texture(GLint wrap_type, GLint filter_type);
+	// Always creates a new texture; share them through the TextureCache instead.
+	static GLuint load_texture(const char *texture_loc, GLint wrap_type, GLint filter_type);
 	void draw();
+	void draw_instanced(GLsizei count);
 	void bind();
 private:
-	GLuint VAO, VBO, NBO, TBO, EBO;
-};
\ No newline at end of file
+	bool loading = false;
+
+	void fill_buffers();
+	void finish_upload();
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <map>
+
+#include "vertex_format.h"
+
+// Attribute holding the index of a draw inside a multi-draw, fed by its base instance.
+const GLuint DRAW_INDEX_ATTRIBUTE = 9;
+// Draws a single multi-draw call can tell apart.
+const GLuint MAX_MULTI_DRAWS = 4096;
+
+// Where a mesh lives inside its arena.
+struct ArenaRange
+{
+	GLuint first_vertex;
+	GLuint num_vertices;
+	GLuint first_index;
+	GLuint num_indices;
+};
+
+// A large vertex buffer and index buffer that many meshes are suballocated from, drawn
+// through one VAO, so consecutive draws never switch vertex arrays and can be merged into
+// a single multi-draw. Every mesh in an arena shares its vertex format and index type.
+// Ranges are allocated on any GL context and freed on the main thread.
+class GeometryArena
+{
+private:
+	// Free ranges by start, coalesced as they are returned.
+	std::map<GLuint, GLuint> free_vertices, free_indices;
+
+	GeometryArena(const VertexFormat *format, GLenum index_type, GLuint vertex_capacity, GLuint index_capacity);
+	bool take(GLuint num_vertices, GLuint num_indices, ArenaRange &range);
+public:
+	GLuint vertex_buffer = 0, index_buffer = 0;
+	GLuint VAO = 0;
+	const VertexFormat *format;
+	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+	GLenum index_type;
+
+	~GeometryArena();
+
+	// Finds room, opening a new arena when none of the open ones has it.
+	static GeometryArena *allocate(const VertexFormat *format, GLenum index_type, GLuint num_vertices, GLuint num_indices, ArenaRange &range);
+	GLsizei index_size() const;
+	// Byte offset of an index, as draw calls take it.
+	GLvoid *index_offset(GLuint first_index) const;
+	void free(const ArenaRange &range);
+	// Binds the arena's VAO, creating it on first use; VAOs are not shared between contexts.
+	void bind();
+	// Points the bound VAO at the arena's vertices and indices, for VAOs with extra attributes.
+	void bind_attributes();
+	static void destroy();
+};
@@ -26,6 +26,8 @@ public:
 	static std::vector<Geometry *> geometries;
 
 	static void clean_up();
+	// Wraps finished data in a Geometry and queues its upload.
+	static Geometry *add_geometry(MeshData data);
 
 	static Geometry *generate_cube(GLfloat scale, bool with_normals);
 	static Geometry *generate_sphere(GLfloat radius, GLuint divisions);
@@ -33,6 +35,18 @@ public:
 	static Geometry *generate_plane(GLfloat scale, int texture_type);
 	static Geometry *generate_bezier_plane(GLfloat radius, GLuint num_curves, GLuint segmentation, GLfloat waviness, int texture_type, unsigned int seed);
 	//static Geometry *generate_grid(GLint size_modifier, GLfloat max_height, GLint village_diameter, GLfloat scale, GLuint seed);
-	static Geometry *generate_terrain(GLfloat size, GLint num_points_side, GLfloat min_height, GLfloat max_height, bool normals_up, int texture_type, std::vector<std::vector<GLfloat> > &height_map);
+	static Geometry *generate_terrain(GLfloat size, GLint num_points_side, GLfloat min_height, GLfloat max_height, bool normals_up, int texture_type, const HeightMap &height_map);
 	static Geometry *generate_sword();
+	static Geometry *generate_grid_patch(GLuint quads);
+	static const char *texture_path(int texture_type);
+
+	// The vertex data alone, without touching GL.
+	static MeshData cube_data(GLfloat scale, bool with_normals);
+	static MeshData sphere_data(GLfloat radius, GLuint divisions);
+	static MeshData cylinder_data(GLfloat radius, GLfloat height, GLuint divisions, bool is_centered);
+	static MeshData plane_data(GLfloat scale, int texture_type);
+	static MeshData bezier_plane_data(GLfloat radius, GLuint num_curves, GLuint segmentation, GLfloat waviness, int texture_type, unsigned int seed);
+	static MeshData terrain_data(GLfloat size, GLint num_points_side, GLfloat min_height, GLfloat max_height, bool normals_up, int texture_type, const HeightMap &height_map);
+	static MeshData sword_data();
+	static MeshData grid_patch_data(GLuint quads);
 };
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// Shadows the GL state touched while drawing and skips calls that would not change it.
+// Anything binding programs, VAOs, textures, culling or depth writes behind its back
+// must call invalidate() afterwards.
+class GLState
+{
+private:
+	static const GLuint MAX_TEXTURE_UNITS = 8;
+	static GLuint program, vertex_array, active_unit;
+	static GLuint textures_2d[MAX_TEXTURE_UNITS], textures_cube[MAX_TEXTURE_UNITS], textures_buffer[MAX_TEXTURE_UNITS];
+	static GLint cull_enabled, cull_mode, depth_write;
+
+	static bool elide(bool unchanged);
+public:
+	static bool enabled;
+	// Calls issued to and skipped before the driver since the last reset_stats().
+	static GLuint calls_made, calls_elided;
+
+	static void invalidate();
+	static void reset_stats();
+	static void use_program(GLuint id);
+	static void bind_vertex_array(GLuint id);
+	static void bind_texture(GLuint unit, GLenum target, GLuint id);
+	static void set_cull_face(bool enable);
+	static void cull_face(GLenum mode);
+	static void depth_mask(GLboolean enable);
+};
@@ -27,6 +27,9 @@ private:
 	static void next_skybox();
 	static void change_scene(Scene *);
 	static void next_scene();
+	static Scene *scene_after(Scene *);
+	// Finishes building a scene on the main thread and links it into the portal chain.
+	static void build_scene(Scene *);
 	/* static callbacks */
 	static void error_callback(int error, const char* description);
 	static void resize_callback(GLFWwindow* window, int width, int height);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+
+// Square grid of heights in a single 64-byte aligned allocation, indexed [x][y] like the
+// vector-of-vectors it replaces. Row-major by default; large maps can be tiled into 16x16
+// blocks stored in Morton (Z) order, so 2D neighbourhoods stay within a few cache lines.
+class HeightMap
+{
+private:
+	static const GLuint TILE_SHIFT = 4;
+	static const GLuint TILE_MASK = (1 << TILE_SHIFT) - 1;
+
+	GLuint side;
+	GLuint tiles_per_side;
+	bool tiled;
+	size_t count;
+	void *buffer;
+	GLfloat *data;
+
+	void allocate(GLuint side, bool tiled);
+	void release();
+
+	// Spreads the low four bits of v to the even bit positions.
+	static GLuint spread_bits(GLuint v)
+	{
+		v = (v | (v << 2)) & 0x33;
+		v = (v | (v << 1)) & 0x55;
+		return v;
+	}
+	size_t index(GLuint x, GLuint y) const
+	{
+		if (!tiled)
+			return (size_t) x * side + y;
+		size_t tile = (size_t) (x >> TILE_SHIFT) * tiles_per_side + (y >> TILE_SHIFT);
+		return (tile << (2 * TILE_SHIFT)) | (spread_bits(x & TILE_MASK) << 1) | spread_bits(y & TILE_MASK);
+	}
+public:
+	HeightMap();
+	HeightMap(GLuint side, GLfloat fill, bool tiled);
+	HeightMap(const HeightMap &other);
+	HeightMap(HeightMap &&other);
+	HeightMap &operator=(const HeightMap &other);
+	HeightMap &operator=(HeightMap &&other);
+	~HeightMap();
+
+	// Samples per side.
+	GLuint size() const { return side; }
+	bool is_tiled() const { return tiled; }
+	bool empty() const { return side == 0; }
+
+	// No bounds checks; x and y must be below size().
+	GLfloat &at(GLuint x, GLuint y) { return data[index(x, y)]; }
+	GLfloat at(GLuint x, GLuint y) const { return data[index(x, y)]; }
+
+	void fill(GLfloat value);
+	// Bilinear height at (x, y) on a square of side length centred on the origin, clamped to the edges.
+	GLfloat sample(GLfloat x, GLfloat y, GLfloat length) const;
+	// Same as sample() for many points at once; points hold (x, y) pairs.
+	void sample(const glm::vec2 *points, size_t num_points, GLfloat length, GLfloat *heights) const;
+	// Writes the heights row by row (x major), e.g. for a texture upload.
+	void copy_rows(GLfloat *out) const;
+	// The heights in row order without copying, or null when tiled.
+	const GLfloat *rows() const;
+	// The whole allocation in memory order, tile padding included, for saving and loading
+	// maps of the same size and layout as is.
+	GLfloat *storage() { return data; }
+	const GLfloat *storage() const { return data; }
+	size_t storage_size() const { return count; }
+};
@@ -4,6 +4,11 @@
 #include "scene_transform.h"
 #include "scene_model.h"
 #include "geometry.h"
+#include "scene_terrain.h"
+#include "random.h"
+#include "tree.h"
+
+#include <vector>
 
 class IslandScene :
 	public Scene
@@ -12,15 +17,34 @@ private:
 	SceneGroup *forest;
 	SceneTransform *map;
 	SceneGroup *village;
-	SceneModel *small_map_model;
+	SceneGroup *small_map;
 	SceneGroup *small_forest;
 	SceneGroup *small_village;
 	Geometry *cylinder_geo;
 	Geometry *diamond_geo;
 	Geometry *cube_geo;
-	Geometry *land_geo;
-	Geometry *plateau_geo;
-	Geometry *sand_geo;
+
+	// Builders make new subtrees outside the graph and touch nothing else, so they can run on
+	// the job system; placers put their results in on the main thread.
+	HeightMap build_height_map(uint32_t seed);
+	SceneTerrain *build_terrain(const HeightMap &map, bool miniature);
+	std::vector<TreeInstance> place_trees(const HeightMap &map, Random &forest_rng);
+	SceneGroup *build_forest(const HeightMap &map, Random forest_rng);
+	SceneTransform *build_building(const HeightMap &map, int i, Random building_rng);
+	std::vector<SceneTransform *> build_village(const HeightMap &map, std::vector<Random> building_rngs);
+	void place_map(SceneTerrain *terrain);
+	void place_small_map(SceneTerrain *small_terrain);
+	void place_forest(SceneGroup *trees);
+	void place_village(const std::vector<SceneTransform *> &buildings);
+
+	// Time-sliced versions of the generate_ functions, queued on FrameTasks.
+	void add_forest_task();
+	void add_village_task();
+	void add_miniatures_task();
+	glm::vec3 miniature_position(int slot);
+	void add_small_map();
+	void add_small_forest();
+	void add_small_village();
 public:
 	float helicopter_angle;
 
@@ -36,6 +60,12 @@ public:
 	void generate_small_village();
 	void generate_other();
 
+	// Same as the generate_ functions, but built in the background and swapped in once done.
+	void regenerate_map();
+	void regenerate_forest();
+	void regenerate_village();
+
+	void prepare();
 	void setup();
 	GLfloat get_size();
 };
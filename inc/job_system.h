@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+// Unit of work. A job counts as finished once its own work and every child created
+// under it have run, so waiting on a parent waits on the whole tree.
+struct Job
+{
+	std::function<void()> work;
+	Job *parent;
+	// One for the job itself plus one per unfinished child.
+	std::atomic<int> unfinished;
+};
+
+// Per-thread counters since the last reset_stats(). Thread 0 is the main thread, which
+// only runs jobs of the tree it is waiting on.
+struct WorkerStats
+{
+	unsigned int jobs_run;
+	unsigned int jobs_stolen;
+	// Fraction of the time since reset_stats() spent running jobs.
+	double utilization;
+};
+
+// Work-stealing scheduler. Every thread has its own deque: it pushes and pops its own jobs
+// at the back, so related work stays on one core, and idle threads steal from the front of
+// the others'. Jobs must not touch GL; only the main thread owns the context.
+class JobSystem
+{
+private:
+	static void worker_loop(unsigned int index);
+	static bool in_tree(const Job *job, const Job *root);
+	// The next job for thread index to run, limited to root's tree unless root is null.
+	static Job *next_job(unsigned int index, const Job *root = nullptr);
+	static void execute(Job *job, unsigned int index);
+	static void finish(Job *job);
+public:
+	// Starts num_workers threads besides the main one, or one per extra core when 0.
+	static void init(unsigned int num_workers);
+	static void destroy();
+	// Threads that run jobs, including the main thread.
+	static unsigned int num_threads();
+
+	// A job with a parent has to be created before the parent finishes, so typically from
+	// the parent's own work or before the parent is run. Only jobs without a parent may be
+	// waited on; children are freed as soon as they are done.
+	static Job *create(std::function<void()> work, Job *parent = nullptr);
+	static void run(Job *job);
+	// Runs other jobs until the job and its children are done, then frees it. On the main
+	// thread only the job's own tree is run; the rest is left to the workers.
+	static void wait(Job *job);
+	// Whether wait() would return at once, for polling a job without blocking.
+	static bool is_done(Job *job);
+	// Calls body(begin, end) over [0, count) in ranges of at most grain and waits for all of them.
+	static void parallel_for(unsigned int count, unsigned int grain, const std::function<void(unsigned int, unsigned int)> &body);
+
+	static void reset_stats();
+	static std::vector<WorkerStats> stats();
+	static void print_stats();
+};
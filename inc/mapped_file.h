@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages are read in by the OS as they are touched,
+// so loading is only as expensive as the data actually used.
+class MappedFile
+{
+private:
+	const unsigned char *bytes;
+	size_t length;
+#ifdef _WIN32
+	void *file;
+	void *mapping;
+#endif
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+public:
+	MappedFile();
+	~MappedFile();
+
+	// Returns false, leaving the file closed, if it is missing, empty or cannot be mapped.
+	bool open(const std::string &path);
+	void close();
+	bool is_open() const { return bytes != nullptr; }
+	const unsigned char *data() const { return bytes; }
+	size_t size() const { return length; }
+};
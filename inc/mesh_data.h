@@ -0,0 +1,34 @@
+#pragma once
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "bounding_box.h"
+
+class CacheWriter;
+class CacheReader;
+
+// Vertex data of a mesh in plain memory. Generators only fill these in, so they run
+// without a GL context, on any thread; Geometry turns them into GL objects later.
+struct MeshData
+{
+	bool has_texture = false;
+	bool has_normals = true;
+	bool add_texture_noise = false; //For Water Specifically
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> tex_coords;
+	std::vector<GLuint> indices;
+	BoundingBox bounds;
+	GLenum draw_type = GL_TRIANGLES;
+	// Texture image, loaded along with the buffers.
+	const char *texture_path = nullptr;
+	GLint wrap_type = GL_REPEAT;
+	GLint filter_type = GL_NEAREST_MIPMAP_LINEAR;
+
+	void attach_texture(const char *texture_loc);
+	void compute_bounds();
+	// For the procedural cache. The texture path is not saved; callers attach it again.
+	void write(CacheWriter &writer) const;
+	bool read(CacheReader &reader);
+};
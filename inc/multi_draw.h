@@ -0,0 +1,37 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "geometry.h"
+
+// Texture unit holding the per-draw matrices of a multi-draw.
+const GLuint DRAWS_TEXTURE_UNIT = 3;
+
+// Arena geometry collected under one program and material, then drawn with as few
+// glMultiDrawElementsIndirect calls as there are arenas and primitive types in it. Shaders
+// read each draw's matrices from a buffer texture, by the draw index attribute.
+class MultiDraw
+{
+private:
+	struct Draw
+	{
+		Geometry *geometry;
+		glm::mat4 model;
+	};
+	std::vector<Draw> draws;
+	GLuint command_buffer = 0, data_buffer = 0, data_texture = 0;
+public:
+	// Draws submitted and driver calls made since the last reset_stats().
+	static GLuint draws_merged, calls_made;
+
+	~MultiDraw();
+	static bool supported();
+	static void reset_stats();
+	bool empty() const { return draws.empty(); }
+	Geometry *first() const { return draws.front().geometry; }
+	void add(Geometry *g, const glm::mat4 &model);
+	// Issues everything added and starts over; the caller has set up the program.
+	void submit();
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+// Bump whenever a cached generator gives different output for the same inputs, so stale
+// entries are never read back.
+const uint32_t PROCEDURAL_CACHE_VERSION = 1;
+
+// Hash (64-bit FNV-1a) of a generator's name, the cache version and every input the
+// generator's output depends on. Only feed it scalars; struct padding is not stable.
+class CacheKey
+{
+private:
+	uint64_t hash;
+public:
+	explicit CacheKey(const char *generator);
+	CacheKey &add(const void *data, size_t size);
+	template <typename T>
+	CacheKey &operator<<(const T &value) { return add(&value, sizeof(T)); }
+	uint64_t value() const { return hash; }
+};
+
+// Builds an entry's payload in memory before it is stored.
+class CacheWriter
+{
+public:
+	std::vector<unsigned char> bytes;
+
+	void write(const void *data, size_t size);
+	template <typename T>
+	void write(const T &value) { write(&value, sizeof(T)); }
+	template <typename T>
+	void write_vector(const std::vector<T> &values)
+	{
+		write((uint64_t) values.size());
+		write(values.data(), values.size() * sizeof(T));
+	}
+};
+
+// Reads a payload straight out of its mapping. Reads past the end fail and clear ok
+// instead of running off the file, so a truncated entry is only a miss.
+class CacheReader
+{
+private:
+	const unsigned char *cursor;
+	const unsigned char *end;
+public:
+	bool ok;
+
+	CacheReader();
+	CacheReader(const unsigned char *data, size_t size);
+	bool read(void *out, size_t size);
+	template <typename T>
+	bool read(T &value) { return read(&value, sizeof(T)); }
+	template <typename T>
+	bool read_vector(std::vector<T> &values)
+	{
+		uint64_t count;
+		if (!read(count) || count > (uint64_t) (end - cursor) / sizeof(T))
+			return ok = false;
+		values.resize((size_t) count);
+		return read(values.data(), (size_t) count * sizeof(T));
+	}
+	// Whether everything was read and nothing is left over.
+	bool done() const { return ok && cursor == end; }
+};
+
+// Generated content kept on disk between runs, one file per entry named after its key.
+// Generators look their output up before doing any work, and store it afterwards. Safe to
+// use from jobs; an entry being written is never visible half done. Past a size limit the
+// least recently used entries are removed at startup.
+class ProceduralCache
+{
+public:
+	// Until init() is called every lookup misses and nothing is stored.
+	static void init(const std::string &directory);
+	// Seed of the world the cache holds, stored next to the entries so every run builds the
+	// same world and finds it cached. Picked from the clock when there is none yet, and
+	// 0 while the cache is off. Delete the directory for a new world.
+	static unsigned int world_seed();
+	// Maps the entry for key and points reader at its payload, which stays valid until
+	// file is closed. Returns false on a miss.
+	static bool load(const CacheKey &key, MappedFile &file, CacheReader &reader);
+	static void store(const CacheKey &key, const CacheWriter &writer);
+	static void print_stats();
+};
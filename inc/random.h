@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+// Small PCG32 generator. Every procedural generator owns one of these instead of sharing the
+// libc rand() state, so each tree, building or map only depends on the stream it was handed
+// and stays the same however many other things were generated before it.
+class Random
+{
+private:
+	uint64_t origin;
+	uint64_t state;
+	uint64_t increment;
+
+	static uint64_t mix(uint64_t v);
+public:
+	Random(uint64_t seed = 0, uint64_t stream = 0);
+
+	uint32_t next();
+	// Uniform in [min, max).
+	float random(float min, float max);
+	// Uniform integer in [0, n).
+	uint32_t below(uint32_t n);
+	// Independent child stream that only depends on this stream's seed and id,
+	// not on how far this stream has advanced.
+	Random derive(uint64_t id) const;
+	// Child stream for the next consumer; advances this stream by two draws.
+	Random fork();
+	uint64_t seed() const { return origin; }
+	uint64_t stream() const { return increment >> 1; }
+};
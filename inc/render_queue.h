@@ -0,0 +1,55 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "shader.h"
+#include "geometry.h"
+#include "material.h"
+
+class SceneNode;
+
+// Key layout, most significant first: pass (2), program (10), material (12), geometry (16), depth (24).
+enum RenderPass
+{
+	PASS_BACKGROUND = 0,
+	PASS_OPAQUE = 1
+};
+
+struct DrawPacket
+{
+	uint64_t key;
+	Shader *shader;
+	Geometry *geometry;
+	// Instanced packets have a non-zero VAO.
+	InstanceBatch batch;
+	Material material;
+	glm::mat4 to_world;
+	glm::mat4 mesh_model;
+	bool no_culling;
+	// Nodes that draw themselves; the queue only sets the program, material and culling.
+	SceneNode *owner;
+};
+
+class RenderQueue
+{
+public:
+	std::vector<DrawPacket> packets;
+	// State switches made by the last submit, for profiling.
+	GLuint program_switches, material_switches;
+	// Consecutive plain packets that only differ in geometry and transform.
+	MultiDraw batch;
+
+	void clear();
+	void push(Shader *shader, Geometry *geometry, const Material &material, glm::mat4 to_world, glm::mat4 mesh_model, bool no_culling, GLfloat depth);
+	void push_instanced(Shader *shader, Geometry *geometry, const InstanceBatch &batch, const Material &material, glm::mat4 to_world, bool no_culling, GLfloat depth);
+	void push_custom(Shader *shader, SceneNode *owner, const Material &material, glm::mat4 to_world, bool no_culling, GLfloat depth);
+	void sort();
+	void submit();
+
+	static uint64_t make_key(GLuint pass, Shader *shader, const Material &material, uint64_t geometry_id, GLfloat depth);
+	static bool same_material(const Material &a, const Material &b);
+	static bool same_texture(const Geometry *a, const Geometry *b);
+};
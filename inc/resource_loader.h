@@ -0,0 +1,39 @@
+#pragma once
+
+#define GLFW_INCLUDE_GLEXT
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <functional>
+
+#include "texture_data.h"
+
+// A thread with its own GL context, shared with the window's, that fills buffers and textures
+// so the render thread never waits on a transfer. Each upload is followed by a fence; once the
+// GPU has passed it, its ready callback runs on the main thread from process().
+// Without a loader (init failed or was never called) callers do the work themselves.
+class ResourceLoader
+{
+private:
+	static void loader_loop();
+	static void finish(bool wait);
+public:
+	// Call on the main thread, with the window's context current.
+	static bool init(GLFWwindow *main_window);
+	// Waits for everything submitted, then stops the thread.
+	static void shutdown();
+	static bool running();
+
+	// Thread safe. upload runs on the loader's context and is given a pixel unpack buffer
+	// to stage through; ready runs on the main thread once the GPU has the data.
+	static void submit(std::function<void(GLuint)> upload, std::function<void()> ready);
+	// Main thread, every frame: runs the ready callbacks of finished uploads without blocking.
+	static void process();
+	// Main thread: waits until everything submitted so far is ready.
+	static void flush();
+
+	// Main thread. Runs decode on the job system (or on the loader when there are no worker
+	// threads), uploads the result into texture, bound to the data's target, and passes the
+	// uploaded size to ready on the main thread.
+	static void load_texture(GLuint texture, std::function<void(TextureData &)> decode, std::function<void(size_t)> ready);
+};
@@ -9,17 +9,37 @@
 #include "plane.h"
 #include "scene_trans_anim.h"
 #include "bounding_sphere.h"
+#include "bounding_box.h"
+#include "render_queue.h"
+#include "height_map.h"
+#include "random.h"
+
+#include <atomic>
+#include <functional>
+
+struct Job;
 
 class Scene
 {
 public:
+	// Scene currently being rendered; nodes shared between scenes cull against its frustum.
+	static Scene *active;
+	// Per-frame culling statistics, reset by the caller at the start of each frame.
+	static GLuint meshes_drawn;
+	static GLuint meshes_culled;
+	static GLuint terrain_triangles;
+	// Filled by graph traversal during render(), then sorted and submitted.
+	static RenderQueue queue;
+
 	SceneGroup *root;
 	SceneCamera *camera;
 	glm::mat4 P;
 	glm::vec3 light_pos;
 	Plane frustum_planes[6];
 	glm::vec3 frustum_corners[8];
-	std::vector< std::vector<GLfloat> > height_map;
+	HeightMap height_map;
+	// Parent stream for everything this scene generates; each generator forks its own.
+	Random rng;
 	std::vector<BoundingSphere *> interactable_objects;
 
 	// portals
@@ -29,15 +49,49 @@ public:
 	glm::vec2 in_area[2];
 	glm::vec2 in_point, out_point;
 
+	// Scenes are built on demand: construction runs prepare() and setup() on the job system,
+	// and constructed is set once finish_construction() has returned.
+	Job *construction = nullptr;
+	bool constructed = false;
+	// Whether setup() may leave long generation to FrameTasks, to fill in over the first frames.
+	bool time_sliced = false;
+
+	// Regeneration running in the background, and what to do on the main thread once it is done.
+	Job *regeneration = nullptr;
+	std::function<void()> regeneration_swap;
+	// Geometry the running build queued that is not uploaded yet.
+	std::atomic<unsigned int> regeneration_uploads{ 0 };
+
 	Scene();
 	~Scene();
 	void render();
 	void pass(Shader * s);
 	void update_frustum_corners(int width, int height, GLfloat);
 	void update_frustum_planes();
+	void update_bounds();
+	bool in_frustum(const BoundingBox &b, glm::mat4 m);
+	static void reset_cull_stats();
 	glm::mat4 frustum_ortho();
 	void displace_cam(glm::vec3 displacement);
+	// Runs build on the job system and swap on the main thread at the start of the first
+	// frame after build and the geometry it queued are done. build must only create new
+	// nodes, outside the graph; swap puts them in and deletes what they replace. One per
+	// scene at a time, so returns false while another is still running.
+	bool regenerate(std::function<void()> build, std::function<void()> swap);
+	void finish_regeneration();
+	// Starts construction in the background unless it is already running or done.
+	void construct_async();
+	// Constructs the scene, or waits for construct_async() to finish, helping with its jobs.
+	void finish_construction();
+	// Waits for construction and regeneration without starting either, so the scene can be
+	// deleted. A pending regeneration is dropped rather than swapped in.
+	void wait_for_jobs();
 
+	// Generation that needs no GL context, run on the job system before setup(); scenes
+	// are prepared side by side, so it may only touch the scene's own members.
+	virtual void prepare() {}
+	// Builds the graph. Runs on the job system too, so the same rules apply: nodes and
+	// geometry create their GL objects once they are drawn or leave the upload queue.
 	virtual void setup() {}
 	virtual GLfloat get_size() { return 0; }
 };
\ No newline at end of file
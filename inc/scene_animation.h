@@ -5,6 +5,7 @@
 
 #include "scene_group.h"
 #include "shader.h"
+#include "random.h"
 
 class SceneAnimation :
 	public SceneGroup
@@ -14,11 +15,13 @@ private:
 	glm::vec3 axis, pivot;
 	double prev_time;
 	glm::mat4 transformation;
+	Random rng;
 public:
 	SceneAnimation(Scene * scene, GLfloat min, GLfloat max, GLfloat start, GLfloat step, glm::vec3 axis, glm::vec3 pivot);
 	SceneAnimation();
 	~SceneAnimation();
 	void draw(glm::mat4 m);
+	void update_bounds();
 	void pass(glm::mat4 m, Shader *s);
 };
 
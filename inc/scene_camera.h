@@ -26,6 +26,7 @@ public:
 	void draw(glm::mat4 m);
 	void pass(glm::mat4 m, Shader *s);
 	void update();
+	void update_bounds();
 	void recalculate();
 	void reset();
 };
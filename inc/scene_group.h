@@ -19,6 +19,7 @@ public:
 	void remove_all();
 	virtual void draw(glm::mat4 m);
 	virtual void update();
+	virtual void update_bounds();
 	virtual void pass(glm::mat4 m, Shader *s);
 };
 
@@ -0,0 +1,58 @@
+#pragma once
+#include "scene_node.h"
+#include "mesh.h"
+
+#include <vector>
+
+#include "scene.h"
+#include "shader.h"
+
+// Affine matrix stored as its top three rows; the bottom row is always (0, 0, 0, 1).
+struct Matrix4x3
+{
+	glm::vec4 rows[3];
+
+	Matrix4x3() {}
+	Matrix4x3(const glm::mat4 &m);
+	glm::mat4 to_mat4() const;
+};
+
+// Per-instance vertex data, read from attribute locations 3 to 8.
+struct Instance
+{
+	glm::mat4 model;
+	// Replaces the material's diffuse and ambient colours when w is 1.
+	glm::vec4 color;
+	// Wind sway about an axis through the origin: xyz is the axis, w the amplitude in degrees.
+	glm::vec4 sway;
+};
+
+// Draws one mesh many times with a single instanced call.
+class SceneInstances :
+	public SceneNode
+{
+private:
+	GLuint VAO, IBO, parts_buffer, parts_texture;
+	BoundingBox instance_bounds;
+	// Set by upload(); the buffers are filled the next time the node is drawn.
+	bool dirty;
+	std::vector<Instance> instance_data;
+
+	void upload_buffers();
+public:
+	Mesh mesh;
+	std::vector<Instance> instances;
+	// Local transforms repeated under every instance (e.g. the branches of a tree).
+	std::vector<Matrix4x3> parts;
+
+	SceneInstances(Scene *, Mesh);
+	~SceneInstances();
+	void add_instance(Instance i);
+	// Prepares the instances for drawing. Makes no GL calls, so it is safe off the main thread.
+	void upload();
+	InstanceBatch batch();
+	void draw(glm::mat4);
+	void update();
+	void update_bounds();
+	void pass(glm::mat4 m, Shader *s);
+};
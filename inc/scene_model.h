@@ -13,12 +13,15 @@ class SceneModel :
 public:
 	std::vector<Mesh> meshes;
 	glm::mat4 model_mat;
+	// Whether the meshes' geometry is this model's alone and goes with it, as for generated buildings.
+	bool owns_geometry = false;
 
 	SceneModel(Scene *);
 	~SceneModel();
 	void add_mesh(Mesh m);
 	void draw(glm::mat4);
 	void update();
+	void update_bounds();
 	void combine_meshes();
 	void pass(glm::mat4 m, Shader *s);
 };
@@ -4,6 +4,7 @@
 #include <glm/glm.hpp>
 
 #include "shader.h"
+#include "bounding_box.h"
 
 class Scene;
 
@@ -12,8 +13,16 @@ class SceneNode
 protected:
 	Scene *scene;
 public:
+	// Bounds of everything below this node, in the space of the matrix passed to draw().
+	BoundingBox bounds;
+	// Number of meshes below this node, so culled subtrees can be counted without visiting them.
+	GLuint num_meshes = 0;
+
+	virtual ~SceneNode() {}
 	virtual void draw(glm::mat4 m) = 0;
 	virtual void update() = 0;
+	virtual void update_bounds() = 0;
 	virtual void pass(glm::mat4 m, Shader *s) = 0;
+	// Draws a packet the node queued with RenderQueue::push_custom().
+	virtual void submit(Shader *, glm::mat4) {}
 };
-
@@ -0,0 +1,95 @@
+#pragma once
+#include "scene_node.h"
+
+#include <vector>
+
+#include "scene.h"
+#include "shader.h"
+#include "material.h"
+
+// Grid cells per side of the patch every chunk draws.
+const GLuint TERRAIN_PATCH_QUADS = 16;
+const GLuint MAX_TERRAIN_BANDS = 3;
+
+// Height range drawn with one texture. Later bands win where ranges overlap.
+struct TerrainBand
+{
+	GLfloat min_height;
+	GLfloat max_height;
+	// Loaded with the rest of the terrain's GL objects.
+	GLuint texture;
+	int texture_type;
+	bool normals_up;
+};
+
+// Per-instance vertex data of one selected chunk, read from attribute locations 1 and 2.
+struct TerrainChunk
+{
+	// x and z of the chunk's corner and its side length, in terrain space.
+	glm::vec4 area;
+	// World distances over which the chunk morphs into its parent's grid.
+	glm::vec4 morph;
+};
+
+// Quadtree node over the height map. Level 0 nodes are the finest chunks.
+struct TerrainNode
+{
+	GLfloat x, z, size;
+	GLfloat min_height, max_height;
+	// Largest height difference between the node's own grid and the full-resolution height map.
+	GLfloat error;
+	GLuint level;
+	// Index of the first of four consecutive children, or 0 for leaves.
+	GLuint children;
+};
+
+// Continuous-LOD terrain (CDLOD): a quadtree of chunks that all draw one shared grid patch,
+// displaced by the height map in the vertex shader. Chunks further from the camera use coarser
+// levels, and vertices morph into the coarser grid before a level change so seams stay closed.
+class SceneTerrain :
+	public SceneNode
+{
+private:
+	GLuint VAO, chunk_buffer;
+	std::vector<TerrainNode> nodes;
+	std::vector<TerrainChunk> chunks;
+	// World distance up to which each level is drawn.
+	std::vector<GLfloat> lod_ranges;
+	// Height texture contents until upload().
+	std::vector<GLfloat> heights;
+
+	GLfloat grid_error(GLuint x, GLuint z, GLuint cells, GLuint step, const HeightMap &height_map);
+	void build_node(GLuint index, GLuint x, GLuint z, GLuint level, const HeightMap &height_map);
+	BoundingBox node_bounds(const TerrainNode &n);
+	// The node and its eight same-level neighbours, over the whole terrain's height range.
+	BoundingBox neighbourhood_bounds(const TerrainNode &n);
+	void select(GLuint node, glm::mat4 m, bool cull);
+	void select_chunks(glm::mat4 m, bool cull);
+	void upload();
+public:
+	static Geometry *patch;
+
+	GLuint height_texture;
+	GLuint height_map_size;
+	GLfloat size;
+	Material material;
+	bool no_culling = false;
+	// Nodes whose grid is at least this close to the height map are refined no further than
+	// their neighbours need, so flat and planar areas collapse into a few coarse chunks.
+	GLfloat error_tolerance;
+	std::vector<TerrainBand> bands;
+	// Camera position the last selection was made for, in world space.
+	glm::vec3 lod_origin;
+
+	// Only builds the quadtree, so terrain can be made off the main thread; GL objects are
+	// created the first time it is drawn.
+	SceneTerrain(Scene *, GLfloat size, const HeightMap &height_map, Material material);
+	~SceneTerrain();
+	void add_band(GLfloat min_height, GLfloat max_height, int texture_type, bool normals_up);
+	InstanceBatch batch();
+	void draw(glm::mat4);
+	void update();
+	void update_bounds();
+	void pass(glm::mat4 m, Shader *s);
+	void submit(Shader *s, glm::mat4 m);
+};
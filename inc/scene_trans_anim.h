@@ -16,6 +16,7 @@ public:
 	void play_anim();
 	void reset();
 	void draw(glm::mat4 m);
+	void update_bounds();
 	void pass(glm::mat4 m, Shader *s);
 };
 
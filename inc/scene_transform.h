@@ -17,6 +17,7 @@ public:
 	~SceneTransform();
 	void draw(glm::mat4 m);
 	void update();
+	void update_bounds();
 	void pass(glm::mat4 m, Shader *s);
 };
 
@@ -2,22 +2,53 @@
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include <map>
+#include <string>
 
 #include "material.h"
 #include "geometry.h"
+#include "multi_draw.h"
+
+// Texture unit holding the part matrices of an instanced draw.
+const GLuint PARTS_TEXTURE_UNIT = 2;
+
+// Everything an instanced draw needs besides the geometry.
+struct InstanceBatch
+{
+	GLuint vao;
+	GLsizei count;
+	// Buffer texture of 4x3 matrices repeated under every instance, or 0 for one untransformed part.
+	GLuint parts_texture;
+	GLsizei part_count;
+};
 
 class Shader
 {
 public:
     GLuint shader_id;
-	glm::mat4 V, P, mesh_model;
-	glm::vec3 cam_pos;
+	glm::mat4 mesh_model;
+	// Drawn before every other pass, without writing depth.
+	bool background = false;
+	// Active uniforms of the linked program, reflected once so draws never query by name.
+	std::map<std::string, GLint> uniforms;
 
     Shader(GLuint shader_id);
     void use();
-	void send_cam_pos(glm::vec3 cam_pos);
-    void set_VP(glm::mat4 V, glm::mat4 P);
+	void reflect_uniforms();
+	GLint uniform(const char *name);
+	void set_uniform(GLint location, GLint value);
+	void set_uniform(GLint location, GLfloat value);
+	void set_uniform(GLint location, const glm::vec2 &value);
+	void set_uniform(GLint location, const glm::vec3 &value);
+	void set_uniform(GLint location, const glm::vec4 *values, GLsizei count);
+	void set_uniform(GLint location, const glm::mat3 &value);
+	void set_uniform(GLint location, const glm::mat4 &value);
 	void send_mesh_model(glm::mat4 mesh_model);
     virtual void set_material(Material m);
     virtual void draw(Geometry *g, glm::mat4 to_world);
+	virtual void draw_instanced(Geometry *g, const InstanceBatch &batch, glm::mat4 to_world);
+	// True if g can go into a MultiDraw instead of its own draw().
+	virtual bool batchable(Geometry *g);
+	// Draws everything in batch under the current material; batchable geometry only.
+	virtual void draw_multi(MultiDraw &batch);
 };
@@ -6,6 +6,10 @@
 class ShadowShader :
 	public Shader
 {
+private:
+	GLint model_loc, instanced_loc, part_count_loc, multi_draw_loc;
+	// Plain draws of the current pass, issued together by flush().
+	MultiDraw deferred;
 public:
 	GLuint FBO, shadow_map_tex;
 	unsigned int size;
@@ -14,7 +18,11 @@ public:
 	glm::mat4 light_proj;
 
 	ShadowShader(GLuint shader_id);
+	void update_light_matrix();
 	void set_material(Material m);
 	void draw(Geometry *g, glm::mat4 to_world);
+	void draw_instanced(Geometry *g, const InstanceBatch &batch, glm::mat4 to_world);
+	// Draws what draw() deferred; called once the scene has made its pass.
+	void flush();
 };
 
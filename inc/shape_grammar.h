@@ -9,6 +9,9 @@
 #include "scene_transform.h"
 #include "colors.h"
 #include "shader_manager.h"
+#include "random.h"
+
+class CacheKey;
 
 #define BOX 0
 #define CYLINDER 1
@@ -20,15 +23,16 @@
 class ShapeGrammar
 {
 private:
-	static void create_base(SceneModel *);
-	static void add_box(SceneModel *, float, float);
-	static void add_cylinder(SceneModel *, float, float, float offset = 0.0f);
-	static void add_hemisphere(SceneModel *, float, float, float offset = 0.0f);
-	static void add_pyramid(SceneModel *, float, float);
-	static void add_cone(SceneModel *, float, float, float offset = 0.0f);
-	static void add_plane(SceneModel *, float, float, int, float offset = 0.0f);
-	static Material random_material();
+	static void create_base(SceneModel *, Random &);
+	static void add_box(SceneModel *, Random &, float, float);
+	static void add_cylinder(SceneModel *, Random &, float, float, float offset = 0.0f);
+	static void add_hemisphere(SceneModel *, Random &, float, float, float offset = 0.0f);
+	static void add_pyramid(SceneModel *, Random &, float, float);
+	static void add_cone(SceneModel *, Random &, float, float, float offset = 0.0f);
+	static void add_plane(SceneModel *, Random &, float, float, int, float offset = 0.0f);
+	static Material random_material(Random &);
+	static bool load_building(const CacheKey &, SceneModel *);
 public:
-	static SceneModel *generate_building(Scene *, bool, int);
+	static SceneModel *generate_building(Scene *, bool, Random);
 };
 
@@ -1,19 +1,52 @@
 #pragma once
 
 #include "shader.h"
+#include "texture_data.h"
+#include <string>
 #include <vector>
 
+const int NUM_SKYBOXES = 5;
+
+// Cube maps kept on the GPU beyond the one on screen; 16 MB holds three uncompressed skyboxes.
+const size_t SKYBOX_VRAM_BUDGET = 16 << 20;
+
+// Skyboxes are loaded the first time they are selected or prefetched, and the least recently
+// shown are unloaded again once they take up more than vram_budget.
 class SkyboxShader :
 	public Shader
 {
+private:
+	struct Cubemap
+	{
+		// 0 while not resident.
+		GLuint texture = 0;
+		bool ready = false;
+		size_t size = 0;
+		unsigned int last_used = 0;
+	};
+	std::vector<Cubemap> cubemaps;
+	GLuint shown_skybox = 0;
+	// Last skybox prefetched and not yet selected, or NUM_SKYBOXES; kept like the one on screen.
+	GLuint prefetched_skybox = NUM_SKYBOXES;
+	unsigned int use_clock = 0;
+
+	static bool load_faces(int skybox, TextureData &data);
+	void load(GLuint skybox, bool async);
+	void loaded(GLuint skybox, size_t size);
+	void evict();
 public:
-	GLuint current_texture_id;
-	std::vector<GLuint> texture_ids;
+	GLuint current_texture_id = 0;
+	size_t vram_budget = SKYBOX_VRAM_BUDGET;
 	GLuint VAO, VBO;
 
 	SkyboxShader(GLuint shader_id);
-	void load_cubemap();
+	// Directory holding the six .ppm faces of a skybox.
+	static std::string cubemap_dir(int skybox);
+	// Shows a skybox, loading it in the background if it is not resident; the previous one
+	// stays up until it is ready. Indices wrap around.
+	void select(GLuint skybox);
+	// Loads a skybox ahead of select(); asking again for the same one does nothing.
+	void prefetch(GLuint skybox);
 	void set_material(Material m);
 	void draw(Geometry *g, glm::mat4 to_world);
 };
-
@@ -7,6 +7,7 @@ public:
 	void generate_planes();
 	void generate_map();
 
+	void prepare();
 	void setup();
 	GLfloat get_size();
 };
@@ -6,15 +6,21 @@
 #include <time.h>
 #include <math.h>
 
+#include "height_map.h"
+
 class Terrain
 {
 private:
-	static void diamond_square(unsigned int step, unsigned int size, float scale, std::vector<std::vector<GLfloat> > &);
-	static void diamond_step(unsigned int x, unsigned int y, unsigned int step, unsigned int size, float scale, std::vector<std::vector<GLfloat> > &);
-	static void square_step(unsigned int x, unsigned int y, unsigned int step, unsigned int size, float scale, std::vector<std::vector<GLfloat> > &);
+	static HeightMap build_height_map(GLuint size, GLfloat max_height, GLint village_diameter, GLfloat scale, bool ramp, bool allow_dips, float smooth_value, GLuint seed);
+	static void diamond_square(unsigned int size, float scale, float smoothness, bool allow_dips, GLuint seed, HeightMap &);
+	static void diamond_step(unsigned int x, unsigned int y, unsigned int step, unsigned int size, float scale, bool allow_dips, GLuint seed, HeightMap &);
+	static void square_step(unsigned int x, unsigned int y, unsigned int step, unsigned int size, float scale, bool allow_dips, GLuint seed, HeightMap &);
+	// Uniform [0, 1) value that depends only on its arguments.
+	static float noise(GLuint seed, unsigned int x, unsigned int y, unsigned int step, unsigned int channel);
 
 public:
-	static std::vector<std::vector<GLfloat> > generate_height_map(GLuint size, GLfloat max_height, GLint village_diameter, GLfloat scale, bool ramp, bool allow_dips, float smooth_value, GLuint seed);
-	static float height_lookup(float x, float y, float length, std::vector<std::vector<GLfloat> > &);
+	// Served from the procedural cache when a map with the same parameters was made before.
+	static HeightMap generate_height_map(GLuint size, GLfloat max_height, GLint village_diameter, GLfloat scale, bool ramp, bool allow_dips, float smooth_value, GLuint seed);
+	static float height_lookup(float x, float y, float length, const HeightMap &);
 };
 
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "shader.h"
+
+class SceneTerrain;
+
+// Texture units of the terrain's height map and its first band; later bands follow it.
+const GLuint HEIGHT_TEXTURE_UNIT = 3;
+const GLuint BAND_TEXTURE_UNIT = 4;
+
+// Wraps both the terrain program and its depth-only twin, which share the displacement uniforms.
+class TerrainShader :
+	public Shader
+{
+private:
+	GLint material_specular_loc, material_shininess_loc, shadows_enabled_loc;
+	GLint model_loc, terrain_size_loc, height_map_size_loc, lod_origin_loc, bands_loc, band_count_loc, shadow_map_loc;
+public:
+	TerrainShader(GLuint shader_id);
+	void set_material(Material m);
+	void draw_terrain(SceneTerrain *terrain, glm::mat4 to_world);
+};
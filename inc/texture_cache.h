@@ -0,0 +1,19 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <string>
+
+// Textures shared by everything that loads the same file with the same sampler state.
+// Each acquire takes a reference and each release drops one; the GL texture is deleted
+// with the last. With a ResourceLoader running, acquire returns at once and the image
+// arrives later. Main thread only.
+class TextureCache
+{
+public:
+	static GLuint acquire(const std::string &path, GLint wrap_type, GLint filter_type);
+	// Ignores 0, so callers can release textures they never got.
+	static void release(GLuint texture);
+	// Whether the image has arrived; drawable() substitutes a placeholder until it has.
+	static bool ready(GLuint texture);
+	static GLuint drawable(GLuint texture);
+};
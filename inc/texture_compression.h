@@ -0,0 +1,45 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "texture_data.h"
+
+// A block-compressed image whose levels sit back to back in someone else's memory,
+// largest first, exactly as glCompressedTexImage2D takes them.
+struct CompressedImage
+{
+	GLenum format;
+	GLuint width;
+	GLuint height;
+	GLuint levels;
+	const unsigned char *data;
+};
+
+// BC1 (DXT1), BC3 (DXT5) and BC7 (BPTC) textures: reading them out of DDS files,
+// encoding them from RGB, and uploading the blocks to GL untouched.
+class TextureCompression
+{
+public:
+	// True if the driver can sample textures in this format.
+	static bool supported(GLenum format);
+	static bool is_compressed(GLenum format);
+	// Bytes in one level, for compressed formats and for tightly packed GL_RGB.
+	static size_t level_size(GLenum format, GLuint width, GLuint height, GLuint level);
+
+	// Points image into a DDS file in memory. Fails for layouts the game does not use
+	// (uncompressed, cube map and volume DDS files).
+	static bool parse_dds(const unsigned char *data, size_t size, CompressedImage &image);
+	// Reads a DDS file from disk into data, blocks untouched. A BC1 file without a mip chain
+	// gets one built on the CPU. Returns false if the file or format is unusable.
+	static bool load_dds(const std::string &path, TextureData &data);
+
+	// BC1-encodes one RGB level.
+	static std::vector<unsigned char> encode_bc1(const unsigned char *rgb, GLuint width, GLuint height);
+	// Decodes one BC1 level to RGB.
+	static std::vector<unsigned char> decode_bc1(const unsigned char *blocks, GLuint width, GLuint height);
+	// Halves an RGB level with a box filter; odd edges repeat their last texel.
+	static std::vector<unsigned char> downsample(const std::vector<unsigned char> &rgb, GLuint width, GLuint height);
+};
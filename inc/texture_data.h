@@ -0,0 +1,44 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// One level of one face, in the layout glTexImage2D or glCompressedTexImage2D takes.
+struct TextureLevel
+{
+	GLenum target;
+	GLint level;
+	GLsizei width;
+	GLsizei height;
+	const unsigned char *data;
+	size_t size;
+};
+
+// Pixels or blocks of a texture, decoded without a GL context, so loading runs on any thread
+// and only upload() needs one. Levels point into the asset pack or into storage, which is
+// why these are moved around but never copied.
+struct TextureData
+{
+	// GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP; each level names its own face.
+	GLenum target = GL_TEXTURE_2D;
+	GLenum format = GL_RGB;
+	// Pixel type of uncompressed data.
+	GLenum type = GL_UNSIGNED_BYTE;
+	std::vector<TextureLevel> levels;
+	bool generate_mipmaps = false;
+	std::vector<unsigned char> storage;
+
+	TextureData() = default;
+	TextureData(TextureData &&) = default;
+	TextureData &operator=(TextureData &&) = default;
+	TextureData(const TextureData &) = delete;
+	TextureData &operator=(const TextureData &) = delete;
+
+	// Takes the image from the asset pack, a DDS file, or anything SOIL decodes to RGB.
+	bool load(const std::string &path);
+	size_t size() const;
+	// Fills the texture bound to target. Given a pixel unpack buffer, the levels are staged
+	// through it so the driver can copy them to the GPU without stalling the caller.
+	void upload(GLuint unpack_buffer = 0) const;
+};
@@ -6,27 +6,44 @@
 #include <time.h>
 
 #include "scene_model.h"
+#include "scene_instances.h"
 #include "scene_transform.h"
 #include "colors.h"
 #include "shader_manager.h"
+#include "random.h"
+
+// Placement and colours of one tree in an instanced forest.
+struct TreeInstance
+{
+	glm::mat4 to_world;
+	glm::vec3 branch_color;
+	glm::vec3 leaf_color;
+	bool animated;
+};
+
+// One matrix per branch and leaf of a generated tree, along with the settings it grows
+// with. Plain data, so many trees can be generated at once on the job system.
+struct TreeParts
+{
+	GLfloat angle_delta;
+	GLfloat size;
+	unsigned int leaf_layers;
+	std::vector<Matrix4x3> branches;
+	std::vector<Matrix4x3> leaves;
+};
 
 class Tree
 {
 private:
-	static void tree_system(glm::mat4, glm::vec3, glm::vec3, float, float, float last_scale, unsigned int curr_iter, unsigned int max_iter);
-	
-	static unsigned int leaf_layers;
-	//static SceneModel *tree_model;
-	static SceneModel *branch_model;
-	static SceneModel *leaf_model;
-	static Mesh branch_mesh;
-	static Mesh leaf_mesh;
-
-	static SceneTransform *translate;
-	static SceneTransform *rotate;
-	static SceneTransform *scale;
+	static void tree_system(TreeParts &, Random &, glm::mat4, glm::vec3, glm::vec3, float, float, float last_scale, unsigned int curr_iter, unsigned int max_iter);
+	static void generate_parts(TreeParts &, Random &, unsigned int, unsigned int, GLfloat, GLfloat);
 
 public:
-	static SceneGroup *generate_tree(Scene *, Geometry *, Geometry *, unsigned int, unsigned int, GLfloat, GLfloat, Material, Material, bool, glm::vec3, int);
+	static SceneGroup *generate_tree(Scene *, Geometry *, Geometry *, unsigned int, unsigned int, GLfloat, GLfloat, Material, Material, bool, glm::vec3, Random);
+	static SceneGroup *generate_forest(Scene *, Geometry *, Geometry *, unsigned int, unsigned int, unsigned int, GLfloat, GLfloat, const std::vector<TreeInstance> &, Random);
+	// The two halves of generate_forest, for growing variants one at a time. A variant only
+	// depends on its index and the forest's stream, so the result is the same either way.
+	static void grow_variant(TreeParts &, unsigned int variant, unsigned int, unsigned int, GLfloat, GLfloat, const Random &);
+	static SceneGroup *assemble_forest(Scene *, Geometry *, Geometry *, const std::vector<TreeParts> &, const std::vector<TreeInstance> &, Random);
 };
 
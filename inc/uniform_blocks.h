@@ -0,0 +1,36 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Binding points shared by every program declaring the blocks.
+const GLuint PER_FRAME_BINDING = 0;
+const GLuint PER_VIEW_BINDING = 1;
+
+// std140 layouts; vec3s are padded to vec4 to match the GLSL declarations.
+struct PerFrameBlock
+{
+	glm::mat4 light_matrix;
+	glm::vec4 light_direction;
+	glm::vec4 light_color; // w holds the ambient coefficient.
+	glm::vec4 time; // x holds seconds since startup.
+};
+
+struct PerViewBlock
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec4 eye_pos;
+};
+
+class UniformBlocks
+{
+private:
+	static GLuint per_frame_ubo, per_view_ubo;
+public:
+	static void init();
+	static void destroy();
+	static void bind_program(GLuint shader_id);
+	static void update_frame(glm::mat4 light_matrix, glm::vec3 light_direction, glm::vec3 light_color, GLfloat ambient_coeff, GLfloat time);
+	static void update_view(glm::mat4 V, glm::mat4 P, glm::vec3 eye_pos);
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+class Geometry;
+
+// Geometry waiting for its GL objects. Anything may queue finished geometry from any thread;
+// the GL thread drains the queue a little every frame, or passes it on to the ResourceLoader,
+// and nodes skip geometry that is not on the GPU yet.
+class UploadQueue
+{
+public:
+	// Takes geometry whose data is complete; its bounds are computed here.
+	static void push(Geometry *g);
+	// Drops geometry that is deleted before its turn.
+	static void cancel(Geometry *g);
+	// Uploads in queue order until budget seconds have passed, always at least one.
+	// Returns how many are still waiting.
+	static size_t process(double budget);
+	// Uploads everything queued, e.g. before the first frame, and waits for the loader.
+	static void flush();
+	static size_t pending();
+
+	// While one is alive, geometry its thread pushes counts towards pending until it is
+	// uploaded or cancelled, so the caller can wait for its own geometry, not the whole queue.
+	class Batch
+	{
+	public:
+		explicit Batch(std::atomic<unsigned int> &pending);
+		~Batch();
+		Batch(const Batch &) = delete;
+		Batch &operator=(const Batch &) = delete;
+	private:
+		std::atomic<unsigned int> *previous;
+	};
+};
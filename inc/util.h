@@ -9,11 +9,14 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "random.h"
+
 class Util
 {
     public:
 		static GLuint quadVAO;
 		static GLuint quadVBO;
+		static Random world_random;
 
         static void print_vec3(glm::vec3 v);
         static void print_mat4(glm::mat4 m);
@@ -22,7 +25,10 @@ class Util
         static glm::vec3 trackball_position(double x_pos, double y_pos, int width, int height);
 		static void render_quad();
 		static void seed(unsigned int s);
+		// Draws from the world stream set by seed(). Main thread only; anything generated
+		// elsewhere should take its own stream().
 		static float random(float min, float max);
+		static Random stream();
 		static bool within_rect(glm::vec2 pos, glm::vec2 bottom_left, glm::vec2 top_right);
 };
 
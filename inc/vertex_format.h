@@ -0,0 +1,125 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <cstddef>
+
+#include "mesh_data.h"
+
+// Attribute locations every vertex format feeds, whatever their storage.
+const GLuint POSITION_ATTRIBUTE = 0;
+const GLuint NORMAL_ATTRIBUTE = 1;
+const GLuint TEX_COORD_ATTRIBUTE = 2;
+
+// Components a vertex layout is assembled from. Each names the glVertexAttribPointer
+// arguments for its storage and packs one value into it; shaders always see floats.
+struct FloatPosition
+{
+	static const GLint size = 3;
+	static const GLenum type = GL_FLOAT;
+	static const GLboolean normalized = GL_FALSE;
+	GLfloat value[3];
+
+	void pack(const glm::vec3 &v) { value[0] = v.x; value[1] = v.y; value[2] = v.z; }
+};
+
+// Padded to four halves so vertices stay 4-byte aligned.
+struct HalfPosition
+{
+	static const GLint size = 3;
+	static const GLenum type = GL_HALF_FLOAT;
+	static const GLboolean normalized = GL_FALSE;
+	GLhalf value[4];
+
+	void pack(const glm::vec3 &v) { value[0] = glm::packHalf1x16(v.x); value[1] = glm::packHalf1x16(v.y); value[2] = glm::packHalf1x16(v.z); value[3] = 0; }
+};
+
+// 10:10:10:2 signed normalized; the shader's vec3 ignores the 2 bits.
+struct PackedNormal
+{
+	static const GLint size = 4;
+	static const GLenum type = GL_INT_2_10_10_10_REV;
+	static const GLboolean normalized = GL_TRUE;
+	GLuint value;
+
+	void pack(const glm::vec3 &v) { value = glm::packSnorm3x10_1x2(glm::vec4(v, 0.f)); }
+};
+
+struct FloatTexCoord
+{
+	static const GLint size = 2;
+	static const GLenum type = GL_FLOAT;
+	static const GLboolean normalized = GL_FALSE;
+	GLfloat value[2];
+
+	void pack(const glm::vec2 &v) { value[0] = v.x; value[1] = v.y; }
+};
+
+struct HalfTexCoord
+{
+	static const GLint size = 2;
+	static const GLenum type = GL_HALF_FLOAT;
+	static const GLboolean normalized = GL_FALSE;
+	GLhalf value[2];
+
+	void pack(const glm::vec2 &v) { value[0] = glm::packHalf1x16(v.x); value[1] = glm::packHalf1x16(v.y); }
+};
+
+// What an arena needs to know about the vertices it holds.
+struct VertexFormat
+{
+	GLsizei stride;
+	// Points the bound VAO's attributes at the bound GL_ARRAY_BUFFER.
+	void (*bind_attributes)();
+	// Writes data's vertices interleaved to out, stride bytes apart.
+	void (*pack)(const MeshData &data, unsigned char *out);
+
+	// The smallest format that keeps data's positions and texture coordinates within tolerance.
+	static const VertexFormat *choose(const MeshData &data);
+};
+
+// An interleaved vertex of the given components and everything needed to upload and bind it.
+template <typename Position, typename Normal, typename TexCoord>
+struct VertexLayout
+{
+	struct Vertex
+	{
+		Position position;
+		Normal normal;
+		TexCoord tex_coord;
+	};
+
+	template <typename Component>
+	static void set_attribute(GLuint location, size_t offset)
+	{
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, Component::size, Component::type, Component::normalized, sizeof(Vertex), (GLvoid *) offset);
+	}
+
+	static void bind_attributes()
+	{
+		set_attribute<Position>(POSITION_ATTRIBUTE, offsetof(Vertex, position));
+		set_attribute<Normal>(NORMAL_ATTRIBUTE, offsetof(Vertex, normal));
+		set_attribute<TexCoord>(TEX_COORD_ATTRIBUTE, offsetof(Vertex, tex_coord));
+	}
+
+	static void pack(const MeshData &data, unsigned char *out)
+	{
+		Vertex *vertices = (Vertex *) out;
+		bool normals = data.has_normals && data.normals.size() >= data.vertices.size();
+		bool tex_coords = data.has_texture && data.tex_coords.size() >= data.vertices.size();
+		for (size_t i = 0; i < data.vertices.size(); ++i)
+		{
+			vertices[i].position.pack(data.vertices[i]);
+			vertices[i].normal.pack(normals ? data.normals[i] : glm::vec3(0.f));
+			vertices[i].tex_coord.pack(tex_coords ? data.tex_coords[i] : glm::vec2(0.f));
+		}
+	}
+
+	static const VertexFormat *format()
+	{
+		static const VertexFormat f = { (GLsizei) sizeof(Vertex), &bind_attributes, &pack };
+		return &f;
+	}
+};
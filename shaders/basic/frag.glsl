@@ -6,24 +6,30 @@ struct Material {
     float shininess;
 };
 
-struct DirLight {
-    vec3 direction;
-    vec3 color;
-    float ambient_coeff;
-};
-
 in vec3 frag_pos;
 in vec3 frag_normal;
 in vec4 frag_pos_light;
 in vec2 frag_tex_coord;
+flat in vec4 frag_instance_color;
 
 out vec4 color;
 
+layout (std140) uniform PerFrame {
+    mat4 light_matrix;
+    vec4 light_direction;
+    vec4 light_color;
+    vec4 time;
+};
+
+layout (std140) uniform PerView {
+    mat4 projection;
+    mat4 view;
+    vec4 eye_pos;
+};
+
 uniform sampler2D shadow_map;
 uniform sampler2D texture_map;
-uniform vec3 eye_pos;
 uniform Material material;
-uniform DirLight dir_light;
 uniform bool shadows_enabled;
 uniform bool texture_enabled;
 uniform bool texture_noise;
@@ -36,9 +42,9 @@ float calc_shadows(vec4 pos_from_light, vec3 light_dir);
 void main()
 {
     vec3 normal = normalize(frag_normal);
-    vec3 view_dir = normalize(eye_pos - frag_pos);
-	vec3 light_dir = normalize(-dir_light.direction);
-    vec3 light_intensity = dir_light.color;
+    vec3 view_dir = normalize(eye_pos.xyz - frag_pos);
+	vec3 light_dir = normalize(-light_direction.xyz);
+    vec3 light_intensity = light_color.rgb;
 	vec3 result;
 	if (texture_enabled){		
 		vec3 tex_color;
@@ -46,10 +52,10 @@ void main()
 			tex_color = vec3(texture(texture_map, frag_tex_coord + noise));
 		else
 			tex_color = vec3(texture(texture_map, frag_tex_coord));
-		result = colorify_tex(normal, view_dir, light_dir, light_intensity, dir_light.ambient_coeff, tex_color);
+		result = colorify_tex(normal, view_dir, light_dir, light_intensity, light_color.a, tex_color);
 	}
 	else
-		result = colorify(normal, view_dir, light_dir, light_intensity, dir_light.ambient_coeff);
+		result = colorify(normal, view_dir, light_dir, light_intensity, light_color.a);
 
     color = vec4(result, 1.0f);
 }
@@ -84,8 +90,12 @@ float calc_shadows(vec4 pos_from_light, vec3 light_dir)
 
 vec3 colorify(vec3 normal, vec3 view_dir, vec3 light_dir, vec3 light_intensity, float ambient_coeff)
 {
+    // Instances may override the material colour.
+    vec3 diffuse_color = mix(material.diffuse, frag_instance_color.rgb, frag_instance_color.a);
+    vec3 ambient_color = mix(material.ambient, frag_instance_color.rgb, frag_instance_color.a);
+
     // Diffuse: c_d = c_l * k_d * dot(n, L)
-    vec3 diffuse = light_intensity * material.diffuse *
+    vec3 diffuse = light_intensity * diffuse_color *
         max(dot(normal, light_dir), 0.0);
 
     // Specular: c_s = c_l * k_s * dot(n, h)^s
@@ -93,7 +103,7 @@ vec3 colorify(vec3 normal, vec3 view_dir, vec3 light_dir, vec3 light_intensity,
         pow(max(dot(normal, normalize(light_dir + view_dir)), 0.0), material.shininess);
 
     // Ambient: c_a (ambient color) * k_a (coeff)
-    vec3 ambient = material.ambient * ambient_coeff;
+    vec3 ambient = ambient_color * ambient_coeff;
 
 	float shadow = 0;
 	if (shadows_enabled)
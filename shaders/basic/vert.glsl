@@ -2,23 +2,99 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 tex_coord;
+// Per-instance attributes, only read when instanced is set.
+layout (location = 3) in mat4 instance_model;
+layout (location = 7) in vec4 instance_color;
+layout (location = 8) in vec4 instance_sway;
+// Index into draws, only read when multi_draw is set.
+layout (location = 9) in uint draw_index;
 
 out vec3 frag_pos;
 out vec3 frag_normal;
 out vec4 frag_pos_light;
 out vec2 frag_tex_coord;
+flat out vec4 frag_instance_color;
+
+layout (std140) uniform PerFrame {
+    mat4 light_matrix;
+    vec4 light_direction;
+    vec4 light_color;
+    vec4 time;
+};
+
+layout (std140) uniform PerView {
+    mat4 projection;
+    mat4 view;
+    vec4 eye_pos;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform mat4 light_matrix;
-uniform mat4 mesh_model;
+uniform mat3 normal_matrix;
+uniform bool instanced;
+uniform samplerBuffer parts;
+uniform int part_count;
+uniform bool multi_draw;
+uniform samplerBuffer draws;
+
+const float SWAY_SPEED = 4.5; // Degrees per second.
+
+// Rotates v about the instance's sway axis by a triangle wave of the sway amplitude.
+vec3 sway(vec3 v, vec4 s)
+{
+    if (s.w <= 0.0)
+        return v;
+    float phase = fract(time.x * SWAY_SPEED / (4.0 * s.w) + 0.75);
+    float angle = radians(s.w * (1.0 - 4.0 * abs(phase - 0.5)));
+    vec3 k = normalize(s.xyz);
+    return v * cos(angle) + cross(k, v) * sin(angle) + k * dot(k, v) * (1.0 - cos(angle));
+}
+
+// Part matrices are stored as three rows per part; every instance repeats all parts.
+mat4 part_matrix()
+{
+    if (part_count == 0)
+        return mat4(1.0);
+    int base = (gl_InstanceID % part_count) * 3;
+    return transpose(mat4(texelFetch(parts, base), texelFetch(parts, base + 1), texelFetch(parts, base + 2), vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+// Draws are stored as the model matrix in three rows, then the normal matrix in three.
+mat4 draw_model()
+{
+    int base = int(draw_index) * 6;
+    return transpose(mat4(texelFetch(draws, base), texelFetch(draws, base + 1), texelFetch(draws, base + 2), vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+mat3 draw_normal_matrix()
+{
+    int base = int(draw_index) * 6 + 3;
+    return transpose(mat3(texelFetch(draws, base).xyz, texelFetch(draws, base + 1).xyz, texelFetch(draws, base + 2).xyz));
+}
 
 void main()
 {
-    gl_Position = projection * view * model * mesh_model * vec4(position, 1.0f);
-    frag_pos = vec3(model * mesh_model * vec4(position, 1.0f));
-    frag_normal = mat3(transpose(inverse(model * mesh_model))) * normal;
-	frag_pos_light = light_matrix * vec4(frag_pos, 1.0);
+    vec4 world_pos;
+    if (instanced) {
+        mat4 part = part_matrix();
+        world_pos = vec4(sway(vec3(model * instance_model * part * vec4(position, 1.0f)), instance_sway), 1.0f);
+        // Parts transform normals the way baked trees did; it looks better than the correct inverse transpose.
+        vec3 part_normal = part_count == 0 ? normal : vec3(part * vec4(normal, 1.0f));
+        // Instances only use uniform scale, so their upper 3x3 transforms normals.
+        frag_normal = sway(normal_matrix * mat3(instance_model) * part_normal, instance_sway);
+        frag_instance_color = instance_color;
+    }
+    else if (multi_draw) {
+        world_pos = draw_model() * vec4(position, 1.0f);
+        frag_normal = draw_normal_matrix() * normal;
+        frag_instance_color = vec4(0.0);
+    }
+    else {
+        world_pos = model * vec4(position, 1.0f);
+        frag_normal = normal_matrix * normal;
+        frag_instance_color = vec4(0.0);
+    }
+    gl_Position = projection * view * world_pos;
+    frag_pos = vec3(world_pos);
+	frag_pos_light = light_matrix * world_pos;
 	frag_tex_coord = vec2(tex_coord.x, 1.0 - tex_coord.y); //y-axis usually requires inverting
 }
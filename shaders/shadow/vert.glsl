@@ -1,11 +1,61 @@
 #version 330 core
 layout (location = 0) in vec3 position;
+layout (location = 3) in mat4 instance_model;
+layout (location = 8) in vec4 instance_sway;
+// Index into draws, only read when multi_draw is set.
+layout (location = 9) in uint draw_index;
+
+layout (std140) uniform PerFrame {
+    mat4 light_matrix;
+    vec4 light_direction;
+    vec4 light_color;
+    vec4 time;
+};
 
 uniform mat4 model;
-uniform mat4 view_projection;
-uniform mat4 mesh_model;
+uniform bool instanced;
+uniform samplerBuffer parts;
+uniform int part_count;
+uniform bool multi_draw;
+uniform samplerBuffer draws;
+
+const float SWAY_SPEED = 4.5; // Degrees per second.
+
+// Must match the basic shader so shadows follow swaying leaves.
+vec3 sway(vec3 v, vec4 s)
+{
+    if (s.w <= 0.0)
+        return v;
+    float phase = fract(time.x * SWAY_SPEED / (4.0 * s.w) + 0.75);
+    float angle = radians(s.w * (1.0 - 4.0 * abs(phase - 0.5)));
+    vec3 k = normalize(s.xyz);
+    return v * cos(angle) + cross(k, v) * sin(angle) + k * dot(k, v) * (1.0 - cos(angle));
+}
+
+// Part matrices are stored as three rows per part; every instance repeats all parts.
+mat4 part_matrix()
+{
+    if (part_count == 0)
+        return mat4(1.0);
+    int base = (gl_InstanceID % part_count) * 3;
+    return transpose(mat4(texelFetch(parts, base), texelFetch(parts, base + 1), texelFetch(parts, base + 2), vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+// Must match the basic shader's layout of draws.
+mat4 draw_model()
+{
+    int base = int(draw_index) * 6;
+    return transpose(mat4(texelFetch(draws, base), texelFetch(draws, base + 1), texelFetch(draws, base + 2), vec4(0.0, 0.0, 0.0, 1.0)));
+}
 
 void main()
 {
-    gl_Position = view_projection * model * mesh_model * vec4(position, 1.0f);
+    vec4 world_pos;
+    if (instanced)
+        world_pos = vec4(sway(vec3(model * instance_model * part_matrix() * vec4(position, 1.0f)), instance_sway), 1.0f);
+    else if (multi_draw)
+        world_pos = draw_model() * vec4(position, 1.0f);
+    else
+        world_pos = model * vec4(position, 1.0f);
+    gl_Position = light_matrix * world_pos;
 }
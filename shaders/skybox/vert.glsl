@@ -3,11 +3,15 @@ layout (location = 0) in vec3 position;
 
 out vec3 tex_coords;
 
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform PerView {
+    mat4 projection;
+    mat4 view;
+    vec4 eye_pos;
+};
 
 void main()
 {
-    gl_Position = projection * view * vec4(position, 1.0f);
+    // Strip translation from view matrix.
+    gl_Position = projection * mat4(mat3(view)) * vec4(position, 1.0f);
     tex_coords = position;
 }
@@ -0,0 +1,108 @@
+#version 330 core
+struct Material {
+    vec3 specular;
+    float shininess;
+};
+
+in vec3 frag_pos;
+in vec4 frag_pos_light;
+in vec2 frag_tex_coord;
+in float frag_height;
+
+out vec4 color;
+
+layout (std140) uniform PerFrame {
+    mat4 light_matrix;
+    vec4 light_direction;
+    vec4 light_color;
+    vec4 time;
+};
+
+layout (std140) uniform PerView {
+    mat4 projection;
+    mat4 view;
+    vec4 eye_pos;
+};
+
+const int MAX_BANDS = 3; // Must match MAX_TERRAIN_BANDS.
+
+uniform sampler2D shadow_map;
+uniform sampler2D band_texture0;
+uniform sampler2D band_texture1;
+uniform sampler2D band_texture2;
+// Per band: min height, max height, and whether normals point straight up.
+uniform vec4 bands[MAX_BANDS];
+uniform int band_count;
+uniform Material material;
+uniform bool shadows_enabled;
+
+float calc_shadows(vec4 pos_from_light, vec3 normal, vec3 light_dir);
+
+void main()
+{
+    // Sample and differentiate before any divergent branch.
+    vec3 band_colors[MAX_BANDS] = vec3[](
+        vec3(texture(band_texture0, frag_tex_coord)),
+        vec3(texture(band_texture1, frag_tex_coord)),
+        vec3(texture(band_texture2, frag_tex_coord)));
+    // Faceted normals, like the old per-triangle terrain.
+    vec3 face_normal = normalize(cross(dFdx(frag_pos), dFdy(frag_pos)));
+
+    // Later bands win where ranges overlap; heights outside every band are not drawn.
+    int band = -1;
+    for (int i = 0; i < band_count; ++i)
+        if (frag_height >= bands[i].x && frag_height <= bands[i].y)
+            band = i;
+    if (band < 0)
+        discard;
+
+    vec3 normal = bands[band].z > 0.5 ? vec3(0.0, 1.0, 0.0) : face_normal;
+    vec3 tex_color = band_colors[band];
+    vec3 view_dir = normalize(eye_pos.xyz - frag_pos);
+    vec3 light_dir = normalize(-light_direction.xyz);
+    vec3 light_intensity = light_color.rgb;
+
+    // Diffuse: c_d = c_l * k_d * dot(n, L)
+    vec3 diffuse = light_intensity * tex_color * max(dot(normal, light_dir), 0.0);
+
+    // Specular: c_s = c_l * k_s * dot(n, h)^s
+    vec3 specular = light_intensity * material.specular *
+        pow(max(dot(normal, normalize(light_dir + view_dir)), 0.0), material.shininess);
+
+    // Ambient: c_a (ambient color) * k_a (coeff)
+    vec3 ambient = tex_color * light_color.a;
+
+    float shadow = 0;
+    if (shadows_enabled)
+        shadow = calc_shadows(frag_pos_light, normal, light_dir);
+    color = vec4((1.0 - shadow) * (diffuse + specular) + ambient, 1.0f);
+}
+
+// Same filtering as the basic shader.
+float calc_shadows(vec4 pos_from_light, vec3 normal, vec3 light_dir)
+{
+	vec3 clip_coords = pos_from_light.xyz / pos_from_light.w;
+	// Transform to range of [0, 1] to fit depth map
+	clip_coords = clip_coords * 0.5 + 0.5;
+	float current_depth = clip_coords.z;
+
+	if (current_depth > 1.0) {
+		return 0.0;
+	}
+
+	float bias = max(0.005 * (1.0 - dot(normal, light_dir)), 0.003);
+	float shadow = 0.0;
+
+	vec2 texelSize = 1.0 / textureSize(shadow_map, 0);
+	for(int x = -1; x <= 1; ++x)
+	{
+		for(int y = -1; y <= 1; ++y)
+		{
+			float pcfDepth = texture(shadow_map, clip_coords.xy + vec2(x, y) * texelSize).r;
+			shadow += current_depth - bias > pcfDepth ? 1.0 : 0.0;
+		}
+	}
+	shadow /= 9.0;
+
+	return shadow;
+}
@@ -0,0 +1,68 @@
+#version 330 core
+// Integer grid coordinates within the shared patch.
+layout (location = 0) in vec3 position;
+// Per-chunk attributes.
+layout (location = 1) in vec4 chunk_area;
+layout (location = 2) in vec4 chunk_morph;
+
+out vec3 frag_pos;
+out vec4 frag_pos_light;
+out vec2 frag_tex_coord;
+out float frag_height;
+
+layout (std140) uniform PerFrame {
+    mat4 light_matrix;
+    vec4 light_direction;
+    vec4 light_color;
+    vec4 time;
+};
+
+layout (std140) uniform PerView {
+    mat4 projection;
+    mat4 view;
+    vec4 eye_pos;
+};
+
+uniform mat4 model;
+uniform sampler2D height_map;
+uniform float terrain_size;
+uniform float height_map_size;
+uniform vec3 lod_origin;
+
+const float PATCH_QUADS = 16.0; // Must match TERRAIN_PATCH_QUADS.
+const float TEXTURE_REPEAT = 10.0; // Band textures tile this often across the terrain.
+
+// Bilinear height at a point in terrain space, like Terrain::height_lookup.
+float height_at(vec2 p)
+{
+    vec2 cell = (p / terrain_size + 0.5) * (height_map_size - 1.0);
+    // Texture rows run along x.
+    return texture(height_map, (cell.yx + 0.5) / height_map_size).r;
+}
+
+vec2 grid_to_terrain(vec2 grid)
+{
+    return chunk_area.xy + grid * (chunk_area.z / PATCH_QUADS);
+}
+
+void main()
+{
+    vec2 grid = position.xz;
+    vec2 p = grid_to_terrain(grid);
+    vec4 world_pos = model * vec4(p.x, height_at(p), p.y, 1.0);
+
+    // Slide odd vertices onto their even neighbours as the chunk nears the end of its range,
+    // so it matches the coarser chunks next to it by the time they take over.
+    float morph = clamp((distance(vec3(world_pos), lod_origin) - chunk_morph.x) / (chunk_morph.y - chunk_morph.x), 0.0, 1.0);
+    grid -= fract(grid * 0.5) * 2.0 * morph;
+    p = grid_to_terrain(grid);
+    float height = height_at(p);
+    world_pos = model * vec4(p.x, height, p.y, 1.0);
+
+    gl_Position = projection * view * world_pos;
+    frag_pos = vec3(world_pos);
+    frag_pos_light = light_matrix * world_pos;
+    frag_height = height;
+    vec2 uv = (p / terrain_size + 0.5) * TEXTURE_REPEAT;
+    frag_tex_coord = vec2(uv.x, 1.0 - uv.y); //y-axis usually requires inverting
+}
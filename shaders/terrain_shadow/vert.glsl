@@ -0,0 +1,42 @@
+#version 330 core
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec4 chunk_area;
+layout (location = 2) in vec4 chunk_morph;
+
+layout (std140) uniform PerFrame {
+    mat4 light_matrix;
+    vec4 light_direction;
+    vec4 light_color;
+    vec4 time;
+};
+
+uniform mat4 model;
+uniform sampler2D height_map;
+uniform float terrain_size;
+uniform float height_map_size;
+uniform vec3 lod_origin;
+
+const float PATCH_QUADS = 16.0; // Must match TERRAIN_PATCH_QUADS.
+
+// Must match the terrain shader so shadows line up with the surface.
+float height_at(vec2 p)
+{
+    vec2 cell = (p / terrain_size + 0.5) * (height_map_size - 1.0);
+    return texture(height_map, (cell.yx + 0.5) / height_map_size).r;
+}
+
+vec2 grid_to_terrain(vec2 grid)
+{
+    return chunk_area.xy + grid * (chunk_area.z / PATCH_QUADS);
+}
+
+void main()
+{
+    vec2 grid = position.xz;
+    vec2 p = grid_to_terrain(grid);
+    vec4 world_pos = model * vec4(p.x, height_at(p), p.y, 1.0);
+    float morph = clamp((distance(vec3(world_pos), lod_origin) - chunk_morph.x) / (chunk_morph.y - chunk_morph.x), 0.0, 1.0);
+    grid -= fract(grid * 0.5) * 2.0 * morph;
+    p = grid_to_terrain(grid);
+    gl_Position = light_matrix * model * vec4(p.x, height_at(p), p.y, 1.0);
+}
@@ -0,0 +1,327 @@
+#include "asset_pack.h"
+#include "mapped_file.h"
+#include "texture_compression.h"
+#include "util.h"
+#include "SOIL.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+const char PACK_MAGIC[4] = { 'G', 'P', 'A', 'K' };
+const uint32_t PACK_VERSION = 2;
+// Blobs start on cache line boundaries.
+const size_t PACK_ALIGNMENT = 64;
+// In GL face order, starting at GL_TEXTURE_CUBE_MAP_POSITIVE_X.
+const char *const CUBE_FACES[] = { "right", "left", "top", "bottom", "back", "front" };
+
+struct PackHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t num_images;
+	uint32_t reserved;
+};
+
+MappedFile pack_file;
+const PackImage *pack_images = nullptr;
+uint32_t pack_num_images = 0;
+
+size_t align_up(size_t value)
+{
+	return (value + PACK_ALIGNMENT - 1) & ~(PACK_ALIGNMENT - 1);
+}
+
+// Paths are looked up with forward slashes, whichever way the caller wrote them.
+std::string pack_name(const std::string &path)
+{
+	std::string name = path;
+	std::replace(name.begin(), name.end(), '\\', '/');
+	return name;
+}
+
+GLuint level_dimension(GLuint size, GLuint level)
+{
+	return std::max(size >> level, 1u);
+}
+
+size_t level_size(const PackImage &image, GLuint level)
+{
+	return TextureCompression::level_size(image.format, image.width, image.height, level);
+}
+
+// Size of one face's chain, and of the whole image.
+size_t face_size(const PackImage &image)
+{
+	size_t size = 0;
+	for (GLuint level = 0; level < image.levels; ++level)
+		size += align_up(level_size(image, level));
+	return size;
+}
+
+bool AssetPack::open(const std::string &path)
+{
+	close();
+	if (!pack_file.open(path))
+		return false;
+
+	PackHeader header;
+	if (pack_file.size() < sizeof(header))
+	{
+		close();
+		return false;
+	}
+	memcpy(&header, pack_file.data(), sizeof(header));
+	if (memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 || header.version != PACK_VERSION
+		|| pack_file.size() < sizeof(header) + (size_t) header.num_images * sizeof(PackImage))
+	{
+		std::cerr << path << " is not a usable asset pack, loading loose files." << std::endl;
+		close();
+		return false;
+	}
+	pack_images = (const PackImage *) (pack_file.data() + sizeof(header));
+	pack_num_images = header.num_images;
+	for (uint32_t i = 0; i < pack_num_images; ++i)
+	{
+		if (pack_images[i].offset + pack_images[i].size > pack_file.size())
+		{
+			std::cerr << path << " is truncated, loading loose files." << std::endl;
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void AssetPack::close()
+{
+	pack_file.close();
+	pack_images = nullptr;
+	pack_num_images = 0;
+}
+
+const PackImage *AssetPack::find(const std::string &name)
+{
+	std::string key = pack_name(name);
+	for (uint32_t i = 0; i < pack_num_images; ++i)
+	{
+		if (strncmp(pack_images[i].name, key.c_str(), sizeof(pack_images[i].name)) == 0)
+			return &pack_images[i];
+	}
+	return nullptr;
+}
+
+const unsigned char *AssetPack::level_data(const PackImage *image, GLuint face, GLuint level, size_t &size)
+{
+	size_t offset = (size_t) image->offset + face * face_size(*image);
+	for (GLuint l = 0; l < level; ++l)
+		offset += align_up(level_size(*image, l));
+	size = level_size(*image, level);
+	return pack_file.data() + offset;
+}
+
+bool AssetPack::load(const PackImage *image, TextureData &data)
+{
+	if (!image || !TextureCompression::supported(image->format))
+		return false;
+
+	data.target = image->faces == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+	data.format = image->format;
+	data.type = image->type;
+	data.generate_mipmaps = false;
+	data.levels.clear();
+	for (GLuint face = 0; face < image->faces; ++face)
+	{
+		GLenum target = image->faces == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+		for (GLuint level = 0; level < image->levels; ++level)
+		{
+			size_t size;
+			const unsigned char *pixels = level_data(image, face, level, size);
+			data.levels.push_back({ target, (GLint) level, (GLsizei) level_dimension(image->width, level), (GLsizei) level_dimension(image->height, level), pixels, size });
+		}
+	}
+	return true;
+}
+
+bool AssetPack::load_texture(const std::string &path, TextureData &data)
+{
+	const PackImage *image = find(path);
+	return image && image->faces == 1 && load(image, data);
+}
+
+bool AssetPack::load_cubemap(const std::string &directory, TextureData &data)
+{
+	const PackImage *image = find(directory);
+	return image && image->faces == 6 && load(image, data);
+}
+
+bool ends_with(const std::string &path, const char *suffix)
+{
+	size_t length = strlen(suffix);
+	return path.size() > length && path.compare(path.size() - length, length, suffix) == 0;
+}
+
+// Decodes an image file to RGB the way the loose-file loaders do.
+bool load_rgb(const std::string &path, std::vector<unsigned char> &pixels, int &width, int &height)
+{
+	if (ends_with(path, ".ppm"))
+	{
+		unsigned char *image = Util::loadPPM(path.c_str(), width, height);
+		if (!image)
+			return false;
+		pixels.assign(image, image + (size_t) width * height * 3);
+		delete[] image;
+		return true;
+	}
+	int channels;
+	unsigned char *image = SOIL_load_image(path.c_str(), &width, &height, &channels, SOIL_LOAD_RGB);
+	if (!image)
+	{
+		std::cerr << "Could not load " << path << ": " << SOIL_last_result() << std::endl;
+		return false;
+	}
+	pixels.assign(image, image + (size_t) width * height * 3);
+	SOIL_free_image_data(image);
+	return true;
+}
+
+// Appends one face's level chain to the blob, each level aligned. Levels are BC1-encoded,
+// except that DDS files keep the blocks they were authored with; a DDS in another format
+// keeps it only if it brings its whole chain, since lower levels can only be encoded as BC1.
+bool append_face(std::vector<unsigned char> &blob, PackImage &image, const std::string &path, bool mipmaps)
+{
+	std::vector<unsigned char> pixels;
+	int width, height;
+	if (!load_rgb(path, pixels, width, height))
+		return false;
+	if (image.width == 0)
+	{
+		image.width = width;
+		image.height = height;
+		image.levels = 1;
+		if (mipmaps)
+		{
+			while ((std::max(image.width, image.height) >> image.levels) > 0)
+				image.levels++;
+		}
+	}
+	else if (image.width != (uint32_t) width || image.height != (uint32_t) height)
+	{
+		std::cerr << path << " does not match the size of the other faces." << std::endl;
+		return false;
+	}
+
+	MappedFile file;
+	CompressedImage source;
+	GLuint source_levels = 0;
+	if (image.faces == 1 && ends_with(path, ".dds") && file.open(path) && TextureCompression::parse_dds(file.data(), file.size(), source)
+		&& source.width == image.width && source.height == image.height
+		&& (source.format == image.format || source.levels >= image.levels))
+	{
+		image.format = source.format;
+		source_levels = std::min(source.levels, image.levels);
+	}
+
+	const unsigned char *source_data = source_levels > 0 ? source.data : nullptr;
+	for (GLuint level = 0; level < image.levels; ++level)
+	{
+		if (level > 0)
+			pixels = TextureCompression::downsample(pixels, level_dimension(image.width, level - 1), level_dimension(image.height, level - 1));
+		if (level < source_levels)
+		{
+			size_t size = level_size(image, level);
+			blob.insert(blob.end(), source_data, source_data + size);
+			source_data += size;
+		}
+		else
+		{
+			std::vector<unsigned char> blocks = TextureCompression::encode_bc1(pixels.data(), level_dimension(image.width, level), level_dimension(image.height, level));
+			if (blocks.size() != level_size(image, level))
+			{
+				std::cerr << "Could not compress " << path << std::endl;
+				return false;
+			}
+			blob.insert(blob.end(), blocks.begin(), blocks.end());
+		}
+		blob.resize(align_up(blob.size()), 0);
+	}
+	return true;
+}
+
+bool AssetPack::bake(const std::string &path, const std::vector<std::string> &textures, const std::vector<std::string> &cubemaps)
+{
+	std::vector<PackImage> images;
+	std::vector<std::vector<unsigned char>> blobs;
+
+	for (size_t i = 0; i < textures.size() + cubemaps.size(); ++i)
+	{
+		bool cubemap = i >= textures.size();
+		std::string name = pack_name(cubemap ? cubemaps[i - textures.size()] : textures[i]);
+		if (name.size() >= sizeof(PackImage::name))
+		{
+			std::cerr << name << " is too long a name for the pack." << std::endl;
+			return false;
+		}
+
+		PackImage image;
+		memset(&image, 0, sizeof(image));
+		strncpy(image.name, name.c_str(), sizeof(image.name) - 1);
+		image.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		std::vector<unsigned char> blob;
+		if (cubemap)
+		{
+			// Skyboxes are only ever sampled at full size.
+			image.faces = 6;
+			for (const char *face : CUBE_FACES)
+			{
+				if (!append_face(blob, image, name + "/" + face + ".ppm", false))
+					return false;
+			}
+		}
+		else
+		{
+			image.faces = 1;
+			if (!append_face(blob, image, name, true))
+				return false;
+		}
+		image.size = blob.size();
+		images.push_back(image);
+		blobs.push_back(std::move(blob));
+		std::cerr << "Baked " << name << " (" << image.width << "x" << image.height << ", " << image.levels << " levels)" << std::endl;
+	}
+
+	PackHeader header;
+	memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+	header.version = PACK_VERSION;
+	header.num_images = (uint32_t) images.size();
+	header.reserved = 0;
+	size_t offset = align_up(sizeof(header) + images.size() * sizeof(PackImage));
+	for (PackImage &image : images)
+	{
+		image.offset = offset;
+		offset += align_up((size_t) image.size);
+	}
+
+	FILE *out = fopen(path.c_str(), "wb");
+	if (!out)
+	{
+		std::cerr << "Could not write " << path << std::endl;
+		return false;
+	}
+	std::vector<unsigned char> padding(PACK_ALIGNMENT, 0);
+	fwrite(&header, sizeof(header), 1, out);
+	fwrite(images.data(), sizeof(PackImage), images.size(), out);
+	size_t written = sizeof(header) + images.size() * sizeof(PackImage);
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		fwrite(padding.data(), 1, (size_t) images[i].offset - written, out);
+		fwrite(blobs[i].data(), 1, blobs[i].size(), out);
+		written = (size_t) images[i].offset + blobs[i].size();
+	}
+	bool ok = !ferror(out);
+	ok = fclose(out) == 0 && ok;
+	if (!ok)
+		std::cerr << "Could not write " << path << std::endl;
+	return ok;
+}
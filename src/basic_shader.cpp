@@ -2,70 +2,120 @@
 #include "shader_manager.h"
 #include "shadow_shader.h"
 #include "util.h"
+#include "gl_state.h"
+#include "texture_cache.h"
 
 #include <iostream>
 
-BasicShader::BasicShader(GLuint shader_id) : Shader(shader_id) {}
+BasicShader::BasicShader(GLuint shader_id) : Shader(shader_id)
+{
+	material_diffuse_loc = uniform("material.diffuse");
+	material_specular_loc = uniform("material.specular");
+	material_ambient_loc = uniform("material.ambient");
+	material_shininess_loc = uniform("material.shininess");
+	shadows_enabled_loc = uniform("shadows_enabled");
+	texture_enabled_loc = uniform("texture_enabled");
+	texture_noise_loc = uniform("texture_noise");
+	noise_loc = uniform("noise");
+	model_loc = uniform("model");
+	normal_matrix_loc = uniform("normal_matrix");
+	instanced_loc = uniform("instanced");
+	part_count_loc = uniform("part_count");
+	multi_draw_loc = uniform("multi_draw");
+
+	// Sampler units never change, so set them once.
+	GLState::use_program(shader_id);
+	set_uniform(uniform("shadow_map"), 0);
+	set_uniform(uniform("texture_map"), 1);
+	set_uniform(uniform("parts"), (GLint) PARTS_TEXTURE_UNIT);
+	set_uniform(uniform("draws"), (GLint) DRAWS_TEXTURE_UNIT);
+	GLState::use_program(0);
+}
 
 //Adds Noise to Water Texture
 float noise0 = 0.f;
 float noise1 = 0.f;
+// Drawn every frame, so kept apart from the world stream that generation depends on.
+Random noise_random;
 
 void BasicShader::set_material(Material m)
 {
-	glUniform3f(glGetUniformLocation(shader_id, "material.diffuse"), m.diffuse.x, m.diffuse.y, m.diffuse.z);
-	glUniform3f(glGetUniformLocation(shader_id, "material.specular"), m.specular.x, m.specular.y, m.specular.z);
-	glUniform3f(glGetUniformLocation(shader_id, "material.ambient"), m.ambient.x, m.ambient.y, m.ambient.z);
-	glUniform1f(glGetUniformLocation(shader_id, "material.shininess"), m.shininess);
-	glUniform1i(glGetUniformLocation(shader_id, "shadows_enabled"), m.shadows);
+	set_uniform(material_diffuse_loc, m.diffuse);
+	set_uniform(material_specular_loc, m.specular);
+	set_uniform(material_ambient_loc, m.ambient);
+	set_uniform(material_shininess_loc, m.shininess);
+	set_uniform(shadows_enabled_loc, (GLint) m.shadows);
 }
 
-void BasicShader::draw(Geometry *g, glm::mat4 to_world)
+void BasicShader::prepare(Geometry *g, glm::mat4 model, bool instanced)
 {
 	// Bind depth texture from shadow shader, if it exists.
 	ShadowShader * ss = (ShadowShader *) ShaderManager::get_shader_program("shadow");
 	if (ss)
-	{
-		glUniformMatrix4fv(glGetUniformLocation(shader_id, "light_matrix"), 1, GL_FALSE, &ss->light_matrix[0][0]);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, ss->shadow_map_tex);
-		glUniform1i(glGetUniformLocation(shader_id, "shadow_map"), 0);
-
-		// Basic lighting
-		glm::vec3 light_pos = ss->light_pos;
-		glUniform3f(glGetUniformLocation(shader_id, "dir_light.direction"), -light_pos.x, -light_pos.y, -light_pos.z);
-		glUniform3f(glGetUniformLocation(shader_id, "dir_light.color"), 1.f, 1.f, 1.f);
-		glUniform1f(glGetUniformLocation(shader_id, "dir_light.ambient_coeff"), 0.2f);
-	}
+		GLState::bind_texture(0, GL_TEXTURE_2D, ss->shadow_map_tex);
 
-	// Send camera position for shading
-	glUniform3f(glGetUniformLocation(shader_id, "eye_pos"), cam_pos.x, cam_pos.y, cam_pos.z);
-	// Send projection and view matrices
-	glUniformMatrix4fv(glGetUniformLocation(shader_id, "projection"), 1, GL_FALSE, &P[0][0]);
-	glUniformMatrix4fv(glGetUniformLocation(shader_id, "view"), 1, GL_FALSE, &V[0][0]);
-	// Model matrix
-	glUniformMatrix4fv(glGetUniformLocation(shader_id, "model"), 1, GL_FALSE, &to_world[0][0]);
-	glUniformMatrix4fv(glGetUniformLocation(shader_id, "mesh_model"), 1, GL_FALSE, &mesh_model[0][0]);
+	// Lighting, camera and projection come from the shared uniform blocks.
+	set_uniform(model_loc, model);
+	set_uniform(normal_matrix_loc, glm::mat3(glm::transpose(glm::inverse(model))));
+	set_uniform(instanced_loc, (GLint) instanced);
 
-	glUniform1i(glGetUniformLocation(shader_id, "texture_enabled"), g->has_texture);
-	glUniform1i(glGetUniformLocation(shader_id, "texture_noise"), g->add_texture_noise);
+	set_uniform(texture_enabled_loc, (GLint) g->has_texture);
+	set_uniform(texture_noise_loc, (GLint) g->add_texture_noise);
 	//Bind Texture
 	if (g->has_texture)
 	{
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, g->texture);
-		glUniform1i(glGetUniformLocation(shader_id, "texture_map"), 1);
+		GLState::bind_texture(1, GL_TEXTURE_2D, TextureCache::drawable(g->texture));
 
 		if (g->add_texture_noise)
 		{
-			noise0 += Util::random(0, 0.001f);
-			noise1 += Util::random(0, 0.001f);
-			glUniform2f(glGetUniformLocation(shader_id, "noise"), noise0, noise1);
+			noise0 += noise_random.random(0, 0.001f);
+			noise1 += noise_random.random(0, 0.001f);
+			set_uniform(noise_loc, glm::vec2(noise0, noise1));
 		}			
 	}
+}
+
+void BasicShader::draw(Geometry *g, glm::mat4 to_world)
+{
+	prepare(g, to_world * mesh_model, false);
 
 	// Bind geometry and draw
 	g->bind();
 	g->draw();
-	glBindVertexArray(0);
+}
+
+void BasicShader::draw_instanced(Geometry *g, const InstanceBatch &batch, glm::mat4 to_world)
+{
+	prepare(g, to_world, true);
+	set_uniform(part_count_loc, (GLint) batch.part_count);
+	if (batch.parts_texture)
+		GLState::bind_texture(PARTS_TEXTURE_UNIT, GL_TEXTURE_BUFFER, batch.parts_texture);
+
+	GLState::bind_vertex_array(batch.vao);
+	g->draw_instanced(batch.count);
+}
+
+bool BasicShader::batchable(Geometry *g)
+{
+	// Water animates its texture per draw, so it keeps the single-draw path.
+	return MultiDraw::supported() && !g->add_texture_noise;
+}
+
+void BasicShader::draw_multi(MultiDraw &batch)
+{
+	if (batch.empty())
+		return;
+	// The queue only batches draws that share a texture, so the first one speaks for all.
+	Geometry *g = batch.first();
+	ShadowShader * ss = (ShadowShader *) ShaderManager::get_shader_program("shadow");
+	if (ss)
+		GLState::bind_texture(0, GL_TEXTURE_2D, ss->shadow_map_tex);
+	set_uniform(instanced_loc, 0);
+	set_uniform(multi_draw_loc, 1);
+	set_uniform(texture_enabled_loc, (GLint) g->has_texture);
+	set_uniform(texture_noise_loc, 0);
+	if (g->has_texture)
+		GLState::bind_texture(1, GL_TEXTURE_2D, TextureCache::drawable(g->texture));
+	batch.submit();
+	set_uniform(multi_draw_loc, 0);
 }
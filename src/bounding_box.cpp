@@ -0,0 +1,83 @@
+#include "bounding_box.h"
+
+BoundingBox::BoundingBox()
+{
+	reset();
+}
+
+BoundingBox::~BoundingBox()
+{
+}
+
+void BoundingBox::reset()
+{
+	min_pt = glm::vec3(0.f);
+	max_pt = glm::vec3(0.f);
+	empty = true;
+	infinite = false;
+}
+
+void BoundingBox::expand(glm::vec3 p)
+{
+	if (empty)
+	{
+		min_pt = max_pt = p;
+		empty = false;
+		return;
+	}
+	min_pt = glm::min(min_pt, p);
+	max_pt = glm::max(max_pt, p);
+}
+
+void BoundingBox::expand(const BoundingBox &b)
+{
+	infinite = infinite || b.infinite;
+	if (b.empty)
+		return;
+	expand(b.min_pt);
+	expand(b.max_pt);
+}
+
+void BoundingBox::inflate(GLfloat amount)
+{
+	if (empty)
+		return;
+	min_pt -= glm::vec3(amount);
+	max_pt += glm::vec3(amount);
+}
+
+BoundingBox BoundingBox::transform(glm::mat4 m) const
+{
+	BoundingBox result;
+	result.infinite = infinite;
+	if (empty)
+		return result;
+
+	// Transform center, then project the half extents onto each new axis (Arvo).
+	glm::vec3 c = glm::vec3(m * glm::vec4(center(), 1.f));
+	glm::vec3 e = extent();
+	glm::vec3 new_e;
+	for (int i = 0; i < 3; ++i)
+		new_e[i] = glm::abs(m[0][i]) * e.x + glm::abs(m[1][i]) * e.y + glm::abs(m[2][i]) * e.z;
+
+	result.min_pt = c - new_e;
+	result.max_pt = c + new_e;
+	result.empty = false;
+	return result;
+}
+
+glm::vec3 BoundingBox::center() const
+{
+	return (min_pt + max_pt) * 0.5f;
+}
+
+glm::vec3 BoundingBox::extent() const
+{
+	return (max_pt - min_pt) * 0.5f;
+}
+
+GLfloat BoundingBox::distance(glm::vec3 p) const
+{
+	// Zero inside the box.
+	return glm::length(p - glm::clamp(p, min_pt, max_pt));
+}
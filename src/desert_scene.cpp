@@ -4,14 +4,16 @@
 #include "util.h"
 #include "terrain.h"
 #include "geometry_generator.h"
+#include "scene_terrain.h"
 #include "shape_grammar.h"
 
+#include <memory>
+
 const GLfloat PLAYER_HEIGHT = Global::PLAYER_HEIGHT;
 
 const GLuint    HEIGHT_MAP_POWER = 8;
 const GLuint    HEIGHT_MAP_SIZE = (unsigned int)glm::pow(2, HEIGHT_MAP_POWER) + 1;
 const GLint     VILLAGE_DIAMETER = 1;
-const GLuint    TERRAIN_RESOLUTION = 200;
 
 const GLfloat   SIZE = 50.f * PLAYER_HEIGHT;
 const GLfloat   HEIGHT_MAP_MAX = -20.f * PLAYER_HEIGHT;
@@ -51,7 +53,7 @@ void DesertScene::setup()
 	float z = -30.f;
 	float y = Terrain::height_lookup(x, z, SIZE * 2, height_map);
 	glm::vec3 location = { x, y, z };
-	SceneModel *building = ShapeGrammar::generate_building(this, true, 0);
+	SceneModel *building = ShapeGrammar::generate_building(this, true, rng.fork());
 	SceneTransform *building_rotate = new SceneTransform(this, glm::rotate(glm::mat4(1.f), glm::radians(-52.f), glm::vec3(0.f, 1.f, 0.f)));
 	SceneTransform *building_translate = new SceneTransform(this, glm::translate(glm::mat4(1.f), location));
 	building_rotate->add_child(building);
@@ -70,7 +72,7 @@ void DesertScene::generate_planes()
 {
 	/*
 	// Curvy beach plane, named Bezier Beach Resort
-	Geometry *beach_geo = GeometryGenerator::generate_bezier_plane(SIZE*1.5f, 50, 150, 0.1f, SAND, 0);
+	Geometry *beach_geo = GeometryGenerator::generate_bezier_plane(SIZE*1.5f, 50, 150, 0.1f, SAND, rng.next());
 	Material beach_material;
 	beach_material.diffuse = beach_material.ambient = color::windwaker_sand;
 	beach_material.shadows = false;
@@ -85,10 +87,23 @@ void DesertScene::generate_planes()
 	*/
 }
 
-void DesertScene::generate_map()
+void DesertScene::prepare()
 {
-	std::cerr << "Generating Map...";
+	height_map = Terrain::generate_height_map(HEIGHT_MAP_SIZE, HEIGHT_MAP_MAX, VILLAGE_DIAMETER, HEIGHT_RANDOMNESS_SCALE, false, true, TERRAIN_SMOOTHNESS, rng.next());
+}
 
+SceneTerrain *DesertScene::build_terrain(const HeightMap &map)
+{
+	// Desert Sand
+	Material sand_material;
+	sand_material.diffuse = sand_material.ambient = color::windwaker_sand;
+	SceneTerrain *terrain = new SceneTerrain(this, TERRAIN_SIZE, map, sand_material);
+	terrain->add_band(-1000.f, 1000.f, SAND_TWO, false);
+	return terrain;
+}
+
+void DesertScene::place_map(SceneTerrain *terrain)
+{
 	if (!map)
 	{
 		map = new SceneTransform(this, glm::scale(glm::mat4(1.f), glm::vec3(TERRAIN_SCALE, 1.f, TERRAIN_SCALE)));
@@ -98,18 +113,26 @@ void DesertScene::generate_map()
 	{
 		map->remove_all();
 	}
+	map->add_child(terrain);
+}
 
-
-	height_map = Terrain::generate_height_map(HEIGHT_MAP_SIZE, HEIGHT_MAP_MAX, VILLAGE_DIAMETER, HEIGHT_RANDOMNESS_SCALE, false, true, TERRAIN_SMOOTHNESS, 0);
-
-	// Desert Sand
-	Geometry *sand_geo = GeometryGenerator::generate_terrain(TERRAIN_SIZE, TERRAIN_RESOLUTION, -1000.f, 1000.f, false, SAND_TWO, height_map);
-	Material sand_material;
-	sand_material.diffuse = sand_material.ambient = color::windwaker_sand;
-	Mesh sand_mesh = { sand_geo, sand_material, ShaderManager::get_default(), glm::mat4(1.f) };
-
-	SceneModel *terrain_model = new SceneModel(this);
-	terrain_model->add_mesh(sand_mesh);
-	map->add_child(terrain_model);
+void DesertScene::generate_map()
+{
+	std::cerr << "Generating Map...";
+	place_map(build_terrain(height_map));
 	std::cerr << "OK." << std::endl;
-}
\ No newline at end of file
+}
+
+void DesertScene::regenerate_map()
+{
+	uint32_t seed = rng.next();
+	std::shared_ptr<HeightMap> new_map = std::make_shared<HeightMap>();
+	std::shared_ptr<SceneTerrain *> terrain = std::make_shared<SceneTerrain *>(nullptr);
+	regenerate([=]() {
+		*new_map = Terrain::generate_height_map(HEIGHT_MAP_SIZE, HEIGHT_MAP_MAX, VILLAGE_DIAMETER, HEIGHT_RANDOMNESS_SCALE, false, true, TERRAIN_SMOOTHNESS, seed);
+		*terrain = build_terrain(*new_map);
+	}, [=]() {
+		height_map = std::move(*new_map);
+		place_map(*terrain);
+	});
+}
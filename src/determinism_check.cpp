@@ -0,0 +1,113 @@
+#include "determinism_check.h"
+#include "terrain.h"
+#include "tree.h"
+#include "shape_grammar.h"
+#include "scene_model.h"
+#include "job_system.h"
+#include "procedural_cache.h"
+#include "random.h"
+#include "global.h"
+
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+const uint32_t CHECK_SEED = 12345;
+// Enough workers that jobs really interleave, whatever the machine.
+const unsigned int CHECK_WORKERS = 4;
+// Races only show up now and then, so the parallel side runs a few times.
+const unsigned int PARALLEL_RUNS = 3;
+
+// The island's generation settings; the tiled map size also covers the Morton layout.
+const GLuint MAP_SIZE = 1025;
+const GLfloat MAP_MAX_HEIGHT = 10.f * Global::PLAYER_HEIGHT;
+const GLint MAP_VILLAGE_DIAMETER = (GLint) (0.23f * MAP_SIZE);
+const GLfloat MAP_SMOOTHNESS = 1.2f;
+const unsigned int NUM_VARIANTS = 8;
+const unsigned int TREE_ITERATIONS = 7;
+const unsigned int TREE_LEAF_LAYERS = 1;
+const GLfloat TREE_ANGLE = 20.f;
+const GLfloat TREE_SIZE = 2.f;
+const unsigned int NUM_BUILDINGS = 5;
+
+template <typename T>
+void hash_vector(CacheKey &hash, const std::vector<T> &values)
+{
+	hash << (uint64_t) values.size();
+	hash.add(values.data(), values.size() * sizeof(T));
+}
+
+uint64_t DeterminismCheck::generate(uint32_t seed)
+{
+	Random rng(seed);
+	CacheKey hash("determinism");
+
+	// Hashed by coordinate, so the layout the map happens to use does not matter.
+	HeightMap map = Terrain::generate_height_map(MAP_SIZE, MAP_MAX_HEIGHT, MAP_VILLAGE_DIAMETER, MAP_MAX_HEIGHT, false, true, MAP_SMOOTHNESS, rng.next());
+	for (GLuint x = 0; x < map.size(); ++x)
+		for (GLuint y = 0; y < map.size(); ++y)
+			hash << map.at(x, y);
+
+	// Variants grow in parallel the way Tree::generate_forest grows them.
+	Random tree_rng = rng.fork();
+	std::vector<TreeParts> variants(NUM_VARIANTS);
+	JobSystem::parallel_for(NUM_VARIANTS, 1, [&](unsigned int begin, unsigned int end) {
+		for (unsigned int v = begin; v < end; ++v)
+			Tree::grow_variant(variants[v], v, TREE_ITERATIONS, TREE_LEAF_LAYERS, TREE_ANGLE, TREE_SIZE, tree_rng);
+	});
+	for (const TreeParts &parts : variants)
+	{
+		hash << parts.angle_delta << parts.size << parts.leaf_layers;
+		hash_vector(hash, parts.branches);
+		hash_vector(hash, parts.leaves);
+	}
+
+	// One stream per building, handed out up front like IslandScene does.
+	std::vector<Random> building_rngs;
+	for (unsigned int i = 0; i < NUM_BUILDINGS; ++i)
+		building_rngs.push_back(rng.fork());
+	std::vector<SceneModel *> buildings(NUM_BUILDINGS);
+	JobSystem::parallel_for(NUM_BUILDINGS, 1, [&](unsigned int begin, unsigned int end) {
+		for (unsigned int i = begin; i < end; ++i)
+			buildings[i] = ShapeGrammar::generate_building(nullptr, true, building_rngs[i]);
+	});
+	for (SceneModel *building : buildings)
+	{
+		hash << (uint64_t) building->meshes.size();
+		for (const Mesh &mesh : building->meshes)
+		{
+			const Material &m = mesh.material;
+			hash << m.ambient.x << m.ambient.y << m.ambient.z << m.diffuse.x << m.diffuse.y << m.diffuse.z
+				<< m.specular.x << m.specular.y << m.specular.z << m.shininess << m.shadows;
+			for (int c = 0; c < 4; ++c)
+				for (int r = 0; r < 4; ++r)
+					hash << mesh.to_world[c][r];
+			hash_vector(hash, mesh.geometry->vertices);
+			hash_vector(hash, mesh.geometry->normals);
+			hash_vector(hash, mesh.geometry->tex_coords);
+			hash_vector(hash, mesh.geometry->indices);
+		}
+		// Never uploaded, so this only takes the geometry back out of the upload queue.
+		delete building;
+	}
+	return hash.value();
+}
+
+bool DeterminismCheck::run()
+{
+	// Before the job system starts there is only the main thread, so everything runs inline.
+	uint64_t serial = generate(CHECK_SEED);
+	std::cerr << "Serial: " << std::hex << std::setw(16) << std::setfill('0') << serial << std::dec << std::endl;
+
+	bool same = true;
+	JobSystem::init(CHECK_WORKERS);
+	for (unsigned int i = 0; i < PARALLEL_RUNS; ++i)
+	{
+		uint64_t parallel = generate(CHECK_SEED);
+		std::cerr << "Parallel (" << JobSystem::num_threads() << " threads): " << std::hex << std::setw(16) << std::setfill('0') << parallel << std::dec
+			<< (parallel == serial ? "" : " MISMATCH") << std::endl;
+		same = same && parallel == serial;
+	}
+	JobSystem::destroy();
+	return same;
+}
@@ -4,6 +4,7 @@
 #include "util.h"
 #include "terrain.h"
 #include "geometry_generator.h"
+#include "scene_terrain.h"
 #include "shape_grammar.h"
 #include "tree.h"
 
@@ -12,10 +13,10 @@ const GLfloat PLAYER_HEIGHT = Global::PLAYER_HEIGHT;
 const GLuint    HEIGHT_MAP_POWER = 8;
 const GLuint    HEIGHT_MAP_SIZE = (unsigned int)glm::pow(2, HEIGHT_MAP_POWER) + 1;
 const GLint     VILLAGE_DIAMETER = (int)(0.23f * HEIGHT_MAP_SIZE);
-const GLuint    TERRAIN_RESOLUTION = 200;
 const GLuint    NUM_TREES = 100;
 const GLfloat   PERCENT_TREE_ANIM = 0.9f;
 const GLfloat   TREE_SCALE = 1.5f;
+const GLuint    NUM_TREE_VARIANTS = 8;
 
 const GLfloat   SIZE = 30.f * PLAYER_HEIGHT;
 const GLfloat   HEIGHT_MAP_MAX = 10.f * PLAYER_HEIGHT;
@@ -48,7 +49,7 @@ void FireScene::setup()
 void FireScene::generate_planes()
 {	
 	// Curvy beach plane, named Bezier Beach Resort
-	Geometry *beach_geo = GeometryGenerator::generate_bezier_plane(SIZE*1.5f, 50, 150, 0.1f, OBSIDIAN, 0);
+	Geometry *beach_geo = GeometryGenerator::generate_bezier_plane(SIZE*1.5f, 50, 150, 0.1f, OBSIDIAN, rng.next());
 	Material beach_material;
 	beach_material.diffuse = beach_material.ambient = color::windwaker_sand;
 	beach_material.shadows = false;
@@ -74,20 +75,22 @@ void FireScene::generate_forest()
 
 	glm::vec3 leaf_colors[] = { color::black };
 	glm::vec3 branch_colors[] = { color::black };
-	Material branch_material, leaf_material;
+	std::vector<TreeInstance> trees;
+	Random forest_rng = rng.fork();
 	for (int i = 0; i < NUM_TREES; ++i)
 	{
 		if (i % 49 == 0)
 			std::cerr << " . ";
 
 		// Randomise colours, animation, location.
-		leaf_material.diffuse = leaf_material.ambient = leaf_colors[0];
-		branch_material.diffuse = branch_material.ambient = branch_colors[0];
+		TreeInstance tree;
+		tree.leaf_color = leaf_colors[0];
+		tree.branch_color = branch_colors[0];
 		float x, z;
 		do
 		{
-			float angle = Util::random(0, 360);
-			float distance = Util::random(FOREST_INNER_CIRCLE, FOREST_RADIUS);
+			float angle = forest_rng.random(0, 360);
+			float distance = forest_rng.random(FOREST_INNER_CIRCLE, FOREST_RADIUS);
 
 			x = glm::cos(glm::radians(angle)) * distance;
 			z = glm::sin(glm::radians(angle)) * distance;
@@ -95,30 +98,31 @@ void FireScene::generate_forest()
 		float y = Terrain::height_lookup(x, z, SIZE * 2, height_map);
 		glm::vec3 location = { x, y, z };
 
-		SceneGroup *tree = Tree::generate_tree(this, cylinder_geo, diamond_geo, 7, 0, 20.f, 2.f, branch_material, leaf_material, false, location, 0);
-		((SceneModel *)(tree->children[0]))->meshes[0].to_world = glm::translate(glm::mat4(1.f), location) * glm::scale(glm::mat4(1.f), glm::vec3(TREE_SCALE));
-
-		forest->add_child(tree);
+		// Spin each instance so repeated variants don't line up.
+		tree.to_world = glm::translate(glm::mat4(1.f), location) * glm::rotate(glm::mat4(1.f), glm::radians(forest_rng.random(0, 360)), glm::vec3(0.f, 1.f, 0.f)) * glm::scale(glm::mat4(1.f), glm::vec3(TREE_SCALE));
+		tree.animated = false;
+		trees.push_back(tree);
 	}
+	forest->add_child(Tree::generate_forest(this, cylinder_geo, diamond_geo, NUM_TREE_VARIANTS, 7, 0, 20.f, 2.f, trees, forest_rng.fork()));
 	std::cerr << "OK." << std::endl;
 }
 
+void FireScene::prepare()
+{
+	height_map = Terrain::generate_height_map(HEIGHT_MAP_SIZE, HEIGHT_MAP_MAX, VILLAGE_DIAMETER, HEIGHT_RANDOMNESS_SCALE, true, false, TERRAIN_SMOOTHNESS, rng.next());
+}
+
 void FireScene::generate_map()
 {
 	std::cerr << "Generating Map...";
 
 	SceneTransform *map = new SceneTransform(this, glm::scale(glm::mat4(1.f), glm::vec3(TERRAIN_SCALE, 1.f, TERRAIN_SCALE)));
 	root->add_child(map);
-
-	height_map = Terrain::generate_height_map(HEIGHT_MAP_SIZE, HEIGHT_MAP_MAX, VILLAGE_DIAMETER, HEIGHT_RANDOMNESS_SCALE, true, false, TERRAIN_SMOOTHNESS, 0);
 	
-	Geometry *sand_geo = GeometryGenerator::generate_terrain(TERRAIN_SIZE, TERRAIN_RESOLUTION, -20.f, 1000.f, false, OBSIDIAN, height_map);
 	Material sand_material;
 	sand_material.diffuse = sand_material.ambient = color::windwaker_sand;
-	Mesh sand_mesh = { sand_geo, sand_material, ShaderManager::get_default(), glm::mat4(1.f) };
-
-	SceneModel *terrain_model = new SceneModel(this);
-	terrain_model->add_mesh(sand_mesh);
-	map->add_child(terrain_model);
+	SceneTerrain *terrain = new SceneTerrain(this, TERRAIN_SIZE, height_map, sand_material);
+	terrain->add_band(-20.f, 1000.f, OBSIDIAN, false);
+	map->add_child(terrain);
 	std::cerr << "OK." << std::endl;
 }
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "frame_tasks.h"
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+std::mutex tasks_mutex;
+std::deque<std::function<bool()>> tasks;
+
+void FrameTasks::add(std::function<bool()> step)
+{
+	std::lock_guard<std::mutex> lock(tasks_mutex);
+	tasks.push_back(std::move(step));
+}
+
+size_t FrameTasks::process(double budget)
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+	do
+	{
+		// Steps may add tasks of their own, so the lock is not held while they run.
+		std::function<bool()> step;
+		{
+			std::lock_guard<std::mutex> lock(tasks_mutex);
+			if (tasks.empty())
+				return 0;
+			step = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		if (!step())
+		{
+			std::lock_guard<std::mutex> lock(tasks_mutex);
+			tasks.push_front(std::move(step));
+		}
+	} while (std::chrono::duration<double>(Clock::now() - start).count() < budget);
+	return pending();
+}
+
+void FrameTasks::flush()
+{
+	while (process(1.0) > 0);
+}
+
+size_t FrameTasks::pending()
+{
+	std::lock_guard<std::mutex> lock(tasks_mutex);
+	return tasks.size();
+}
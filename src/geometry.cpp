@@ -1,77 +1,139 @@
 #include "geometry.h"
-#include "SOIL.h"
+#include "gl_state.h"
+#include "upload_queue.h"
+#include "texture_cache.h"
+#include "texture_data.h"
+#include "resource_loader.h"
 
 Geometry::Geometry()
 {
-	has_texture = false;
-	has_normals = true;
-	add_texture_noise = false;
-
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &NBO);
-	glGenBuffers(1, &TBO);
-	glGenBuffers(1, &EBO);	
 }
 
-Geometry::~Geometry() {}
+Geometry::Geometry(MeshData data) :
+	MeshData(std::move(data))
+{
+}
 
-void Geometry::populate_buffers()
+Geometry::~Geometry()
 {
-	glBindVertexArray(VAO);
-	
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-	if (has_normals) {
-		glBindBuffer(GL_ARRAY_BUFFER, NBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * normals.size(), normals.data(), GL_STATIC_DRAW);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	// The loader may be writing the buffers; let it finish first.
+	if (loading)
+		ResourceLoader::flush();
+	if (uploaded)
+	{
+		arena->free(range);
+		TextureCache::release(texture);
+	}
+	else
+	{
+		UploadQueue::cancel(this);
+		if (batch)
+			--*batch;
 	}
+}
 
-	if (has_texture) {
-		glBindBuffer(GL_ARRAY_BUFFER, TBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec2) * tex_coords.size(), tex_coords.data(), GL_STATIC_DRAW);
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
+void Geometry::upload()
+{
+	if (uploaded)
+		return;
+	if (loading)
+	{
+		ResourceLoader::flush();
+		return;
 	}
+	fill_buffers();
+	finish_upload();
+}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), indices.data(), GL_STATIC_DRAW);
+void Geometry::upload_async()
+{
+	if (uploaded || loading)
+		return;
+	loading = true;
+	ResourceLoader::submit([this](GLuint) { fill_buffers(); }, [this]() { finish_upload(); });
+}
+
+void Geometry::fill_buffers()
+{
+	// Arena buffers are shared between contexts, so this runs on either.
+	const VertexFormat *format = VertexFormat::choose(*this);
+	std::vector<unsigned char> packed((size_t) format->stride * vertices.size());
+	format->pack(*this, packed.data());
+	// Indices are relative to the mesh's first vertex, so small meshes fit in 16 bits.
+	GLenum index_type = vertices.size() <= 0x10000 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 
+	arena = GeometryArena::allocate(format, index_type, (GLuint) vertices.size(), (GLuint) indices.size(), range);
+	glBindBuffer(GL_ARRAY_BUFFER, arena->vertex_buffer);
+	glBufferSubData(GL_ARRAY_BUFFER, (GLintptr) format->stride * range.first_vertex, packed.size(), packed.data());
+	// Filled through the array target, as element array bindings belong to a VAO.
+	glBindBuffer(GL_ARRAY_BUFFER, arena->index_buffer);
+	if (index_type == GL_UNSIGNED_SHORT)
+	{
+		std::vector<GLushort> short_indices(indices.begin(), indices.end());
+		glBufferSubData(GL_ARRAY_BUFFER, (GLintptr) arena->index_offset(range.first_index), sizeof(GLushort) * short_indices.size(), short_indices.data());
+	}
+	else
+		glBufferSubData(GL_ARRAY_BUFFER, (GLintptr) arena->index_offset(range.first_index), sizeof(GLuint) * indices.size(), indices.data());
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
 }
 
-void Geometry::attach_texture(const char *texture_loc)
+void Geometry::finish_upload()
+{
+	loading = false;
+	uploaded = true;
+	if (batch)
+	{
+		--*batch;
+		batch = nullptr;
+	}
+	if (has_texture && texture_path)
+		texture = TextureCache::acquire(texture_path, wrap_type, filter_type);
+}
+
+void Geometry::bind_attributes()
 {
-	has_texture = true;
+	// Points the currently bound VAO at the arena, so instanced VAOs can share its buffers.
+	arena->bind_attributes();
+}
 
+GLuint Geometry::create_texture(GLint wrap_type, GLint filter_type)
+{
+	GLuint texture;
 	glGenTextures(1, &texture);
 
-	glBindTexture(GL_TEXTURE_2D, texture);
+	GLState::bind_texture(0, GL_TEXTURE_2D, texture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap_type);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap_type);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter_type);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter_type);
+	GLState::bind_texture(0, GL_TEXTURE_2D, 0);
+	return texture;
+}
 
-	int width, height, channels;
-	unsigned char * image = SOIL_load_image(texture_loc, &width, &height, &channels, SOIL_LOAD_RGB);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-	glGenerateMipmap(GL_TEXTURE_2D);
-	SOIL_free_image_data(image);
-	glBindTexture(GL_TEXTURE_2D, 0);
+GLuint Geometry::load_texture(const char *texture_loc, GLint wrap_type, GLint filter_type)
+{
+	GLuint texture = create_texture(wrap_type, filter_type);
+
+	// Baked textures come with their mip chain; DDS files keep their blocks compressed.
+	TextureData data;
+	data.load(texture_loc);
+	GLState::bind_texture(0, GL_TEXTURE_2D, texture);
+	data.upload();
+	GLState::bind_texture(0, GL_TEXTURE_2D, 0);
+	return texture;
 }
 
 void Geometry::draw()
 {
-	glDrawElements(draw_type, (GLsizei) indices.size(), GL_UNSIGNED_INT, 0);
+	glDrawElementsBaseVertex(draw_type, range.num_indices, arena->index_type, arena->index_offset(range.first_index), range.first_vertex);
+}
+
+void Geometry::draw_instanced(GLsizei count)
+{
+	glDrawElementsInstancedBaseVertex(draw_type, range.num_indices, arena->index_type, arena->index_offset(range.first_index), count, range.first_vertex);
 }
 
 void Geometry::bind()
 {
-	glBindVertexArray(VAO);
-}
\ No newline at end of file
+	arena->bind();
+}
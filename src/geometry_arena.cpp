@@ -0,0 +1,172 @@
+#include "geometry_arena.h"
+#include "gl_state.h"
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+// Vertices and indices per arena; larger meshes get an arena of their own.
+const GLuint ARENA_VERTICES = 1 << 18;
+const GLuint ARENA_INDICES = 1 << 20;
+
+std::mutex arena_mutex;
+std::vector<GeometryArena *> arenas;
+GLuint draw_index_buffer = 0;
+
+// First fit; returns false if no free range is large enough.
+bool take_range(std::map<GLuint, GLuint> &free_ranges, GLuint count, GLuint &first)
+{
+	for (auto it = free_ranges.begin(); it != free_ranges.end(); ++it)
+	{
+		if (it->second < count)
+			continue;
+		first = it->first;
+		GLuint remaining = it->second - count;
+		free_ranges.erase(it);
+		if (remaining > 0)
+			free_ranges[first + count] = remaining;
+		return true;
+	}
+	return false;
+}
+
+void return_range(std::map<GLuint, GLuint> &free_ranges, GLuint first, GLuint count)
+{
+	if (count == 0)
+		return;
+	auto next = free_ranges.lower_bound(first);
+	if (next != free_ranges.end() && first + count == next->first)
+	{
+		count += next->second;
+		next = free_ranges.erase(next);
+	}
+	if (next != free_ranges.begin())
+	{
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == first)
+		{
+			prev->second += count;
+			return;
+		}
+	}
+	free_ranges[first] = count;
+}
+
+GeometryArena::GeometryArena(const VertexFormat *format, GLenum index_type, GLuint vertex_capacity, GLuint index_capacity)
+{
+	this->format = format;
+	this->index_type = index_type;
+	free_vertices[0] = vertex_capacity;
+	free_indices[0] = index_capacity;
+
+	// Filled through the array target, as element array bindings belong to a VAO.
+	glGenBuffers(1, &vertex_buffer);
+	glGenBuffers(1, &index_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) format->stride * vertex_capacity, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, index_buffer);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr) index_size() * index_capacity, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+GeometryArena::~GeometryArena()
+{
+	if (VAO)
+		glDeleteVertexArrays(1, &VAO);
+	GLuint buffers[] = { vertex_buffer, index_buffer };
+	glDeleteBuffers(2, buffers);
+}
+
+bool GeometryArena::take(GLuint num_vertices, GLuint num_indices, ArenaRange &range)
+{
+	if (!take_range(free_vertices, num_vertices, range.first_vertex))
+		return false;
+	if (!take_range(free_indices, num_indices, range.first_index))
+	{
+		return_range(free_vertices, range.first_vertex, num_vertices);
+		return false;
+	}
+	range.num_vertices = num_vertices;
+	range.num_indices = num_indices;
+	return true;
+}
+
+GeometryArena *GeometryArena::allocate(const VertexFormat *format, GLenum index_type, GLuint num_vertices, GLuint num_indices, ArenaRange &range)
+{
+	std::lock_guard<std::mutex> lock(arena_mutex);
+	for (GeometryArena *arena : arenas)
+	{
+		if (arena->format == format && arena->index_type == index_type && arena->take(num_vertices, num_indices, range))
+			return arena;
+	}
+	GeometryArena *arena = new GeometryArena(format, index_type, std::max(num_vertices, ARENA_VERTICES), std::max(num_indices, ARENA_INDICES));
+	arenas.push_back(arena);
+	arena->take(num_vertices, num_indices, range);
+	return arena;
+}
+
+GLsizei GeometryArena::index_size() const
+{
+	return index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+GLvoid *GeometryArena::index_offset(GLuint first_index) const
+{
+	return (GLvoid *) ((size_t) index_size() * first_index);
+}
+
+void GeometryArena::free(const ArenaRange &range)
+{
+	std::lock_guard<std::mutex> lock(arena_mutex);
+	return_range(free_vertices, range.first_vertex, range.num_vertices);
+	return_range(free_indices, range.first_index, range.num_indices);
+}
+
+void GeometryArena::bind()
+{
+	if (VAO)
+	{
+		GLState::bind_vertex_array(VAO);
+		return;
+	}
+
+	// Draw indices count up, so a multi-draw command picks its own with its base instance.
+	if (!draw_index_buffer)
+	{
+		std::vector<GLuint> draw_indices(MAX_MULTI_DRAWS);
+		for (GLuint i = 0; i < MAX_MULTI_DRAWS; ++i)
+			draw_indices[i] = i;
+		glGenBuffers(1, &draw_index_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, draw_index_buffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLuint) * MAX_MULTI_DRAWS, draw_indices.data(), GL_STATIC_DRAW);
+	}
+
+	glGenVertexArrays(1, &VAO);
+	GLState::bind_vertex_array(VAO);
+	bind_attributes();
+	glBindBuffer(GL_ARRAY_BUFFER, draw_index_buffer);
+	glEnableVertexAttribArray(DRAW_INDEX_ATTRIBUTE);
+	glVertexAttribIPointer(DRAW_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, 0, 0);
+	glVertexAttribDivisor(DRAW_INDEX_ATTRIBUTE, 1);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::bind_attributes()
+{
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+	format->bind_attributes();
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::destroy()
+{
+	std::lock_guard<std::mutex> lock(arena_mutex);
+	for (GeometryArena *arena : arenas)
+		delete arena;
+	arenas.clear();
+	if (draw_index_buffer)
+		glDeleteBuffers(1, &draw_index_buffer);
+	draw_index_buffer = 0;
+}
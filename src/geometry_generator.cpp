@@ -1,6 +1,12 @@
 #include "geometry_generator.h"
+#include "upload_queue.h"
+#include "procedural_cache.h"
+
+#include <mutex>
 
 std::vector<Geometry *> GeometryGenerator::geometries;
+// Scenes are set up on worker threads.
+std::mutex geometries_mutex;
 
 void GeometryGenerator::clean_up()
 {
@@ -8,9 +14,23 @@ void GeometryGenerator::clean_up()
 		delete(*it);
 }
 
+Geometry * GeometryGenerator::add_geometry(MeshData data)
+{
+	Geometry *geometry = new Geometry(std::move(data));
+	UploadQueue::push(geometry);
+	std::lock_guard<std::mutex> lock(geometries_mutex);
+	geometries.push_back(geometry);
+	return geometry;
+}
+
 Geometry * GeometryGenerator::generate_cube(GLfloat scale, bool has_normals)
 {
-	Geometry *cube = new Geometry();
+	return add_geometry(cube_data(scale, has_normals));
+}
+
+MeshData GeometryGenerator::cube_data(GLfloat scale, bool has_normals)
+{
+	MeshData cube;
 	
 	glm::vec3 v0 = { scale / 2.f, scale / 2.f, scale / 2.f };
 	glm::vec3 v1 = { -scale / 2.f, scale / 2.f, scale / 2.f };
@@ -21,77 +41,80 @@ Geometry * GeometryGenerator::generate_cube(GLfloat scale, bool has_normals)
 	glm::vec3 v6 = { scale / 2.f, -scale / 2.f, -scale / 2.f };
 	glm::vec3 v7 = { -scale / 2.f, -scale / 2.f, -scale / 2.f };
 
-	cube->vertices.push_back(v0);
-	cube->vertices.push_back(v2);
-	cube->vertices.push_back(v1);
-	cube->vertices.push_back(v1);
-	cube->vertices.push_back(v2);
-	cube->vertices.push_back(v3);
-
-	cube->vertices.push_back(v2);
-	cube->vertices.push_back(v6);
-	cube->vertices.push_back(v3);
-	cube->vertices.push_back(v3);
-	cube->vertices.push_back(v6);
-	cube->vertices.push_back(v7);
-
-	cube->vertices.push_back(v1);
-	cube->vertices.push_back(v3);
-	cube->vertices.push_back(v5);
-	cube->vertices.push_back(v3);
-	cube->vertices.push_back(v7);
-	cube->vertices.push_back(v5);
-
-	cube->vertices.push_back(v0);
-	cube->vertices.push_back(v4);
-	cube->vertices.push_back(v2);
-	cube->vertices.push_back(v2);
-	cube->vertices.push_back(v4);
-	cube->vertices.push_back(v6);
-
-	cube->vertices.push_back(v1);
-	cube->vertices.push_back(v5);
-	cube->vertices.push_back(v0);
-	cube->vertices.push_back(v0);
-	cube->vertices.push_back(v5);
-	cube->vertices.push_back(v4);
-
-	cube->vertices.push_back(v5);
-	cube->vertices.push_back(v7);
-	cube->vertices.push_back(v4);
-	cube->vertices.push_back(v4);
-	cube->vertices.push_back(v7);
-	cube->vertices.push_back(v6);
+	cube.vertices.push_back(v0);
+	cube.vertices.push_back(v2);
+	cube.vertices.push_back(v1);
+	cube.vertices.push_back(v1);
+	cube.vertices.push_back(v2);
+	cube.vertices.push_back(v3);
+
+	cube.vertices.push_back(v2);
+	cube.vertices.push_back(v6);
+	cube.vertices.push_back(v3);
+	cube.vertices.push_back(v3);
+	cube.vertices.push_back(v6);
+	cube.vertices.push_back(v7);
+
+	cube.vertices.push_back(v1);
+	cube.vertices.push_back(v3);
+	cube.vertices.push_back(v5);
+	cube.vertices.push_back(v3);
+	cube.vertices.push_back(v7);
+	cube.vertices.push_back(v5);
+
+	cube.vertices.push_back(v0);
+	cube.vertices.push_back(v4);
+	cube.vertices.push_back(v2);
+	cube.vertices.push_back(v2);
+	cube.vertices.push_back(v4);
+	cube.vertices.push_back(v6);
+
+	cube.vertices.push_back(v1);
+	cube.vertices.push_back(v5);
+	cube.vertices.push_back(v0);
+	cube.vertices.push_back(v0);
+	cube.vertices.push_back(v5);
+	cube.vertices.push_back(v4);
+
+	cube.vertices.push_back(v5);
+	cube.vertices.push_back(v7);
+	cube.vertices.push_back(v4);
+	cube.vertices.push_back(v4);
+	cube.vertices.push_back(v7);
+	cube.vertices.push_back(v6);
 
 	if (has_normals)
 	{
 		for (int i = 0; i < 6; ++i)
-			cube->normals.push_back(glm::vec3(0.f, 1.f, 0.f));
+			cube.normals.push_back(glm::vec3(0.f, 1.f, 0.f));
 		for (int i = 0; i < 6; ++i)
-			cube->normals.push_back(glm::vec3(0.f, 0.f, -1.f));
+			cube.normals.push_back(glm::vec3(0.f, 0.f, -1.f));
 		for (int i = 0; i < 6; ++i)
-			cube->normals.push_back(glm::vec3(-1.f, 0.f, 0.f));
+			cube.normals.push_back(glm::vec3(-1.f, 0.f, 0.f));
 		for (int i = 0; i < 6; ++i)
-			cube->normals.push_back(glm::vec3(1.f, 0.f, 0.f));
+			cube.normals.push_back(glm::vec3(1.f, 0.f, 0.f));
 		for (int i = 0; i < 6; ++i)
-			cube->normals.push_back(glm::vec3(0.f, 0.f, 1.f));
+			cube.normals.push_back(glm::vec3(0.f, 0.f, 1.f));
 		for (int i = 0; i < 6; ++i)
-			cube->normals.push_back(glm::vec3(0.f, -1.f, 0.f));
+			cube.normals.push_back(glm::vec3(0.f, -1.f, 0.f));
 	}	
 
-	for (int i = 0; i < cube->vertices.size(); ++i)
-		cube->indices.push_back(i);
+	for (int i = 0; i < cube.vertices.size(); ++i)
+		cube.indices.push_back(i);
 
-	cube->has_normals = has_normals;
-	cube->populate_buffers();
-	geometries.push_back(cube);
+	cube.has_normals = has_normals;
 	return cube;
 }
 
 Geometry * GeometryGenerator::generate_sphere(GLfloat radius, GLuint divisions)
 {
+	return add_geometry(sphere_data(radius, divisions));
+}
 
-	Geometry *sphere = new Geometry();
+MeshData GeometryGenerator::sphere_data(GLfloat radius, GLuint divisions)
+{
+
+	MeshData sphere;
 
 	float fstacks = (float) divisions;
 	float fslices = (float) divisions;
@@ -103,27 +126,27 @@ Geometry * GeometryGenerator::generate_sphere(GLfloat radius, GLuint divisions)
 		for (unsigned int j = 0; j < divisions; j++)
 		{
 			// Top left
-			sphere->vertices.push_back(glm::vec3(
+			sphere.vertices.push_back(glm::vec3(
 				radius * -cos(2.0f * pi * i / fstacks) * sin(pi * (j + 1.0f) / fslices),
 				radius * -cos(pi * (j + 1.0f) / fslices),
 				radius * sin(2.0f * pi * i / fstacks) * sin(pi * (j + 1.0f) / fslices)));
-			sphere->normals.push_back(glm::normalize(glm::vec3(
+			sphere.normals.push_back(glm::normalize(glm::vec3(
 				-cos(2.0f * pi * i / fstacks) * sin(pi * (j + 1.0f) / fslices),
 				-cos(pi * (j + 1.0f) / fslices),
 				sin(2.0f * pi * i / fstacks) * sin(pi * (j + 1.0f) / fslices))));
-			sphere->vertices.push_back(glm::vec3(
+			sphere.vertices.push_back(glm::vec3(
 				radius * -cos(2.0f * pi * (i + 1.0) / fstacks) * sin(pi * j / fslices),
 				radius * -cos(pi * j / fslices),
 				radius * sin(2.0f * pi * (i + 1.0) / fstacks) * sin(pi * j / fslices)));
-			sphere->normals.push_back(glm::normalize(glm::vec3(
+			sphere.normals.push_back(glm::normalize(glm::vec3(
 				-cos(2.0f * pi * (i + 1.0) / fstacks) * sin(pi * j / fslices),
 				-cos(pi * j / fslices),
 				sin(2.0f * pi * (i + 1.0) / fstacks) * sin(pi * j / fslices))));
-			sphere->vertices.push_back(glm::vec3(
+			sphere.vertices.push_back(glm::vec3(
 				radius * -cos(2.0f * pi * (i + 1.0) / fstacks) * sin(pi * (j + 1.0) / fslices),
 				radius * -cos(pi * (j + 1.0) / fslices),
 				radius * sin(2.0f * pi * (i + 1.0) / fstacks) * sin(pi * (j + 1.0) / fslices)));
-			sphere->normals.push_back(glm::normalize(glm::vec3(
+			sphere.normals.push_back(glm::normalize(glm::vec3(
 				-cos(2.0f * pi * (i + 1.0) / fstacks) * sin(pi * (j + 1.0) / fslices),
 				-cos(pi * (j + 1.0) / fslices),
 				sin(2.0f * pi * (i + 1.0) / fstacks) * sin(pi * (j + 1.0) / fslices))));			
@@ -131,29 +154,29 @@ Geometry * GeometryGenerator::generate_sphere(GLfloat radius, GLuint divisions)
 			// Need to repeat 2 of the vertices since we can only draw triangles. Eliminates the confusion
 			// of array indices.
 			// Top left
-			sphere->vertices.push_back(glm::vec3(
+			sphere.vertices.push_back(glm::vec3(
 				radius * -cos(2.0f * pi * i / fstacks) * sin(pi * (j + 1.0f) / fslices),
 				radius * -cos(pi * (j + 1.0f) / fslices),
 				radius * sin(2.0f * pi * i / fstacks) * sin(pi * (j + 1.0f) / fslices)));
-			sphere->normals.push_back(glm::normalize(glm::vec3(
+			sphere.normals.push_back(glm::normalize(glm::vec3(
 				-cos(2.0f * pi * i / fstacks) * sin(pi * (j + 1.0f) / fslices),
 				-cos(pi * (j + 1.0f) / fslices),
 				sin(2.0f * pi * i / fstacks) * sin(pi * (j + 1.0f) / fslices))));
 			// Bottom left
-			sphere->vertices.push_back(glm::vec3(
+			sphere.vertices.push_back(glm::vec3(
 				radius * -cos(2.0f * pi * i / fstacks) * sin(pi * j / fslices),
 				radius * -cos(pi * j / fslices),
 				radius * sin(2.0f * pi * i / fstacks) * sin(pi * j / fslices)));
-			sphere->normals.push_back(glm::normalize(glm::vec3(
+			sphere.normals.push_back(glm::normalize(glm::vec3(
 				-cos(2.0f * pi * i / fstacks) * sin(pi * j / fslices),
 				-cos(pi * j / fslices),
 				sin(2.0f * pi * i / fstacks) * sin(pi * j / fslices))));
 			//Bottom Right
-			sphere->vertices.push_back(glm::vec3(
+			sphere.vertices.push_back(glm::vec3(
 				radius * -cos(2.0f * pi * (i + 1.0) / fstacks) * sin(pi * j / fslices),
 				radius * -cos(pi * j / fslices),
 				radius * sin(2.0f * pi * (i + 1.0) / fstacks) * sin(pi * j / fslices)));
-			sphere->normals.push_back(glm::normalize(glm::vec3(
+			sphere.normals.push_back(glm::normalize(glm::vec3(
 				-cos(2.0f * pi * (i + 1.0) / fstacks) * sin(pi * j / fslices),
 				-cos(pi * j / fslices),
 				sin(2.0f * pi * (i + 1.0) / fstacks) * sin(pi * j / fslices))));			
@@ -161,18 +184,21 @@ Geometry * GeometryGenerator::generate_sphere(GLfloat radius, GLuint divisions)
 		}
 	}
 
-	for (int i = 0; i < sphere->vertices.size(); i++)
-		sphere->indices.push_back(i);
+	for (int i = 0; i < sphere.vertices.size(); i++)
+		sphere.indices.push_back(i);
 
-	sphere->populate_buffers();
-	geometries.push_back(sphere);
 
 	return sphere;
 }
 
 Geometry * GeometryGenerator::generate_cylinder(GLfloat radius, GLfloat height, GLuint divisions, bool is_centered)
 {
-	Geometry *cylinder = new Geometry();
+	return add_geometry(cylinder_data(radius, height, divisions, is_centered));
+}
+
+MeshData GeometryGenerator::cylinder_data(GLfloat radius, GLfloat height, GLuint divisions, bool is_centered)
+{
+	MeshData cylinder;
 
 	glm::vec3 v_top, v_bot, v0, v1, v2, v3;
 
@@ -213,42 +239,40 @@ Geometry * GeometryGenerator::generate_cylinder(GLfloat radius, GLfloat height,
 		
 
 		//Top Portion
-		cylinder->vertices.push_back(v_top);
-		cylinder->vertices.push_back(v1);
-		cylinder->vertices.push_back(v0);
-		cylinder->normals.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
-		cylinder->normals.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
-		cylinder->normals.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
+		cylinder.vertices.push_back(v_top);
+		cylinder.vertices.push_back(v1);
+		cylinder.vertices.push_back(v0);
+		cylinder.normals.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
+		cylinder.normals.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
+		cylinder.normals.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
 
 		//Middle Portion
-		cylinder->vertices.push_back(v0);
-		cylinder->vertices.push_back(v1);
-		cylinder->vertices.push_back(v2);
-		cylinder->vertices.push_back(v1);
-		cylinder->vertices.push_back(v3);
-		cylinder->vertices.push_back(v2);
-		cylinder->normals.push_back(glm::normalize(v0));
-		cylinder->normals.push_back(glm::normalize(v1));
-		cylinder->normals.push_back(glm::normalize(v2));
-		cylinder->normals.push_back(glm::normalize(v1));
-		cylinder->normals.push_back(glm::normalize(v3));
-		cylinder->normals.push_back(glm::normalize(v2));
+		cylinder.vertices.push_back(v0);
+		cylinder.vertices.push_back(v1);
+		cylinder.vertices.push_back(v2);
+		cylinder.vertices.push_back(v1);
+		cylinder.vertices.push_back(v3);
+		cylinder.vertices.push_back(v2);
+		cylinder.normals.push_back(glm::normalize(v0));
+		cylinder.normals.push_back(glm::normalize(v1));
+		cylinder.normals.push_back(glm::normalize(v2));
+		cylinder.normals.push_back(glm::normalize(v1));
+		cylinder.normals.push_back(glm::normalize(v3));
+		cylinder.normals.push_back(glm::normalize(v2));
 
 		//Bottom Portion
-		cylinder->vertices.push_back(v_bot);
-		cylinder->vertices.push_back(v2);
-		cylinder->vertices.push_back(v3);
-		cylinder->normals.push_back(glm::vec3(0.0f, -1.0f, 0.0f));
-		cylinder->normals.push_back(glm::vec3(0.0f, -1.0f, 0.0f));
-		cylinder->normals.push_back(glm::vec3(0.0f, -1.0f, 0.0f));
+		cylinder.vertices.push_back(v_bot);
+		cylinder.vertices.push_back(v2);
+		cylinder.vertices.push_back(v3);
+		cylinder.normals.push_back(glm::vec3(0.0f, -1.0f, 0.0f));
+		cylinder.normals.push_back(glm::vec3(0.0f, -1.0f, 0.0f));
+		cylinder.normals.push_back(glm::vec3(0.0f, -1.0f, 0.0f));
 	}
 
 	//Indices are just in order to make it easier
-	for (int i = 0; i < cylinder->vertices.size(); i++)
-		cylinder->indices.push_back(i);
+	for (int i = 0; i < cylinder.vertices.size(); i++)
+		cylinder.indices.push_back(i);
 
-	cylinder->populate_buffers();
-	geometries.push_back(cylinder);
 
 	return cylinder;
 
@@ -256,7 +280,12 @@ Geometry * GeometryGenerator::generate_cylinder(GLfloat radius, GLfloat height,
 
 Geometry * GeometryGenerator::generate_plane(GLfloat scale, int texture_type)
 {
-	Geometry *plane = new Geometry();
+	return add_geometry(plane_data(scale, texture_type));
+}
+
+MeshData GeometryGenerator::plane_data(GLfloat scale, int texture_type)
+{
+	MeshData plane;
 
 	if (texture_type == WATER)
 	{
@@ -274,24 +303,24 @@ Geometry * GeometryGenerator::generate_plane(GLfloat scale, int texture_type)
 				glm::vec3 v2 = { i, 0, j + step }; //Bottom Left
 				glm::vec3 v3 = { i + step, 0, j + step }; //Bottom Right
 
-				plane->vertices.push_back(v0);
-				plane->vertices.push_back(v2);
-				plane->vertices.push_back(v1);
-				plane->vertices.push_back(v1);
-				plane->vertices.push_back(v2);
-				plane->vertices.push_back(v3);
-
-				plane->tex_coords.push_back(glm::vec2(0, 0));
-				plane->tex_coords.push_back(glm::vec2(0, 1.f));
-				plane->tex_coords.push_back(glm::vec2(1.f, 0));
-				plane->tex_coords.push_back(glm::vec2(1.f, 0));
-				plane->tex_coords.push_back(glm::vec2(0, 1.f));
-				plane->tex_coords.push_back(glm::vec2(1.f, 1.f));
+				plane.vertices.push_back(v0);
+				plane.vertices.push_back(v2);
+				plane.vertices.push_back(v1);
+				plane.vertices.push_back(v1);
+				plane.vertices.push_back(v2);
+				plane.vertices.push_back(v3);
+
+				plane.tex_coords.push_back(glm::vec2(0, 0));
+				plane.tex_coords.push_back(glm::vec2(0, 1.f));
+				plane.tex_coords.push_back(glm::vec2(1.f, 0));
+				plane.tex_coords.push_back(glm::vec2(1.f, 0));
+				plane.tex_coords.push_back(glm::vec2(0, 1.f));
+				plane.tex_coords.push_back(glm::vec2(1.f, 1.f));
 			}
 		}		
 
-		plane->attach_texture("assets/textures/WaterWW.png");
-		plane->add_texture_noise = true;
+		plane.attach_texture("assets/textures/WaterWW.png");
+		plane.add_texture_noise = true;
 	}
 	else
 	{
@@ -301,44 +330,45 @@ Geometry * GeometryGenerator::generate_plane(GLfloat scale, int texture_type)
 		glm::vec3 v2 = { scale, 0, -scale };
 		glm::vec3 v3 = { -scale, 0, -scale };
 
-		plane->vertices.push_back(v0);
-		plane->vertices.push_back(v2);
-		plane->vertices.push_back(v1);
-		plane->vertices.push_back(v1);
-		plane->vertices.push_back(v2);
-		plane->vertices.push_back(v3);
+		plane.vertices.push_back(v0);
+		plane.vertices.push_back(v2);
+		plane.vertices.push_back(v1);
+		plane.vertices.push_back(v1);
+		plane.vertices.push_back(v2);
+		plane.vertices.push_back(v3);
 	}
 
 	glm::vec3 n = { 0, 1.0f, 0 };
 
-	for (int i = 0; i < plane->vertices.size(); i++)
-		plane->normals.push_back(n);
+	for (int i = 0; i < plane.vertices.size(); i++)
+		plane.normals.push_back(n);
 
-	for (int i = 0; i < plane->vertices.size(); i++)
-		plane->indices.push_back(i);
+	for (int i = 0; i < plane.vertices.size(); i++)
+		plane.indices.push_back(i);
 
-	plane->populate_buffers();
-	geometries.push_back(plane);
 	
 	return plane;
 }
 
 
-Geometry * GeometryGenerator::generate_terrain(GLfloat size, GLint num_points_side, GLfloat min_height, GLfloat max_height, bool normals_up, int texture_type, std::vector<std::vector<GLfloat> > &height_map)
+Geometry * GeometryGenerator::generate_terrain(GLfloat size, GLint num_points_side, GLfloat min_height, GLfloat max_height, bool normals_up, int texture_type, const HeightMap &height_map)
+{
+	return add_geometry(terrain_data(size, num_points_side, min_height, max_height, normals_up, texture_type, height_map));
+}
+
+MeshData GeometryGenerator::terrain_data(GLfloat size, GLint num_points_side, GLfloat min_height, GLfloat max_height, bool normals_up, int texture_type, const HeightMap &height_map)
 {
 	//Experimenting. Assumed that height map is already set up and size is same as height map size
 
 	//Terain is size x size
 
-	Geometry *terrain = new Geometry();
+	MeshData terrain;
 
 	//Create array of points using height map lookup function
 	//Grid is same size as height map, and scales with height map size
 	float middle = size / 2.f;
 	float min_x = -middle;
 	float min_z = -middle;
-	float max_x = middle;
-	float max_z = middle;
 
 	float step_size =  size / (float) num_points_side;
 
@@ -346,19 +376,31 @@ Geometry * GeometryGenerator::generate_terrain(GLfloat size, GLint num_points_si
 	float s = 0.f;
 	float t = 0.f;
 
+	//Every corner is shared by up to four squares, so sample the whole grid in one batch
+	GLuint side = (GLuint) num_points_side + 1;
+	std::vector<glm::vec2> corners;
+	corners.reserve(side * side);
+	for (GLuint i = 0; i < side; i++)
+		for (GLuint j = 0; j < side; j++)
+			corners.push_back(glm::vec2(min_x + i * step_size, min_z + j * step_size));
+	std::vector<GLfloat> heights(corners.size());
+	height_map.sample(corners.data(), corners.size(), size, heights.data());
+
 	//Goes Square by Square
-	for (float x = min_x; x <= (max_x - step_size); x += step_size)
+	for (GLuint i = 0; i < side - 1; i++)
 	{
-		for (float z = min_z; z <= (max_z - step_size); z += step_size)
+		float x = min_x + i * step_size;
+		for (GLuint j = 0; j < side - 1; j++)
 		{
-			float h1 = Terrain::height_lookup(x, z, size, height_map);
+			float z = min_z + j * step_size;
+			float h1 = heights[i * side + j];
 
 			if (h1 < min_height || h1 > max_height)
 				continue;
 
-			float h2 = Terrain::height_lookup(x + step_size, z, size, height_map);
-			float h3 = Terrain::height_lookup(x, z + step_size, size, height_map);
-			float h4 = Terrain::height_lookup(x + step_size, z + step_size, size, height_map);
+			float h2 = heights[(i + 1) * side + j];
+			float h3 = heights[i * side + j + 1];
+			float h4 = heights[(i + 1) * side + j + 1];
 
 			glm::vec3 v1 = glm::vec3(x, h1, z);							//Upper Left
 			glm::vec3 v2 = glm::vec3(x + step_size, h2, z);				//Upper Right
@@ -366,21 +408,21 @@ Geometry * GeometryGenerator::generate_terrain(GLfloat size, GLint num_points_si
 			glm::vec3 v4 = glm::vec3(x + step_size, h4, z + step_size);  //Lower Right
 
 	        //Make Two Triangles for Square
-			terrain->vertices.push_back(v1);
-			terrain->vertices.push_back(v3);
-			terrain->vertices.push_back(v2);
-			terrain->vertices.push_back(v2);
-			terrain->vertices.push_back(v3);
-			terrain->vertices.push_back(v4);
+			terrain.vertices.push_back(v1);
+			terrain.vertices.push_back(v3);
+			terrain.vertices.push_back(v2);
+			terrain.vertices.push_back(v2);
+			terrain.vertices.push_back(v3);
+			terrain.vertices.push_back(v4);
 
 			if (normals_up)
 			{
-				terrain->normals.push_back(glm::vec3(0.f, 1.f, 0.f));
-				terrain->normals.push_back(glm::vec3(0.f, 1.f, 0.f));
-				terrain->normals.push_back(glm::vec3(0.f, 1.f, 0.f));
-				terrain->normals.push_back(glm::vec3(0.f, 1.f, 0.f));
-				terrain->normals.push_back(glm::vec3(0.f, 1.f, 0.f));
-				terrain->normals.push_back(glm::vec3(0.f, 1.f, 0.f));
+				terrain.normals.push_back(glm::vec3(0.f, 1.f, 0.f));
+				terrain.normals.push_back(glm::vec3(0.f, 1.f, 0.f));
+				terrain.normals.push_back(glm::vec3(0.f, 1.f, 0.f));
+				terrain.normals.push_back(glm::vec3(0.f, 1.f, 0.f));
+				terrain.normals.push_back(glm::vec3(0.f, 1.f, 0.f));
+				terrain.normals.push_back(glm::vec3(0.f, 1.f, 0.f));
 			}
 			else {
 				//Get Normals for each vertex pushed (Right hand rule ftw)
@@ -391,20 +433,20 @@ Geometry * GeometryGenerator::generate_terrain(GLfloat size, GLint num_points_si
 				glm::vec3 n5 = glm::cross(v4 - v3, v1 - v3);
 				glm::vec3 n6 = glm::cross(v1 - v4, v3 - v4);
 
-				terrain->normals.push_back(n1);
-				terrain->normals.push_back(n2);
-				terrain->normals.push_back(n3);
-				terrain->normals.push_back(n4);
-				terrain->normals.push_back(n5);
-				terrain->normals.push_back(n6);
+				terrain.normals.push_back(n1);
+				terrain.normals.push_back(n2);
+				terrain.normals.push_back(n3);
+				terrain.normals.push_back(n4);
+				terrain.normals.push_back(n5);
+				terrain.normals.push_back(n6);
 			}
 			
-			terrain->tex_coords.push_back(glm::vec2(s, t));
-			terrain->tex_coords.push_back(glm::vec2(s, t + tex_step_size));
-			terrain->tex_coords.push_back(glm::vec2(s + tex_step_size, t));
-			terrain->tex_coords.push_back(glm::vec2(s + tex_step_size, t));
-			terrain->tex_coords.push_back(glm::vec2(s, t + tex_step_size));
-			terrain->tex_coords.push_back(glm::vec2(s + tex_step_size, t + tex_step_size));
+			terrain.tex_coords.push_back(glm::vec2(s, t));
+			terrain.tex_coords.push_back(glm::vec2(s, t + tex_step_size));
+			terrain.tex_coords.push_back(glm::vec2(s + tex_step_size, t));
+			terrain.tex_coords.push_back(glm::vec2(s + tex_step_size, t));
+			terrain.tex_coords.push_back(glm::vec2(s, t + tex_step_size));
+			terrain.tex_coords.push_back(glm::vec2(s + tex_step_size, t + tex_step_size));
 
 			t += tex_step_size;
 		}
@@ -413,48 +455,56 @@ Geometry * GeometryGenerator::generate_terrain(GLfloat size, GLint num_points_si
 	}
 
 	//Indices are just in order to make it easier
-	for (int i = 0; i < terrain->vertices.size(); i++)
-		terrain->indices.push_back(i);
+	for (int i = 0; i < terrain.vertices.size(); i++)
+		terrain.indices.push_back(i);
 
-	if(texture_type == GRASS)
-		terrain->attach_texture("assets/textures/GrassWW2.dds");
-	else if (texture_type == STONE)
-		terrain->attach_texture("assets/textures/StoneWW.png");
-	else if (texture_type == SAND)
-		terrain->attach_texture("assets/textures/SandWW2.dds");
-	else if (texture_type == SAND_TWO)
-		terrain->attach_texture("assets/textures/Sandy2.png");
-	else if (texture_type == SNOW)
-		terrain->attach_texture("assets/textures/Snow4.tga");
-	else if (texture_type == OBSIDIAN)
-		terrain->attach_texture("assets/textures/Obsidian.png");
-	else if (texture_type == SPACE) //Higher Quality, but causes alot of aliasing
-		terrain->attach_texture("assets/textures/Space.png");
-	else if (texture_type == ROCK)
-		terrain->attach_texture("assets/textures/Rock.png");
+	if (texture_path(texture_type))
+		terrain.attach_texture(texture_path(texture_type));
 
-	terrain->populate_buffers();
-	geometries.push_back(terrain);
 
 	return terrain;
 }
 
-Geometry * GeometryGenerator::generate_bezier_plane(GLfloat radius, GLuint num_curves, GLuint segmentation, GLfloat waviness, int texture_type, unsigned int seed = 0)
+Geometry * GeometryGenerator::generate_bezier_plane(GLfloat radius, GLuint num_curves, GLuint segmentation, GLfloat waviness, int texture_type, unsigned int seed)
 {
-	Geometry *bez_plane = new Geometry();
-	bez_plane->draw_type = GL_TRIANGLE_FAN;
+	// Unseeded planes are meant to come out different every time.
+	if (seed == 0)
+		return add_geometry(bezier_plane_data(radius, num_curves, segmentation, waviness, texture_type, seed));
+
+	CacheKey key("bezier_plane");
+	key << radius << num_curves << segmentation << waviness << texture_type << seed;
+	MappedFile file;
+	CacheReader reader;
+	MeshData data;
+	if (ProceduralCache::load(key, file, reader) && data.read(reader) && reader.done())
+	{
+		if (data.has_texture)
+			data.attach_texture(texture_path(texture_type));
+		return add_geometry(std::move(data));
+	}
+
+	data = bezier_plane_data(radius, num_curves, segmentation, waviness, texture_type, seed);
+	CacheWriter writer;
+	data.write(writer);
+	ProceduralCache::store(key, writer);
+	return add_geometry(std::move(data));
+}
+
+MeshData GeometryGenerator::bezier_plane_data(GLfloat radius, GLuint num_curves, GLuint segmentation, GLfloat waviness, int texture_type, unsigned int seed = 0)
+{
+	MeshData bez_plane;
+	bez_plane.draw_type = GL_TRIANGLE_FAN;
 
 	// Make bezier curves
-	if (seed != 0)
-		srand(seed);
+	Random rng = seed != 0 ? Random(seed) : Util::stream();
 	int num_points = num_curves * 3;
 	std::vector<glm::vec3> control_points(num_points);
 	for (int i = 0; i < num_points; ++i)
 	{
 		if (i % 3 == 0) continue; // do interpolated points later
-		float offset = ((float)rand()/(float)RAND_MAX) * (radius / (1/waviness)) - (radius / (2/waviness));
+		float offset = rng.random(0.f, 1.f) * (radius / (1/waviness)) - (radius / (2/waviness));
 		float x = radius * glm::cos(glm::radians(i * 360.f / num_points)) + offset;
-		offset = ((float)rand() / (float)RAND_MAX) * (radius / (1/waviness)) - (radius / (2/waviness));
+		offset = rng.random(0.f, 1.f) * (radius / (1/waviness)) - (radius / (2/waviness));
 		float z = radius * glm::sin(glm::radians(i * 360.f / num_points)) + offset;
 		float y = 0;
 		control_points[i] = glm::vec3(x, y, -z);
@@ -464,7 +514,7 @@ Geometry * GeometryGenerator::generate_bezier_plane(GLfloat radius, GLuint num_c
 		control_points[i] = 0.5f * (control_points[i - 1 > 0 ? i - 1 : num_points - 1] + control_points[i + 1]);
 
 	// Calculate vertices
-	bez_plane->vertices.push_back(glm::vec3(0.f)); // centered at origin
+	bez_plane.vertices.push_back(glm::vec3(0.f)); // centered at origin
 	for (unsigned int i = 0; i < num_curves; ++i)
 	{
 		int off = 3 * i;
@@ -476,38 +526,41 @@ Geometry * GeometryGenerator::generate_bezier_plane(GLfloat radius, GLuint num_c
 		for (unsigned int j = 0; j <= segmentation; ++j)
 		{
 			float t = (float) j / (float) segmentation;
-			bez_plane->vertices.push_back(glm::vec3(bezier_mat * glm::vec4(t*t*t, t*t, t, 1.f)));
+			bez_plane.vertices.push_back(glm::vec3(bezier_mat * glm::vec4(t*t*t, t*t, t, 1.f)));
 		}
 	}
 
 	// Normals
-	for (int i = 0; i < bez_plane->vertices.size(); ++i)
-		bez_plane->normals.push_back(glm::vec3(0.f, 1.f, 0.f));
+	for (int i = 0; i < bez_plane.vertices.size(); ++i)
+		bez_plane.normals.push_back(glm::vec3(0.f, 1.f, 0.f));
 
 	// Indices
-	for (int i = 0; i < bez_plane->vertices.size(); ++i)
-		bez_plane->indices.push_back(i);
+	for (int i = 0; i < bez_plane.vertices.size(); ++i)
+		bez_plane.indices.push_back(i);
 
-	bez_plane->tex_coords.push_back(glm::vec2(0.5f, 0.f));
-	for (int i = 1; i < bez_plane->vertices.size(); i += 2)
+	bez_plane.tex_coords.push_back(glm::vec2(0.5f, 0.f));
+	for (int i = 1; i < bez_plane.vertices.size(); i += 2)
 	{
-		bez_plane->tex_coords.push_back(glm::vec2(0.f, 1.f));
-		bez_plane->tex_coords.push_back(glm::vec2(1.f, 1.f));
+		bez_plane.tex_coords.push_back(glm::vec2(0.f, 1.f));
+		bez_plane.tex_coords.push_back(glm::vec2(1.f, 1.f));
 	}
 
 	if (texture_type == SAND)
-		bez_plane->attach_texture("assets/textures/SandWW2.dds");
+		bez_plane.attach_texture("assets/textures/SandWW2.dds");
 	else if (texture_type == OBSIDIAN)
-		bez_plane->attach_texture("assets/textures/Obsidian.png");
+		bez_plane.attach_texture("assets/textures/Obsidian.png");
 
-	bez_plane->populate_buffers();
-	geometries.push_back(bez_plane);
 	return bez_plane;
 }
 
-Geometry *GeometryGenerator::generate_sword()
+Geometry * GeometryGenerator::generate_sword()
+{
+	return add_geometry(sword_data());
+}
+
+MeshData GeometryGenerator::sword_data()
 {
-	Geometry *sword = new Geometry();
+	MeshData sword;
 
 	float curr_height;
 
@@ -524,60 +577,60 @@ Geometry *GeometryGenerator::generate_sword()
 	glm::vec3 v6 = { handle_width / 2.f, -handle_height / 2.f + offset, -handle_width / 3.f };
 	glm::vec3 v7 = { -handle_width / 2.f, -handle_height / 2.f + offset, -handle_width / 3.f };
 
-	sword->vertices.push_back(v0);
-	sword->vertices.push_back(v2);
-	sword->vertices.push_back(v1);
-	sword->vertices.push_back(v1);
-	sword->vertices.push_back(v2);
-	sword->vertices.push_back(v3);
-
-	sword->vertices.push_back(v2);
-	sword->vertices.push_back(v6);
-	sword->vertices.push_back(v3);
-	sword->vertices.push_back(v3);
-	sword->vertices.push_back(v6);
-	sword->vertices.push_back(v7);
-
-	sword->vertices.push_back(v1);
-	sword->vertices.push_back(v3);
-	sword->vertices.push_back(v5);
-	sword->vertices.push_back(v3);
-	sword->vertices.push_back(v7);
-	sword->vertices.push_back(v5);
-
-	sword->vertices.push_back(v0);
-	sword->vertices.push_back(v4);
-	sword->vertices.push_back(v2);
-	sword->vertices.push_back(v2);
-	sword->vertices.push_back(v4);
-	sword->vertices.push_back(v6);
-
-	sword->vertices.push_back(v1);
-	sword->vertices.push_back(v5);
-	sword->vertices.push_back(v0);
-	sword->vertices.push_back(v0);
-	sword->vertices.push_back(v5);
-	sword->vertices.push_back(v4);
-
-	sword->vertices.push_back(v5);
-	sword->vertices.push_back(v7);
-	sword->vertices.push_back(v4);
-	sword->vertices.push_back(v4);
-	sword->vertices.push_back(v7);
-	sword->vertices.push_back(v6);
+	sword.vertices.push_back(v0);
+	sword.vertices.push_back(v2);
+	sword.vertices.push_back(v1);
+	sword.vertices.push_back(v1);
+	sword.vertices.push_back(v2);
+	sword.vertices.push_back(v3);
+
+	sword.vertices.push_back(v2);
+	sword.vertices.push_back(v6);
+	sword.vertices.push_back(v3);
+	sword.vertices.push_back(v3);
+	sword.vertices.push_back(v6);
+	sword.vertices.push_back(v7);
+
+	sword.vertices.push_back(v1);
+	sword.vertices.push_back(v3);
+	sword.vertices.push_back(v5);
+	sword.vertices.push_back(v3);
+	sword.vertices.push_back(v7);
+	sword.vertices.push_back(v5);
+
+	sword.vertices.push_back(v0);
+	sword.vertices.push_back(v4);
+	sword.vertices.push_back(v2);
+	sword.vertices.push_back(v2);
+	sword.vertices.push_back(v4);
+	sword.vertices.push_back(v6);
+
+	sword.vertices.push_back(v1);
+	sword.vertices.push_back(v5);
+	sword.vertices.push_back(v0);
+	sword.vertices.push_back(v0);
+	sword.vertices.push_back(v5);
+	sword.vertices.push_back(v4);
+
+	sword.vertices.push_back(v5);
+	sword.vertices.push_back(v7);
+	sword.vertices.push_back(v4);
+	sword.vertices.push_back(v4);
+	sword.vertices.push_back(v7);
+	sword.vertices.push_back(v6);
 
 	for (int i = 0; i < 6; ++i)
-		sword->normals.push_back(glm::vec3(0.f, 1.f, 0.f));
+		sword.normals.push_back(glm::vec3(0.f, 1.f, 0.f));
 	for (int i = 0; i < 6; ++i)
-		sword->normals.push_back(glm::vec3(0.f, 0.f, -1.f));
+		sword.normals.push_back(glm::vec3(0.f, 0.f, -1.f));
 	for (int i = 0; i < 6; ++i)
-		sword->normals.push_back(glm::vec3(-1.f, 0.f, 0.f));
+		sword.normals.push_back(glm::vec3(-1.f, 0.f, 0.f));
 	for (int i = 0; i < 6; ++i)
-		sword->normals.push_back(glm::vec3(1.f, 0.f, 0.f));
+		sword.normals.push_back(glm::vec3(1.f, 0.f, 0.f));
 	for (int i = 0; i < 6; ++i)
-		sword->normals.push_back(glm::vec3(0.f, 0.f, 1.f));
+		sword.normals.push_back(glm::vec3(0.f, 0.f, 1.f));
 	for (int i = 0; i < 6; ++i)
-		sword->normals.push_back(glm::vec3(0.f, -1.f, 0.f));
+		sword.normals.push_back(glm::vec3(0.f, -1.f, 0.f));
 
 	//Make Hilt(?)
 	curr_height = handle_height / 2.f + offset;
@@ -592,60 +645,60 @@ Geometry *GeometryGenerator::generate_sword()
 	v6 = { hilt_width / 2.f, curr_height, -handle_width / 3.f };
 	v7 = { -hilt_width / 2.f, curr_height, -handle_width / 3.f };
 
-	sword->vertices.push_back(v0);
-	sword->vertices.push_back(v2);
-	sword->vertices.push_back(v1);
-	sword->vertices.push_back(v1);
-	sword->vertices.push_back(v2);
-	sword->vertices.push_back(v3);
-
-	sword->vertices.push_back(v2);
-	sword->vertices.push_back(v6);
-	sword->vertices.push_back(v3);
-	sword->vertices.push_back(v3);
-	sword->vertices.push_back(v6);
-	sword->vertices.push_back(v7);
-
-	sword->vertices.push_back(v1);
-	sword->vertices.push_back(v3);
-	sword->vertices.push_back(v5);
-	sword->vertices.push_back(v3);
-	sword->vertices.push_back(v7);
-	sword->vertices.push_back(v5);
-
-	sword->vertices.push_back(v0);
-	sword->vertices.push_back(v4);
-	sword->vertices.push_back(v2);
-	sword->vertices.push_back(v2);
-	sword->vertices.push_back(v4);
-	sword->vertices.push_back(v6);
-
-	sword->vertices.push_back(v1);
-	sword->vertices.push_back(v5);
-	sword->vertices.push_back(v0);
-	sword->vertices.push_back(v0);
-	sword->vertices.push_back(v5);
-	sword->vertices.push_back(v4);
-
-	sword->vertices.push_back(v5);
-	sword->vertices.push_back(v7);
-	sword->vertices.push_back(v4);
-	sword->vertices.push_back(v4);
-	sword->vertices.push_back(v7);
-	sword->vertices.push_back(v6);
+	sword.vertices.push_back(v0);
+	sword.vertices.push_back(v2);
+	sword.vertices.push_back(v1);
+	sword.vertices.push_back(v1);
+	sword.vertices.push_back(v2);
+	sword.vertices.push_back(v3);
+
+	sword.vertices.push_back(v2);
+	sword.vertices.push_back(v6);
+	sword.vertices.push_back(v3);
+	sword.vertices.push_back(v3);
+	sword.vertices.push_back(v6);
+	sword.vertices.push_back(v7);
+
+	sword.vertices.push_back(v1);
+	sword.vertices.push_back(v3);
+	sword.vertices.push_back(v5);
+	sword.vertices.push_back(v3);
+	sword.vertices.push_back(v7);
+	sword.vertices.push_back(v5);
+
+	sword.vertices.push_back(v0);
+	sword.vertices.push_back(v4);
+	sword.vertices.push_back(v2);
+	sword.vertices.push_back(v2);
+	sword.vertices.push_back(v4);
+	sword.vertices.push_back(v6);
+
+	sword.vertices.push_back(v1);
+	sword.vertices.push_back(v5);
+	sword.vertices.push_back(v0);
+	sword.vertices.push_back(v0);
+	sword.vertices.push_back(v5);
+	sword.vertices.push_back(v4);
+
+	sword.vertices.push_back(v5);
+	sword.vertices.push_back(v7);
+	sword.vertices.push_back(v4);
+	sword.vertices.push_back(v4);
+	sword.vertices.push_back(v7);
+	sword.vertices.push_back(v6);
 
 	for (int i = 0; i < 6; ++i)
-		sword->normals.push_back(glm::vec3(0.f, 1.f, 0.f));
+		sword.normals.push_back(glm::vec3(0.f, 1.f, 0.f));
 	for (int i = 0; i < 6; ++i)
-		sword->normals.push_back(glm::vec3(0.f, 0.f, -1.f));
+		sword.normals.push_back(glm::vec3(0.f, 0.f, -1.f));
 	for (int i = 0; i < 6; ++i)
-		sword->normals.push_back(glm::vec3(-1.f, 0.f, 0.f));
+		sword.normals.push_back(glm::vec3(-1.f, 0.f, 0.f));
 	for (int i = 0; i < 6; ++i)
-		sword->normals.push_back(glm::vec3(1.f, 0.f, 0.f));
+		sword.normals.push_back(glm::vec3(1.f, 0.f, 0.f));
 	for (int i = 0; i < 6; ++i)
-		sword->normals.push_back(glm::vec3(0.f, 0.f, 1.f));
+		sword.normals.push_back(glm::vec3(0.f, 0.f, 1.f));
 	for (int i = 0; i < 6; ++i)
-		sword->normals.push_back(glm::vec3(0.f, -1.f, 0.f));
+		sword.normals.push_back(glm::vec3(0.f, -1.f, 0.f));
 
 	//Make Blade
 	curr_height = curr_height + hilt_height;
@@ -660,42 +713,42 @@ Geometry *GeometryGenerator::generate_sword()
 	v6 = { 0, curr_height, -handle_width / 3.f };
 	v7 = { -blade_width / 2.f, curr_height, 0 };
 
-	sword->vertices.push_back(v2);
-	sword->vertices.push_back(v6);
-	sword->vertices.push_back(v3);
-	sword->vertices.push_back(v3);
-	sword->vertices.push_back(v6);
-	sword->vertices.push_back(v7);
-
-	sword->vertices.push_back(v1);
-	sword->vertices.push_back(v3);
-	sword->vertices.push_back(v5);
-	sword->vertices.push_back(v3);
-	sword->vertices.push_back(v7);
-	sword->vertices.push_back(v5);
-
-	sword->vertices.push_back(v0);
-	sword->vertices.push_back(v4);
-	sword->vertices.push_back(v2);
-	sword->vertices.push_back(v2);
-	sword->vertices.push_back(v4);
-	sword->vertices.push_back(v6);
-
-	sword->vertices.push_back(v1);
-	sword->vertices.push_back(v5);
-	sword->vertices.push_back(v0);
-	sword->vertices.push_back(v0);
-	sword->vertices.push_back(v5);
-	sword->vertices.push_back(v4);
+	sword.vertices.push_back(v2);
+	sword.vertices.push_back(v6);
+	sword.vertices.push_back(v3);
+	sword.vertices.push_back(v3);
+	sword.vertices.push_back(v6);
+	sword.vertices.push_back(v7);
+
+	sword.vertices.push_back(v1);
+	sword.vertices.push_back(v3);
+	sword.vertices.push_back(v5);
+	sword.vertices.push_back(v3);
+	sword.vertices.push_back(v7);
+	sword.vertices.push_back(v5);
+
+	sword.vertices.push_back(v0);
+	sword.vertices.push_back(v4);
+	sword.vertices.push_back(v2);
+	sword.vertices.push_back(v2);
+	sword.vertices.push_back(v4);
+	sword.vertices.push_back(v6);
+
+	sword.vertices.push_back(v1);
+	sword.vertices.push_back(v5);
+	sword.vertices.push_back(v0);
+	sword.vertices.push_back(v0);
+	sword.vertices.push_back(v5);
+	sword.vertices.push_back(v4);
 
 	for (int i = 0; i < 6; ++i)
-		sword->normals.push_back(glm::vec3(-blade_width / 4.f, 0, -handle_width / 6.f));
+		sword.normals.push_back(glm::vec3(-blade_width / 4.f, 0, -handle_width / 6.f));
 	for (int i = 0; i < 6; ++i)
-		sword->normals.push_back(glm::vec3(-blade_width / 4.f, 0, handle_width / 6.f));
+		sword.normals.push_back(glm::vec3(-blade_width / 4.f, 0, handle_width / 6.f));
 	for (int i = 0; i < 6; ++i)
-		sword->normals.push_back(glm::vec3(blade_width / 4.f, 0, -handle_width / 6.f));
+		sword.normals.push_back(glm::vec3(blade_width / 4.f, 0, -handle_width / 6.f));
 	for (int i = 0; i < 6; ++i)
-		sword->normals.push_back(glm::vec3(blade_width / 4.f, 0, handle_width / 6.f));
+		sword.normals.push_back(glm::vec3(blade_width / 4.f, 0, handle_width / 6.f));
 
 	//Make Tip
 	curr_height = curr_height + blade_height;
@@ -706,35 +759,92 @@ Geometry *GeometryGenerator::generate_sword()
 	v3 = { -blade_width / 2.f, curr_height, 0 };
 	v4 = { 0, curr_height + tip_height, 0 }; //Tip
 
-	sword->vertices.push_back(v0);
-	sword->vertices.push_back(v4);
-	sword->vertices.push_back(v1);
-	sword->vertices.push_back(v1);
-	sword->vertices.push_back(v4);
-	sword->vertices.push_back(v3);
-	sword->vertices.push_back(v3);
-	sword->vertices.push_back(v4);
-	sword->vertices.push_back(v2);
-	sword->vertices.push_back(v2);
-	sword->vertices.push_back(v4);
-	sword->vertices.push_back(v0);
+	sword.vertices.push_back(v0);
+	sword.vertices.push_back(v4);
+	sword.vertices.push_back(v1);
+	sword.vertices.push_back(v1);
+	sword.vertices.push_back(v4);
+	sword.vertices.push_back(v3);
+	sword.vertices.push_back(v3);
+	sword.vertices.push_back(v4);
+	sword.vertices.push_back(v2);
+	sword.vertices.push_back(v2);
+	sword.vertices.push_back(v4);
+	sword.vertices.push_back(v0);
 
 	for (int i = 0; i < 3; ++i)
-		sword->normals.push_back(glm::vec3(blade_width / 4.f, curr_height / 2.f, handle_width / 6.f));
+		sword.normals.push_back(glm::vec3(blade_width / 4.f, curr_height / 2.f, handle_width / 6.f));
 	for (int i = 0; i < 3; ++i)
-		sword->normals.push_back(glm::vec3(-blade_width / 4.f, curr_height / 2.f, handle_width / 6.f));
+		sword.normals.push_back(glm::vec3(-blade_width / 4.f, curr_height / 2.f, handle_width / 6.f));
 	for (int i = 0; i < 3; ++i)
-		sword->normals.push_back(glm::vec3(-blade_width / 4.f, curr_height / 2.f, -handle_width / 6.f));
+		sword.normals.push_back(glm::vec3(-blade_width / 4.f, curr_height / 2.f, -handle_width / 6.f));
 	for (int i = 0; i < 3; ++i)
-		sword->normals.push_back(glm::vec3(blade_width / 4.f, curr_height / 2.f, -handle_width / 6.f));
+		sword.normals.push_back(glm::vec3(blade_width / 4.f, curr_height / 2.f, -handle_width / 6.f));
 
 	// Indices
-	for (int i = 0; i < sword->vertices.size(); ++i)
-		sword->indices.push_back(i);
+	for (int i = 0; i < sword.vertices.size(); ++i)
+		sword.indices.push_back(i);
 
-	sword->populate_buffers();
-	geometries.push_back(sword);
 	return sword;
 }
 
 
+
+Geometry * GeometryGenerator::generate_grid_patch(GLuint quads)
+{
+	return add_geometry(grid_patch_data(quads));
+}
+
+MeshData GeometryGenerator::grid_patch_data(GLuint quads)
+{
+	// Unit grid of quads x quads cells in the xz plane, with integer vertex coordinates.
+	// Terrain chunks share it and place, scale and displace it in the vertex shader.
+	MeshData patch;
+	patch.has_normals = false;
+
+	for (GLuint x = 0; x <= quads; ++x)
+		for (GLuint z = 0; z <= quads; ++z)
+			patch.vertices.push_back(glm::vec3((float) x, 0.f, (float) z));
+
+	// Same winding and diagonal as generate_terrain.
+	GLuint side = quads + 1;
+	for (GLuint x = 0; x < quads; ++x)
+	{
+		for (GLuint z = 0; z < quads; ++z)
+		{
+			GLuint v1 = x * side + z;		//Upper Left
+			GLuint v2 = v1 + side;			//Upper Right
+			GLuint v3 = v1 + 1;				//Lower Left
+			GLuint v4 = v2 + 1;				//Lower Right
+			patch.indices.push_back(v1);
+			patch.indices.push_back(v3);
+			patch.indices.push_back(v2);
+			patch.indices.push_back(v2);
+			patch.indices.push_back(v3);
+			patch.indices.push_back(v4);
+		}
+	}
+
+	return patch;
+}
+
+const char * GeometryGenerator::texture_path(int texture_type)
+{
+	if (texture_type == GRASS)
+		return "assets/textures/GrassWW2.dds";
+	else if (texture_type == STONE)
+		return "assets/textures/StoneWW.png";
+	else if (texture_type == SAND)
+		return "assets/textures/SandWW2.dds";
+	else if (texture_type == SAND_TWO)
+		return "assets/textures/Sandy2.png";
+	else if (texture_type == SNOW)
+		return "assets/textures/Snow4.tga";
+	else if (texture_type == OBSIDIAN)
+		return "assets/textures/Obsidian.png";
+	else if (texture_type == SPACE) //Higher Quality, but causes alot of aliasing
+		return "assets/textures/Space.png";
+	else if (texture_type == ROCK)
+		return "assets/textures/Rock.png";
+	return nullptr;
+}
@@ -0,0 +1,117 @@
+#include "gl_state.h"
+
+// Values no real binding can have, so the first call after invalidate() always goes through.
+const GLuint UNKNOWN_NAME = 0xFFFFFFFF;
+const GLint UNKNOWN_VALUE = -1;
+
+bool GLState::enabled = true;
+GLuint GLState::calls_made;
+GLuint GLState::calls_elided;
+GLuint GLState::program = UNKNOWN_NAME;
+GLuint GLState::vertex_array = UNKNOWN_NAME;
+GLuint GLState::active_unit = UNKNOWN_NAME;
+GLuint GLState::textures_2d[MAX_TEXTURE_UNITS] = { UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME };
+GLuint GLState::textures_cube[MAX_TEXTURE_UNITS] = { UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME };
+GLuint GLState::textures_buffer[MAX_TEXTURE_UNITS] = { UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME, UNKNOWN_NAME };
+GLint GLState::cull_enabled = UNKNOWN_VALUE;
+GLint GLState::cull_mode = UNKNOWN_VALUE;
+GLint GLState::depth_write = UNKNOWN_VALUE;
+
+bool GLState::elide(bool unchanged)
+{
+	if (enabled && unchanged)
+	{
+		calls_elided++;
+		return true;
+	}
+	calls_made++;
+	return false;
+}
+
+void GLState::invalidate()
+{
+	program = UNKNOWN_NAME;
+	vertex_array = UNKNOWN_NAME;
+	active_unit = UNKNOWN_NAME;
+	for (GLuint i = 0; i < MAX_TEXTURE_UNITS; ++i)
+	{
+		textures_2d[i] = UNKNOWN_NAME;
+		textures_cube[i] = UNKNOWN_NAME;
+		textures_buffer[i] = UNKNOWN_NAME;
+	}
+	cull_enabled = UNKNOWN_VALUE;
+	cull_mode = UNKNOWN_VALUE;
+	depth_write = UNKNOWN_VALUE;
+}
+
+void GLState::reset_stats()
+{
+	calls_made = 0;
+	calls_elided = 0;
+}
+
+void GLState::use_program(GLuint id)
+{
+	if (elide(program == id))
+		return;
+	glUseProgram(id);
+	program = id;
+}
+
+void GLState::bind_vertex_array(GLuint id)
+{
+	if (elide(vertex_array == id))
+		return;
+	glBindVertexArray(id);
+	vertex_array = id;
+}
+
+void GLState::bind_texture(GLuint unit, GLenum target, GLuint id)
+{
+	// Only 2D, cube map and buffer targets are tracked; anything else always goes through.
+	GLuint *bound = nullptr;
+	if (unit < MAX_TEXTURE_UNITS && target == GL_TEXTURE_2D)
+		bound = &textures_2d[unit];
+	else if (unit < MAX_TEXTURE_UNITS && target == GL_TEXTURE_CUBE_MAP)
+		bound = &textures_cube[unit];
+	else if (unit < MAX_TEXTURE_UNITS && target == GL_TEXTURE_BUFFER)
+		bound = &textures_buffer[unit];
+	if (elide(bound && *bound == id))
+		return;
+
+	if (!elide(active_unit == unit))
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		active_unit = unit;
+	}
+	glBindTexture(target, id);
+	if (bound)
+		*bound = id;
+}
+
+void GLState::set_cull_face(bool enable)
+{
+	if (elide(cull_enabled == (GLint) enable))
+		return;
+	if (enable)
+		glEnable(GL_CULL_FACE);
+	else
+		glDisable(GL_CULL_FACE);
+	cull_enabled = enable;
+}
+
+void GLState::cull_face(GLenum mode)
+{
+	if (elide(cull_mode == (GLint) mode))
+		return;
+	glCullFace(mode);
+	cull_mode = mode;
+}
+
+void GLState::depth_mask(GLboolean enable)
+{
+	if (elide(depth_write == (GLint) enable))
+		return;
+	glDepthMask(enable);
+	depth_write = enable;
+}
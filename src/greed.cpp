@@ -12,6 +12,16 @@
 #include "space_scene.h"
 #include "fire_scene.h"
 #include "bounding_sphere.h"
+#include "uniform_blocks.h"
+#include "gl_state.h"
+#include "job_system.h"
+#include "upload_queue.h"
+#include "frame_tasks.h"
+#include "procedural_cache.h"
+#include "asset_pack.h"
+#include "resource_loader.h"
+#include "geometry_arena.h"
+#include "multi_draw.h"
 #include <cfloat>
 
 #include "util.h"
@@ -48,6 +58,15 @@ const GLfloat PLAYER_HEIGHT = Global::PLAYER_HEIGHT;
 
 const GLfloat FAR_PLANE = (vr_on ? 200.f : 50.f) * PLAYER_HEIGHT;
 const GLfloat FOV = 45.f;
+// Seconds per frame spent uploading regenerated geometry.
+const double UPLOAD_BUDGET = 0.002;
+// Seconds per frame spent on time-sliced setup.
+const double SETUP_BUDGET = 0.002;
+// Fill the island in over the first frames instead of building it all before the first one.
+// Always on when there are no worker threads to build it on.
+const bool TIME_SLICED_SETUP = false;
+// Distance from the exit portal within which the next scene starts building in the background.
+const GLfloat PREFETCH_DISTANCE = 15.f * PLAYER_HEIGHT;
 
 const GLfloat   BASE_CAM_SPEED = PLAYER_HEIGHT / 10.f;
 const GLfloat   EDGE_PAN_THRESH = 5.f;
@@ -56,6 +75,7 @@ const GLfloat   EDGE_PAN_SPEED = 0.5f;
 const GLfloat	CONTROLLER_BALL_SCALE = 0.04f;
 const glm::vec3	CONTROLLER_ROD_SCALE = { 0.05f, 0.08f, 0.05f };
 
+SceneModel *skybox_model;
 SceneTransform *controller_1_transform;
 SceneTransform *controller_2_transform;
 
@@ -65,10 +85,17 @@ Greed::~Greed() {}
 
 void Greed::destroy()
 {
-	// Free memory here.
+	// Free memory here, once no job is still building into a scene.
+	for (Scene *s : scenes)
+		s->wait_for_jobs();
+	ResourceLoader::shutdown();
 	delete(island_scene);
 	ShaderManager::destroy();
+	UniformBlocks::destroy();
 	GeometryGenerator::clean_up();
+	GeometryArena::destroy();
+	JobSystem::destroy();
+	AssetPack::close();
 
 	glfwDestroyWindow(window);
 	glfwTerminate();
@@ -77,7 +104,7 @@ void Greed::destroy()
 void Greed::next_skybox()
 {
 	SkyboxShader * ss = ((SkyboxShader *)ShaderManager::get_shader_program("skybox"));
-	ss->current_texture_id = (ss->current_texture_id + 1) % ss->texture_ids.size();
+	ss->select(ss->current_texture_id + 1);
 }
 
 void Greed::change_scene(Scene * s)
@@ -87,14 +114,9 @@ void Greed::change_scene(Scene * s)
 
 void Greed::next_scene()
 {
-	int curr = 0;
-	for (auto it = scenes.begin(); it != scenes.end(); ++it)
-	{
-		if (*it == scene)
-			curr = (int) (it - scenes.begin());
-	}
+	Scene *next = scene_after(scene);
+	build_scene(next);
 	next_skybox();
-	Scene *next = scenes[(curr + 1) % scenes.size()];
 	next->out_house->play_anim();
 	if (next == fire_scene)
 		island_scene->out_house->reset();
@@ -105,10 +127,13 @@ void Greed::next_scene()
 
 void Greed::setup_shaders()
 {
+	UniformBlocks::init();
 	// Load shaders via a shader manager.
 	ShaderManager::create_shader_program("basic");
 	ShaderManager::create_shader_program("skybox");
 	ShaderManager::create_shader_program("shadow");
+	ShaderManager::create_shader_program("terrain");
+	ShaderManager::create_shader_program("terrain_shadow");
 	ShaderManager::create_shader_program("debug_shadow");
 	ShaderManager::set_default("basic");
 }
@@ -133,54 +158,9 @@ void Greed::setup_scenes()
 	// Skybox
 	Material default_material;
 	Mesh skybox_mesh = { nullptr, default_material, ShaderManager::get_shader_program("skybox"), glm::mat4(1.f) };
-	SceneModel *skybox_model = new SceneModel(scene);
+	skybox_model = new SceneModel(scene);
 	skybox_model->add_mesh(skybox_mesh);
 
-	for (Scene* s : scenes)
-	{
-		s->camera = camera; // Set all cameras to be the same.
-		s->root->add_child(skybox_model); // Skyboxes for all scenes.
-		s->setup();
-	}
-
-	// Setup trigger houses. Set y to be based on appropriate heightmap.
-	desert_scene->out_height = Terrain::height_lookup(island_scene->in_point.x, island_scene->in_point.y, desert_scene->get_size()*2, desert_scene->height_map);
-	SceneTransform *height_adj = new SceneTransform(desert_scene, glm::translate(glm::mat4(1.f), glm::vec3(0.f, desert_scene->out_height - island_scene->in_height, 0.f)));
-	height_adj->add_child(island_scene->in_house);
-	desert_scene->out_house = new SceneTransAnim(desert_scene, glm::vec3(0.f), glm::vec3(0.f, -0.5f, 0.f), false);
-	desert_scene->out_house->add_child(height_adj);
-	desert_scene->root->add_child(desert_scene->out_house);
-
-	snow_scene->out_height = Terrain::height_lookup(desert_scene->in_point.x, desert_scene->in_point.y, snow_scene->get_size() * 2, snow_scene->height_map);
-	height_adj = new SceneTransform(snow_scene, glm::translate(glm::mat4(1.f), glm::vec3(0.f, snow_scene->out_height - desert_scene->in_height, 0.f)));
-	height_adj->add_child(desert_scene->in_house);
-	snow_scene->out_house = new SceneTransAnim(snow_scene, glm::vec3(0.f), glm::vec3(0.f, -0.5f, 0.f), false);
-	snow_scene->out_house->add_child(height_adj);
-	snow_scene->root->add_child(snow_scene->out_house);
-
-	space_scene->out_height = Terrain::height_lookup(snow_scene->in_point.x, snow_scene->in_point.y, space_scene->get_size() * 2, space_scene->height_map);
-	height_adj = new SceneTransform(space_scene, glm::translate(glm::mat4(1.f), glm::vec3(0.f, space_scene->out_height - snow_scene->in_height, 0.f)));
-	height_adj->add_child(snow_scene->in_house);
-	space_scene->out_house = new SceneTransAnim(space_scene, glm::vec3(0.f), glm::vec3(0.f, -0.5f, 0.f), false);
-	space_scene->out_house->add_child(height_adj);
-	space_scene->root->add_child(space_scene->out_house);
-
-	fire_scene->out_height = Terrain::height_lookup(space_scene->in_point.x, space_scene->in_point.y, fire_scene->get_size() * 2, fire_scene->height_map);
-	height_adj = new SceneTransform(fire_scene, glm::translate(glm::mat4(1.f), glm::vec3(0.f, fire_scene->out_height - space_scene->in_height, 0.f)));
-	height_adj->add_child(space_scene->in_house);
-	fire_scene->out_house = new SceneTransAnim(space_scene, glm::vec3(0.f), glm::vec3(0.f, -0.5f, 0.f), false);
-	fire_scene->out_house->add_child(height_adj);
-	fire_scene->root->add_child(fire_scene->out_house);
-
-	// Portal back to island
-	fire_scene->in_height = Terrain::height_lookup(island_scene->out_point.x, island_scene->out_point.y, fire_scene->get_size() * 2, fire_scene->height_map);
-	fire_scene->in_point = island_scene->out_point;
-	fire_scene->in_area[0] = glm::vec2(fire_scene->in_point.x - Global::TRIGGER_HALF_LEN, fire_scene->in_point.y + Global::TRIGGER_HALF_LEN);
-	fire_scene->in_area[1] = glm::vec2(fire_scene->in_point.x + Global::TRIGGER_HALF_LEN, fire_scene->in_point.y - Global::TRIGGER_HALF_LEN);
-	fire_scene->in_house = new SceneTransform(fire_scene, glm::translate(glm::mat4(1.f), glm::vec3(0.f, fire_scene->in_height - island_scene->out_height, 0.f)));
-	fire_scene->in_house->add_child(island_scene->out_house);
-	fire_scene->root->add_child(fire_scene->in_house);
-
 	//Show Vive Controllers using Two Blue Spheres and Ctlinders
 	if (vr_on)
 	{
@@ -195,19 +175,86 @@ void Greed::setup_scenes()
 		rod_material.diffuse = rod_material.ambient = color::black;
 		Mesh rod_mesh = { rod_geo, rod_material, ShaderManager::get_default() };
 		rod_mesh.to_world = glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, 0.06f)) * glm::rotate(glm::mat4(1.f), glm::pi<float>() / 2.f, glm::vec3(1.f, 0.f, 0.0f)) * glm::scale(glm::mat4(1.f), CONTROLLER_ROD_SCALE);
-		SceneModel *controller_model = new SceneModel(scene);
-		controller_model->add_mesh(sphere_mesh);
-		controller_model->add_mesh(rod_mesh);
-		controller_1_transform = new SceneTransform(scene, glm::translate(glm::mat4(1.f), glm::vec3(0.0f, 0.f, 0.0f)));
-		controller_2_transform = new SceneTransform(scene, glm::translate(glm::mat4(1.f), glm::vec3(0.0f, 0.f, 0.0f)));
-		controller_1_transform->add_child(controller_model);
-		controller_2_transform->add_child(controller_model);
-		
-		for (Scene * s : scenes)
+		// One model per controller, since groups delete their children.
+		SceneModel *controller_1_model = new SceneModel(scene);
+		SceneModel *controller_2_model = new SceneModel(scene);
+		for (SceneModel *controller_model : { controller_1_model, controller_2_model })
 		{
-			s->root->add_child(controller_1_transform);
-			s->root->add_child(controller_2_transform);
+			controller_model->add_mesh(sphere_mesh);
+			controller_model->add_mesh(rod_mesh);
 		}
+		controller_1_transform = new SceneTransform(scene, glm::translate(glm::mat4(1.f), glm::vec3(0.0f, 0.f, 0.0f)));
+		controller_2_transform = new SceneTransform(scene, glm::translate(glm::mat4(1.f), glm::vec3(0.0f, 0.f, 0.0f)));
+		controller_1_transform->add_child(controller_1_model);
+		controller_2_transform->add_child(controller_2_model);
+	}
+
+	// Only the island is built up front; the others follow along the portal chain.
+	island_scene->time_sliced = TIME_SLICED_SETUP || JobSystem::num_threads() == 1;
+	build_scene(island_scene);
+}
+
+Scene *Greed::scene_after(Scene *s)
+{
+	int curr = 0;
+	for (auto it = scenes.begin(); it != scenes.end(); ++it)
+	{
+		if (*it == s)
+			curr = (int) (it - scenes.begin());
+	}
+	return scenes[(curr + 1) % scenes.size()];
+}
+
+void Greed::build_scene(Scene *s)
+{
+	if (s->constructed)
+		return;
+	// Blocks only if a prefetch is still running, or never started.
+	s->finish_construction();
+
+	// Set all cameras to be the same. Scenes built in the background moved their own.
+	if (s->camera != camera)
+	{
+		delete(s->camera);
+		s->camera = camera;
+	}
+	s->root->add_child(skybox_model); // Skyboxes for all scenes.
+	if (vr_on)
+	{
+		s->root->add_child(controller_1_transform);
+		s->root->add_child(controller_2_transform);
+	}
+
+	// The island's portals are made by its neighbours, which are always built after it.
+	if (s == island_scene)
+		return;
+	// Portals may still be waiting in time-sliced setup.
+	FrameTasks::flush();
+
+	// Setup trigger house. Set y to be based on appropriate heightmap.
+	Scene *prev = island_scene;
+	for (Scene *candidate : scenes)
+	{
+		if (scene_after(candidate) == s)
+			prev = candidate;
+	}
+	s->out_height = Terrain::height_lookup(prev->in_point.x, prev->in_point.y, s->get_size() * 2, s->height_map);
+	SceneTransform *height_adj = new SceneTransform(s, glm::translate(glm::mat4(1.f), glm::vec3(0.f, s->out_height - prev->in_height, 0.f)));
+	height_adj->add_child(prev->in_house);
+	s->out_house = new SceneTransAnim(s, glm::vec3(0.f), glm::vec3(0.f, -0.5f, 0.f), false);
+	s->out_house->add_child(height_adj);
+	s->root->add_child(s->out_house);
+
+	// Portal back to island
+	if (s == fire_scene)
+	{
+		fire_scene->in_height = Terrain::height_lookup(island_scene->out_point.x, island_scene->out_point.y, fire_scene->get_size() * 2, fire_scene->height_map);
+		fire_scene->in_point = island_scene->out_point;
+		fire_scene->in_area[0] = glm::vec2(fire_scene->in_point.x - Global::TRIGGER_HALF_LEN, fire_scene->in_point.y + Global::TRIGGER_HALF_LEN);
+		fire_scene->in_area[1] = glm::vec2(fire_scene->in_point.x + Global::TRIGGER_HALF_LEN, fire_scene->in_point.y - Global::TRIGGER_HALF_LEN);
+		fire_scene->in_house = new SceneTransform(fire_scene, glm::translate(glm::mat4(1.f), glm::vec3(0.f, fire_scene->in_height - island_scene->out_height, 0.f)));
+		fire_scene->in_house->add_child(island_scene->out_house);
+		fire_scene->root->add_child(fire_scene->in_house);
 	}
 }
 
@@ -218,11 +265,20 @@ void Greed::go()
 	setup_callbacks();
 	setup_opengl();
 	if (vr_on) GreedVR::init();
+	// Without a second context, everything loads on this thread as before.
+	ResourceLoader::init(window);
 
+	// Loose files under assets/ are used for anything not baked.
+	AssetPack::open(ASSET_PACK_PATH);
 	setup_shaders();
-	// Seed PRNG.
-	Util::seed(0);
+	JobSystem::init(0);
+	ProceduralCache::init("cache");
+	// The same world every run, so a warm start finds all of it in the cache.
+	Util::seed(ProceduralCache::world_seed());
 	setup_scenes();
+	UploadQueue::flush();
+	JobSystem::print_stats();
+	ProceduralCache::print_stats();
 
 	// Send height/width of window
 	int width, height;
@@ -241,7 +297,10 @@ void Greed::go()
 		double curr_time = glfwGetTime();
 		if (curr_time - prev_ticks > 1.f)
 		{
-			std::cerr << "FPS: " << frame << std::endl;
+			std::cerr << "FPS: " << frame << " (meshes drawn: " << Scene::meshes_drawn << ", culled: " << Scene::meshes_culled
+				<< ", terrain triangles: " << Scene::terrain_triangles
+				<< ", GL calls: " << GLState::calls_made << ", elided: " << GLState::calls_elided
+				<< ", multi-draws: " << MultiDraw::draws_merged << " in " << MultiDraw::calls_made << " calls)" << std::endl;
 			frame = 0;
 			prev_ticks = curr_time;
 		}
@@ -275,14 +334,29 @@ void Greed::go()
 			glm::vec2 position = { camera->cam_pos.x, camera->cam_pos.z };
 			if (Util::within_rect(position, scene->in_area[0], scene->in_area[1]))
 				next_scene();
+			else if (glm::distance(position, scene->in_point) < PREFETCH_DISTANCE)
+			{
+				// Walking through the portal also moves on to the next skybox.
+				SkyboxShader *ss = (SkyboxShader *)ShaderManager::get_shader_program("skybox");
+				scene_after(scene)->construct_async();
+				ss->prefetch(ss->current_texture_id + 1);
+			}
 
 			move_prev_ticks = curr_time;
 		}
 
 		glfwGetFramebufferSize(window, &width, &height);
-		scene->update_frustum_planes();
 		scene->update_frustum_corners(width, height, FAR_PLANE);
 
+		FrameTasks::process(SETUP_BUDGET);
+		UploadQueue::process(UPLOAD_BUDGET);
+		ResourceLoader::process();
+		// Swap in finished regenerations before anything is drawn this frame.
+		for (Scene *s : scenes)
+			s->finish_regeneration();
+
+		GLState::reset_stats();
+		MultiDraw::reset_stats();
 		// First pass: shadowmap.
 		shadow_pass();
 
@@ -296,17 +370,20 @@ void Greed::go()
 			GreedVR::vr_update_controllers(scene, controller_1_transform, controller_2_transform, glm::translate(glm::mat4(1.0f), camera->cam_pos));
 			GreedVR::vr_check_interaction(controller_1_transform, controller_2_transform, scene->interactable_objects);
 			vr_interaction_check();
+			Scene::reset_cull_stats();
+			scene->update_bounds();
 			vr_render(); //Render Scene			
 		}
 		else {
+			Scene::reset_cull_stats();
+			scene->update_bounds();
 			scene->render();
 			// Debug shadows.
 			if (debug_shadows)
 			{
 				glViewport(0, 0, width / 3, height / 3);
 				ShaderManager::get_shader_program("debug_shadow")->use();
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, ((ShadowShader *)ShaderManager::get_shader_program("shadow"))->shadow_map_tex);
+				GLState::bind_texture(0, GL_TEXTURE_2D, ((ShadowShader *)ShaderManager::get_shader_program("shadow"))->shadow_map_tex);
 				Util::render_quad();
 			}
 		}
@@ -337,11 +414,15 @@ void Greed::shadow_pass()
 	}
 	else
 		ss->light_proj = glm::ortho(-1.f, 1.f, -1.f, 1.f, 0.f, 0.1f);
+	ss->update_light_matrix();
+	// Light data is shared by the shadow and main passes.
+	UniformBlocks::update_frame(ss->light_matrix, -scene->light_pos, glm::vec3(1.f, 1.f, 1.f), 0.2f, (GLfloat) glfwGetTime());
 	// Render using scene graph.
-	glDisable(GL_CULL_FACE);
+	GLState::set_cull_face(false);
 	scene->pass(ss);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
+	ss->flush();
+	GLState::set_cull_face(true);
+	GLState::cull_face(GL_BACK);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
@@ -393,6 +474,8 @@ void Greed::vr_render()
 
 		const vr::Texture_t tex = { reinterpret_cast<void*>(intptr_t(GreedVR::vars.colorRenderTarget[eye])), vr::API_OpenGL, vr::ColorSpace_Gamma };
 		vr::VRCompositor()->Submit(vr::EVREye(eye), &tex);
+		// The compositor may change bindings behind our back.
+		GLState::invalidate();
 	}	
 
 	//Process VR Event
@@ -592,17 +675,18 @@ void Greed::key_callback(GLFWwindow* window, int key, int scancode, int action,
 				if (keys[GLFW_KEY_LEFT_SHIFT])
 					((IslandScene *) scene)->generate_small_forest();
 				else
-					((IslandScene *)scene)->generate_forest();
+					((IslandScene *)scene)->regenerate_forest();
 			}
 			break;
 		case GLFW_KEY_M:
 			if (scene == island_scene)
 			{
-				((IslandScene *)scene)->generate_map();
-				((IslandScene *)scene)->generate_small_map();
+				((IslandScene *)scene)->regenerate_map();
 			}
 			else if (scene == desert_scene)
-				((DesertScene *)scene)->generate_map();
+			{
+				((DesertScene *)scene)->regenerate_map();
+			}
 			break;
 		case GLFW_KEY_V:
 			if (scene == island_scene)
@@ -610,7 +694,7 @@ void Greed::key_callback(GLFWwindow* window, int key, int scancode, int action,
 				if (keys[GLFW_KEY_LEFT_SHIFT])
 					((IslandScene *)scene)->generate_small_village();
 				else
-					((IslandScene *)scene)->generate_village();
+					((IslandScene *)scene)->regenerate_village();
 			}
 			break;
 		case GLFW_KEY_G:
@@ -759,19 +843,19 @@ void Greed::vr_interaction_check()
 			case GENERATE_FOREST:
 				if (scene == island_scene)
 				{
-					((IslandScene*) scene)->generate_forest();
+					((IslandScene*) scene)->regenerate_forest();
 				}
 				break;
 			case GENERATE_TERRAIN:
 				if (scene == island_scene)
 				{
-					((IslandScene*)scene)->generate_map();
+					((IslandScene*)scene)->regenerate_map();
 				}
 				break;
 			case GENERATE_VILLAGE:
 				if (scene == island_scene)
 				{
-					((IslandScene*)scene)->generate_village();
+					((IslandScene*)scene)->regenerate_village();
 				}
 				//fprintf(stderr, "INTERACT VILLAGE\n");
 				break;
@@ -0,0 +1,176 @@
+#include "height_map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+// Cache line size, so rows and tiles never straddle more lines than they must.
+const size_t HEIGHT_MAP_ALIGNMENT = 64;
+
+HeightMap::HeightMap()
+{
+	side = 0;
+	tiles_per_side = 0;
+	tiled = false;
+	count = 0;
+	buffer = nullptr;
+	data = nullptr;
+}
+
+HeightMap::HeightMap(GLuint side, GLfloat fill_value, bool tiled)
+{
+	buffer = nullptr;
+	allocate(side, tiled);
+	fill(fill_value);
+}
+
+HeightMap::HeightMap(const HeightMap &other)
+{
+	buffer = nullptr;
+	allocate(other.side, other.tiled);
+	if (count)
+		std::memcpy(data, other.data, count * sizeof(GLfloat));
+}
+
+HeightMap::HeightMap(HeightMap &&other)
+{
+	side = other.side;
+	tiles_per_side = other.tiles_per_side;
+	tiled = other.tiled;
+	count = other.count;
+	buffer = other.buffer;
+	data = other.data;
+	other.buffer = nullptr;
+	other.data = nullptr;
+	other.side = 0;
+	other.count = 0;
+}
+
+HeightMap &HeightMap::operator=(const HeightMap &other)
+{
+	if (this != &other)
+	{
+		release();
+		allocate(other.side, other.tiled);
+		if (count)
+			std::memcpy(data, other.data, count * sizeof(GLfloat));
+	}
+	return *this;
+}
+
+HeightMap &HeightMap::operator=(HeightMap &&other)
+{
+	if (this != &other)
+	{
+		release();
+		side = other.side;
+		tiles_per_side = other.tiles_per_side;
+		tiled = other.tiled;
+		count = other.count;
+		buffer = other.buffer;
+		data = other.data;
+		other.buffer = nullptr;
+		other.data = nullptr;
+		other.side = 0;
+		other.count = 0;
+	}
+	return *this;
+}
+
+HeightMap::~HeightMap()
+{
+	release();
+}
+
+void HeightMap::allocate(GLuint side, bool tiled)
+{
+	this->side = side;
+	this->tiled = tiled;
+	tiles_per_side = (side + TILE_MASK) >> TILE_SHIFT;
+	// Tiles cover the whole grid, so the last row and column of tiles are partly padding.
+	count = tiled ? (size_t) tiles_per_side * tiles_per_side << (2 * TILE_SHIFT) : (size_t) side * side;
+	if (!count)
+	{
+		buffer = nullptr;
+		data = nullptr;
+		return;
+	}
+
+	buffer = ::operator new(count * sizeof(GLfloat) + HEIGHT_MAP_ALIGNMENT);
+	uintptr_t aligned = ((uintptr_t) buffer + HEIGHT_MAP_ALIGNMENT - 1) & ~(uintptr_t) (HEIGHT_MAP_ALIGNMENT - 1);
+	data = (GLfloat *) aligned;
+}
+
+void HeightMap::release()
+{
+	::operator delete(buffer);
+	buffer = nullptr;
+	data = nullptr;
+}
+
+void HeightMap::fill(GLfloat value)
+{
+	std::fill(data, data + count, value);
+}
+
+GLfloat HeightMap::sample(GLfloat x, GLfloat y, GLfloat length) const
+{
+	// Translate to height map coordinates.
+	GLfloat last = (GLfloat) (side - 1);
+	GLfloat mid = length / 2.f;
+	x = glm::clamp(((x + mid) / length) * last, 0.f, last);
+	y = glm::clamp(((y + mid) / length) * last, 0.f, last);
+
+	GLuint x0 = (GLuint) x;
+	GLuint y0 = (GLuint) y;
+	GLuint x1 = std::min(x0 + 1, side - 1);
+	GLuint y1 = std::min(y0 + 1, side - 1);
+	GLfloat rx = x - x0;
+	GLfloat ry = y - y0;
+
+	GLfloat h0 = (at(x0, y0) * (1.f - rx)) + (at(x1, y0) * rx);
+	GLfloat h1 = (at(x0, y1) * (1.f - rx)) + (at(x1, y1) * rx);
+	return (h0 * (1.f - ry)) + (h1 * ry);
+}
+
+void HeightMap::sample(const glm::vec2 *points, size_t num_points, GLfloat length, GLfloat *heights) const
+{
+	// The per-point work of sample() with the scale hoisted out of the loop.
+	GLfloat last = (GLfloat) (side - 1);
+	GLfloat scale = last / length;
+	GLfloat offset = last / 2.f;
+	for (size_t i = 0; i < num_points; ++i)
+	{
+		GLfloat x = glm::clamp(points[i].x * scale + offset, 0.f, last);
+		GLfloat y = glm::clamp(points[i].y * scale + offset, 0.f, last);
+		GLuint x0 = (GLuint) x;
+		GLuint y0 = (GLuint) y;
+		GLuint x1 = std::min(x0 + 1, side - 1);
+		GLuint y1 = std::min(y0 + 1, side - 1);
+		GLfloat rx = x - x0;
+		GLfloat ry = y - y0;
+
+		GLfloat h0 = (at(x0, y0) * (1.f - rx)) + (at(x1, y0) * rx);
+		GLfloat h1 = (at(x0, y1) * (1.f - rx)) + (at(x1, y1) * rx);
+		heights[i] = (h0 * (1.f - ry)) + (h1 * ry);
+	}
+}
+
+void HeightMap::copy_rows(GLfloat *out) const
+{
+	if (!tiled)
+	{
+		std::memcpy(out, data, count * sizeof(GLfloat));
+		return;
+	}
+	for (GLuint x = 0; x < side; ++x)
+		for (GLuint y = 0; y < side; ++y)
+			*out++ = at(x, y);
+}
+
+const GLfloat *HeightMap::rows() const
+{
+	return tiled ? nullptr : data;
+}
@@ -6,9 +6,12 @@
 #include "tree.h"
 #include "scene_animation.h"
 #include "geometry_generator.h"
+#include "scene_terrain.h"
 #include "shape_grammar.h"
+#include "frame_tasks.h"
 
 #include <iostream>
+#include <memory>
 
 const GLfloat PLAYER_HEIGHT = Global::PLAYER_HEIGHT;
 
@@ -17,10 +20,14 @@ const GLfloat PLAYER_HEIGHT = Global::PLAYER_HEIGHT;
 const GLuint    HEIGHT_MAP_POWER = 8;
 const GLuint    HEIGHT_MAP_SIZE = (unsigned int)glm::pow(2, HEIGHT_MAP_POWER) + 1;
 const GLint     VILLAGE_DIAMETER = (int)(0.23f * HEIGHT_MAP_SIZE);
-const GLuint    TERRAIN_RESOLUTION = 300;
 const GLuint    NUM_TREES = 100;
 const GLfloat   PERCENT_TREE_ANIM = 0.9f;
 const GLfloat   TREE_SCALE = 1.5f;
+const GLuint    NUM_TREE_VARIANTS = 8;
+const GLuint    TREE_ITERATIONS = 7;
+const GLuint    TREE_LEAF_LAYERS = 1;
+const GLfloat   TREE_ANGLE = 20.f;
+const GLfloat   TREE_SIZE = 2.f;
 const GLint		NUM_BUILDINGS = 5;
 
 // Dependent on island size/player height
@@ -56,8 +63,6 @@ const GLuint  NUM_SMALL_BUILDINGS = 5;
 const GLfloat SMALL_BUILDING_SCALE = 0.05f;//0.1f;
 const GLfloat SMALL_VILLAGE_RADIUS = 0.5f;//1.5f;
 
-SceneTransform *cube_translate;
-
 GLfloat IslandScene::get_size()
 {
 	return ISLAND_SIZE;
@@ -83,6 +88,14 @@ void IslandScene::setup()
 	// Generate everything.
 	generate_planes();
 	generate_map();
+	if (time_sliced)
+	{
+		// Ground first, so there is something to stand on; the rest fills in over the next frames.
+		add_forest_task();
+		add_village_task();
+		add_miniatures_task();
+		return;
+	}
 	generate_forest();
 	generate_village();
 	generate_miniatures();
@@ -106,7 +119,7 @@ void IslandScene::generate_planes()
 	root->add_child(water_translate);
 
 	// Curvy beach plane, named Bezier Beach Resort
-	Geometry *beach_geo = GeometryGenerator::generate_bezier_plane(ISLAND_SIZE*1.5f, 50, 150, 0.1f, SAND, 0);
+	Geometry *beach_geo = GeometryGenerator::generate_bezier_plane(ISLAND_SIZE*1.5f, 50, 150, 0.1f, SAND, rng.next());
 	Material beach_material;
 	beach_material.diffuse = beach_material.ambient = color::windwaker_sand;
 	beach_material.shadows = false;
@@ -120,10 +133,33 @@ void IslandScene::generate_planes()
 	root->add_child(beach_translate);
 }
 
-void IslandScene::generate_map()
+void IslandScene::prepare()
 {
-	std::cerr << "Generating Map...";
+	height_map = build_height_map(rng.next());
+}
 
+HeightMap IslandScene::build_height_map(uint32_t seed)
+{
+	return Terrain::generate_height_map(HEIGHT_MAP_SIZE, HEIGHT_MAP_MAX, VILLAGE_DIAMETER, HEIGHT_RANDOMNESS_SCALE, true, false, TERRAIN_SMOOTHNESS, seed);
+}
+
+SceneTerrain *IslandScene::build_terrain(const HeightMap &map, bool miniature)
+{
+	// Mainland, with the village plateau and the beachfront. The miniature shares the height
+	// map; distance alone keeps it at the coarsest levels.
+	Material land_material;
+	land_material.diffuse = land_material.ambient = color::windwaker_green;
+	land_material.shadows = !miniature;
+	SceneTerrain *terrain = new SceneTerrain(this, TERRAIN_SIZE, map, land_material);
+	terrain->no_culling = miniature;
+	terrain->add_band(0.0f, BEACH_HEIGHT, SAND, true);
+	terrain->add_band(BEACH_HEIGHT, HEIGHT_MAP_MAX * 0.8f, GRASS, false);
+	terrain->add_band(HEIGHT_MAP_MAX * 0.8f, HEIGHT_MAP_MAX, STONE, false);
+	return terrain;
+}
+
+void IslandScene::place_map(SceneTerrain *terrain)
+{
 	if (!map)
 	{
 		map = new SceneTransform(this, glm::scale(glm::mat4(1.f), glm::vec3(TERRAIN_SCALE, 1.f, TERRAIN_SCALE)));
@@ -133,183 +169,305 @@ void IslandScene::generate_map()
 		map->remove_all();
 	}
 
-	height_map = Terrain::generate_height_map(HEIGHT_MAP_SIZE, HEIGHT_MAP_MAX, VILLAGE_DIAMETER, HEIGHT_RANDOMNESS_SCALE, true, false, TERRAIN_SMOOTHNESS, 0);
 	float cam_height = Terrain::height_lookup(0.f, ISLAND_SIZE - CAM_OFFSET, ISLAND_SIZE * 2, height_map);
 	camera->cam_pos.y = cam_height + PLAYER_HEIGHT;
 	camera->recalculate();
 
-	// Mainland
-	// Second Parameter Below is Resolution^2 of Island, LOWER TO RUN FASTER
-	land_geo = GeometryGenerator::generate_terrain(TERRAIN_SIZE, TERRAIN_RESOLUTION, BEACH_HEIGHT, HEIGHT_MAP_MAX * 0.8f, false, GRASS, height_map);
-	Material land_material;
-	land_material.diffuse = land_material.ambient = color::windwaker_green;
-	Mesh land_mesh = { land_geo, land_material, ShaderManager::get_default(), glm::mat4(1.f) };
-
-	// Plateau/village
-	plateau_geo = GeometryGenerator::generate_terrain(TERRAIN_SIZE, TERRAIN_RESOLUTION, HEIGHT_MAP_MAX * 0.8f, HEIGHT_MAP_MAX, false, STONE, height_map);
-	Material plateau_material;
-	plateau_material.diffuse = plateau_material.ambient = color::bone_white;
-	Mesh plateau_mesh = { plateau_geo, plateau_material, ShaderManager::get_default(), glm::mat4(1.f) };
-
-	// Beachfront
-	sand_geo = GeometryGenerator::generate_terrain(TERRAIN_SIZE, TERRAIN_RESOLUTION, 0.0f, BEACH_HEIGHT, true, SAND, height_map);
-	Material sand_material;
-	sand_material.diffuse = sand_material.ambient = color::windwaker_sand;
-	Mesh sand_mesh = { sand_geo, sand_material, ShaderManager::get_default(), glm::mat4(1.f) };
-
-	SceneModel *terrain_model = new SceneModel(this);
-	terrain_model->add_mesh(land_mesh);
-	terrain_model->add_mesh(sand_mesh);
-	terrain_model->add_mesh(plateau_mesh);
-	map->add_child(terrain_model);
-	std::cerr << "OK." << std::endl;
+	map->add_child(terrain);
 }
 
-void IslandScene::generate_forest()
+void IslandScene::generate_map()
 {
-	std::cerr << "Generating Forest...";
+	std::cerr << "Generating Map...";
+	place_map(build_terrain(height_map, false));
+	std::cerr << "OK." << std::endl;
+}
 
-	if (!forest)
-	{
-		forest = new SceneGroup(this);
-		root->add_child(forest);
-	}
-	else {
-		forest->remove_all();
-	}
+void IslandScene::regenerate_map()
+{
+	uint32_t seed = rng.next();
+	std::shared_ptr<HeightMap> new_map = std::make_shared<HeightMap>();
+	std::shared_ptr<SceneTerrain *> terrain = std::make_shared<SceneTerrain *>(nullptr);
+	std::shared_ptr<SceneTerrain *> small_terrain = std::make_shared<SceneTerrain *>(nullptr);
+	regenerate([=]() {
+		*new_map = build_height_map(seed);
+		*terrain = build_terrain(*new_map, false);
+		*small_terrain = build_terrain(*new_map, true);
+	}, [=]() {
+		height_map = std::move(*new_map);
+		place_map(*terrain);
+		place_small_map(*small_terrain);
+	});
+}
 
+std::vector<TreeInstance> IslandScene::place_trees(const HeightMap &map, Random &forest_rng)
+{
 	glm::vec3 leaf_colors[] = { color::olive_green, color::olive_green, color::olive_green, color::autumn_orange, color::purple, color::bone_white, color::indian_red };
 	glm::vec3 branch_colors[] = { color::brown, color::wood_saddle, color::wood_sienna, color::wood_tan, color::wood_tan_light };
-	Material branch_material, leaf_material;
+	std::vector<TreeInstance> trees;
 	for (int i = 0; i < NUM_TREES; ++i) {
-		if (i % 49 == 0)
-			std::cerr << " . ";
-
 		// Randomise colours, animation, location.
-		leaf_material.diffuse = leaf_material.ambient = leaf_colors[(int)Util::random(0, 7)];
-		branch_material.diffuse = branch_material.ambient = branch_colors[(int)Util::random(0, 5)];
+		TreeInstance tree;
+		tree.leaf_color = leaf_colors[(int)forest_rng.random(0, 7)];
+		tree.branch_color = branch_colors[(int)forest_rng.random(0, 5)];
 		bool animated = false;
 		if (i % (NUM_TREES / (int)(NUM_TREES*PERCENT_TREE_ANIM)) == 0)
 			animated = true;
 		float x, z;
 		do {
-			float angle = Util::random(0, 360);
-			float distance = Util::random(FOREST_INNER_CIRCLE, FOREST_RADIUS);
+			float angle = forest_rng.random(0, 360);
+			float distance = forest_rng.random(FOREST_INNER_CIRCLE, FOREST_RADIUS);
 
 			x = glm::cos(glm::radians(angle)) * distance;
 			z = glm::sin(glm::radians(angle)) * distance;
 		} while (Util::within_rect(glm::vec2(x, z), glm::vec2(-PATH_WIDTH / 2, FOREST_RADIUS), glm::vec2(PATH_WIDTH / 2, 0)));
-		float y = Terrain::height_lookup(x, z, ISLAND_SIZE * 2, height_map);
+		float y = Terrain::height_lookup(x, z, ISLAND_SIZE * 2, map);
 		glm::vec3 location = { x, y, z };
 
-		// Ugly code below.
-		SceneGroup *tree = Tree::generate_tree(this, cylinder_geo, diamond_geo, 7, 1, 20.f, 2.f, branch_material, leaf_material, animated, location, 0);
-		((SceneModel *)(tree->children[0]))->meshes[0].to_world = glm::translate(glm::mat4(1.f), location) * glm::scale(glm::mat4(1.f), glm::vec3(TREE_SCALE));
-		if (animated)
-			((SceneModel *)((SceneAnimation *)(tree->children[1]))->children[0])->meshes[0].to_world = glm::translate(glm::mat4(1.f), location) * glm::scale(glm::mat4(1.f), glm::vec3(TREE_SCALE));
-		else
-			((SceneModel *)(tree->children[1]))->meshes[0].to_world = glm::translate(glm::mat4(1.f), location) * glm::scale(glm::mat4(1.f), glm::vec3(TREE_SCALE));
-		// Phew.
-		forest->add_child(tree);
+		// Spin each instance so repeated variants don't line up.
+		tree.to_world = glm::translate(glm::mat4(1.f), location) * glm::rotate(glm::mat4(1.f), glm::radians(forest_rng.random(0, 360)), glm::vec3(0.f, 1.f, 0.f)) * glm::scale(glm::mat4(1.f), glm::vec3(TREE_SCALE));
+		tree.animated = animated;
+		trees.push_back(tree);
 	}
-	std::cerr << "OK." << std::endl;
+	return trees;
 }
 
-void IslandScene::generate_village()
+SceneGroup *IslandScene::build_forest(const HeightMap &map, Random forest_rng)
 {
-	std::cerr << "Generating Village...";
+	std::vector<TreeInstance> trees = place_trees(map, forest_rng);
+	return Tree::generate_forest(this, cylinder_geo, diamond_geo, NUM_TREE_VARIANTS, TREE_ITERATIONS, TREE_LEAF_LAYERS, TREE_ANGLE, TREE_SIZE, trees, forest_rng.fork());
+}
 
-	if (!village)
+void IslandScene::place_forest(SceneGroup *trees)
+{
+	if (!forest)
 	{
-		village = new SceneGroup(this);
-		root->add_child(village);
-		out_house = new SceneTransAnim(this, glm::vec3(0.f), glm::vec3(0.f, -0.5f, 0.f), false);
-		root->add_child(out_house);
-
-		cube_translate = new SceneTransform(this, glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.8f*PLAYER_HEIGHT, 0.f)));
+		forest = new SceneGroup(this);
+		root->add_child(forest);
 	}
 	else {
-		village->remove_all();
-		out_house->remove_all();
-		cube_translate->remove_all();
+		forest->remove_all();
 	}
+	forest->add_child(trees);
+}
 
-	for (int i = 0; i < NUM_BUILDINGS; ++i)
-	{
-		float angle = ((360.f / (NUM_BUILDINGS)) * i) - 54.f; //Circles around, starting from the right
-		float distance = VILLAGE_DIAMETER_TRUE / 3.f;
+void IslandScene::generate_forest()
+{
+	std::cerr << "Generating Forest...";
+	place_forest(build_forest(height_map, rng.fork()));
+	std::cerr << "OK." << std::endl;
+}
+
+void IslandScene::add_forest_task()
+{
+	// Tree placement, then one variant per step, then the instanced forest itself.
+	Random forest_rng = rng.fork();
+	Random tree_rng;
+	std::vector<TreeInstance> trees;
+	std::vector<TreeParts> variants;
+	FrameTasks::add([=]() mutable {
+		if (trees.empty())
+		{
+			trees = place_trees(height_map, forest_rng);
+			tree_rng = forest_rng.fork();
+			return false;
+		}
+		if (variants.size() < NUM_TREE_VARIANTS)
+		{
+			variants.emplace_back();
+			Tree::grow_variant(variants.back(), (unsigned int) variants.size() - 1, TREE_ITERATIONS, TREE_LEAF_LAYERS, TREE_ANGLE, TREE_SIZE, tree_rng);
+			return false;
+		}
+		place_forest(Tree::assemble_forest(this, cylinder_geo, diamond_geo, variants, trees, tree_rng));
+		return true;
+	});
+}
 
-		float x = glm::cos(glm::radians(angle)) * distance;
-		float z = -glm::sin(glm::radians(angle)) * distance;
+void IslandScene::regenerate_forest()
+{
+	Random forest_rng = rng.fork();
+	std::shared_ptr<SceneGroup *> trees = std::make_shared<SceneGroup *>(nullptr);
+	regenerate([=]() {
+		*trees = build_forest(height_map, forest_rng);
+	}, [=]() {
+		place_forest(*trees);
+	});
+}
 
-		float y = Terrain::height_lookup(x, z, ISLAND_SIZE * 2, this->height_map);
-		glm::vec3 location = { x, y, z };
+SceneTransform *IslandScene::build_building(const HeightMap &map, int i, Random building_rng)
+{
+	float angle = ((360.f / (NUM_BUILDINGS)) * i) - 54.f; //Circles around, starting from the right
+	float distance = VILLAGE_DIAMETER_TRUE / 3.f;
+
+	float x = glm::cos(glm::radians(angle)) * distance;
+	float z = -glm::sin(glm::radians(angle)) * distance;
 
-		float rot = glm::radians(-90.f + angle);
+	float y = Terrain::height_lookup(x, z, ISLAND_SIZE * 2, map);
+	glm::vec3 location = { x, y, z };
 
-		SceneModel *building = ShapeGrammar::generate_building(this, true, 0);
-		SceneTransform *building_rotate = new SceneTransform(this, glm::rotate(glm::mat4(1.f), rot, glm::vec3(0.f, 1.f, 0.f)));
-		SceneTransform *building_translate = new SceneTransform(this, glm::translate(glm::mat4(1.f), location));
-		building_rotate->add_child(building);
-		building_translate->add_child(building_rotate);
+	float rot = glm::radians(-90.f + angle);
 
+	SceneModel *building = ShapeGrammar::generate_building(this, true, building_rng);
+	SceneTransform *building_rotate = new SceneTransform(this, glm::rotate(glm::mat4(1.f), rot, glm::vec3(0.f, 1.f, 0.f)));
+	SceneTransform *building_translate = new SceneTransform(this, glm::translate(glm::mat4(1.f), location));
+	building_rotate->add_child(building);
+	building_translate->add_child(building_rotate);
+
+	// The two portal buildings are marked with a red cube each.
+	if (i == 0 || i == NUM_BUILDINGS - 1)
+	{
 		Material cube_mat;
 		cube_mat.diffuse = cube_mat.ambient = color::red;
 		Mesh cube_mesh = { cube_geo, cube_mat, ShaderManager::get_default(), glm::mat4(1.f) };
 		SceneModel *cube_model = new SceneModel(this);
 		cube_model->add_mesh(cube_mesh);
 		SceneTransform *cube_scale = new SceneTransform(this, glm::scale(glm::mat4(1.f), glm::vec3(0.4f*PLAYER_HEIGHT)));
+		SceneTransform *cube_translate = new SceneTransform(this, glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.8f*PLAYER_HEIGHT, 0.f)));
 		cube_scale->add_child(cube_model);
 		cube_translate->add_child(cube_scale);
+		building_rotate->add_child(cube_translate);
+	}
+	return building_translate;
+}
 
-		if (i == 0)
-		{
-			building_rotate->add_child(cube_translate);
-			out_house->add_child(building_translate);
-			out_height = y;
-			out_point = glm::vec2(x, z);
-		}
-		else if (i == NUM_BUILDINGS - 1)
-		{
-			building_rotate->add_child(cube_translate);
-			in_house = building_translate;
-			in_height = y;
-			in_area[0] = glm::vec2(x-Global::TRIGGER_HALF_LEN, z+ Global::TRIGGER_HALF_LEN);
-			in_area[1] = glm::vec2(x+ Global::TRIGGER_HALF_LEN, z- Global::TRIGGER_HALF_LEN);
-			in_point = glm::vec2(x, z);
-			village->add_child(building_translate);
-		}
-		else {
-			village->add_child(building_translate);
-		}
+std::vector<SceneTransform *> IslandScene::build_village(const HeightMap &map, std::vector<Random> building_rngs)
+{
+	std::vector<SceneTransform *> buildings;
+	for (int i = 0; i < NUM_BUILDINGS; ++i)
+		buildings.push_back(build_building(map, i, building_rngs[i]));
+	return buildings;
+}
+
+void IslandScene::place_village(const std::vector<SceneTransform *> &buildings)
+{
+	// The portal houses are persistent groups, since the neighbouring scenes hold on to them.
+	if (!village)
+	{
+		village = new SceneGroup(this);
+		root->add_child(village);
+		out_house = new SceneTransAnim(this, glm::vec3(0.f), glm::vec3(0.f, -0.5f, 0.f), false);
+		root->add_child(out_house);
+		in_house = new SceneGroup(this);
+		root->add_child(in_house);
+	}
+	else {
+		village->remove_all();
+		out_house->remove_all();
+		in_house->remove_all();
 	}
+
+	glm::vec3 out_location = glm::vec3(buildings.front()->transformation[3]);
+	out_house->add_child(buildings.front());
+	out_height = out_location.y;
+	out_point = glm::vec2(out_location.x, out_location.z);
+
+	glm::vec3 in_location = glm::vec3(buildings.back()->transformation[3]);
+	in_house->add_child(buildings.back());
+	in_height = in_location.y;
+	in_area[0] = glm::vec2(in_location.x - Global::TRIGGER_HALF_LEN, in_location.z + Global::TRIGGER_HALF_LEN);
+	in_area[1] = glm::vec2(in_location.x + Global::TRIGGER_HALF_LEN, in_location.z - Global::TRIGGER_HALF_LEN);
+	in_point = glm::vec2(in_location.x, in_location.z);
+
+	for (size_t i = 1; i + 1 < buildings.size(); ++i)
+		village->add_child(buildings[i]);
+}
+
+void IslandScene::generate_village()
+{
+	std::cerr << "Generating Village...";
+	std::vector<Random> building_rngs;
+	for (int i = 0; i < NUM_BUILDINGS; ++i)
+		building_rngs.push_back(rng.fork());
+	place_village(build_village(height_map, building_rngs));
 	std::cerr << "OK." << std::endl;
 }
 
+void IslandScene::add_village_task()
+{
+	// One building per step.
+	std::vector<Random> building_rngs;
+	for (int i = 0; i < NUM_BUILDINGS; ++i)
+		building_rngs.push_back(rng.fork());
+	std::vector<SceneTransform *> buildings;
+	FrameTasks::add([=]() mutable {
+		buildings.push_back(build_building(height_map, (int) buildings.size(), building_rngs[buildings.size()]));
+		if ((GLint) buildings.size() < NUM_BUILDINGS)
+			return false;
+		place_village(buildings);
+		return true;
+	});
+}
+
+void IslandScene::regenerate_village()
+{
+	std::vector<Random> building_rngs;
+	for (int i = 0; i < NUM_BUILDINGS; ++i)
+		building_rngs.push_back(rng.fork());
+	std::shared_ptr<std::vector<SceneTransform *>> buildings = std::make_shared<std::vector<SceneTransform *>>();
+	regenerate([=]() {
+		*buildings = build_village(height_map, building_rngs);
+	}, [=]() {
+		place_village(*buildings);
+	});
+}
+
 void IslandScene::generate_miniatures()
 {
 	std::cerr << "Generating Miniatures...";
+	add_small_map();
+	add_small_forest();
+	add_small_village();
+	std::cerr << "OK." << std::endl;
+}
 
-	glm::vec3 pivot_pt(0.f, HEIGHT_MAP_MAX - 2.f, -8.f);
-	float building_positions[NUM_BUILDINGS]; // positions starting from rightmost
-	for (int i = 0; i < NUM_BUILDINGS; ++i)
-		building_positions[i] = glm::radians((i - (NUM_BUILDINGS / 2)) * (360.f / NUM_BUILDINGS));
+void IslandScene::add_miniatures_task()
+{
+	// One miniature per step.
+	int part = 0;
+	FrameTasks::add([=]() mutable {
+		switch (part++)
+		{
+		case 0:
+			add_small_map();
+			break;
+		case 1:
+			add_small_forest();
+			break;
+		default:
+			add_small_village();
+			break;
+		}
+		return part == 3;
+	});
+}
 
+glm::vec3 IslandScene::miniature_position(int slot)
+{
+	// Miniatures stand where the buildings would in a circle, counting from the rightmost.
+	float angle = glm::radians((slot - (NUM_BUILDINGS / 2)) * (360.f / NUM_BUILDINGS));
+	return glm::vec3(-8.f * glm::sin(angle), HEIGHT_MAP_MAX - 2.f, -8.f * glm::cos(angle));
+}
+
+void IslandScene::add_small_map()
+{
 	// Small terrain
 	generate_small_map();
 	SceneTransform *small_map_scale = new SceneTransform(this, glm::scale(glm::mat4(1.f), glm::vec3(SMALL_MAP_SCALE, SMALL_MAP_SCALE / 10.f, SMALL_MAP_SCALE)));
 	SceneAnimation *small_map_anim = new SceneAnimation(this, 0.f, FLT_MAX, 0.f, SMALL_ROT_SPEED, glm::vec3(0.f, 1.f, 0.f), glm::vec3(0.f, 0.f, 0.f));
-	SceneTransform *small_map_translate = new SceneTransform(this, glm::translate(glm::mat4(1.f), glm::vec3(-8.f * glm::sin(building_positions[1]), HEIGHT_MAP_MAX - 2.f, -8.f * glm::cos(building_positions[1]))));
-	small_map_scale->add_child(small_map_model);
+	SceneTransform *small_map_translate = new SceneTransform(this, glm::translate(glm::mat4(1.f), miniature_position(1)));
+	small_map_scale->add_child(small_map);
 	small_map_anim->add_child(small_map_scale);
 	small_map_translate->add_child(small_map_anim);
 	root->add_child(small_map_translate);
 	BoundingSphere *small_map_bounds = new BoundingSphere(small_map_translate, TERRAIN_SIZE * SMALL_MAP_SCALE * 0.5f, GRAB);
 	interactable_objects.push_back(small_map_bounds);
+}
 
+void IslandScene::add_small_forest()
+{
 	// Small trees
 	generate_small_forest();
-	glm::mat4 small_forest_translate = glm::translate(glm::mat4(1.f), glm::vec3(-8.f * glm::sin(building_positions[2]), HEIGHT_MAP_MAX - 2.f, -8.f * glm::cos(building_positions[2])));
+	glm::mat4 small_forest_translate = glm::translate(glm::mat4(1.f), miniature_position(2));
 	for (SceneNode *small_tree : small_forest->children)
 	{
 		((SceneTransform *)small_tree)->transformation = small_forest_translate * ((SceneTransform *)small_tree)->transformation;
@@ -317,10 +475,13 @@ void IslandScene::generate_miniatures()
 		interactable_objects.push_back(small_tree_bounds);
 	}
 	root->add_child(small_forest);
+}
 
+void IslandScene::add_small_village()
+{
 	// Small village
 	generate_small_village();
-	glm::mat4 small_village_translate = glm::translate(glm::mat4(1.f), glm::vec3(-8.f * glm::sin(building_positions[3]), HEIGHT_MAP_MAX - 2.f, -8.f * glm::cos(building_positions[3])));
+	glm::mat4 small_village_translate = glm::translate(glm::mat4(1.f), miniature_position(3));
 	for (SceneNode *small_building : small_village->children)
 	{
 		((SceneTransform *)small_building)->transformation = small_village_translate * ((SceneTransform *)small_building)->transformation;
@@ -328,35 +489,20 @@ void IslandScene::generate_miniatures()
 		interactable_objects.push_back(small_building_bounds);
 	}
 	root->add_child(small_village);
+}
 
-	std::cerr << "OK." << std::endl;
+void IslandScene::place_small_map(SceneTerrain *small_terrain)
+{
+	if (!small_map)
+		small_map = new SceneGroup(this);
+	else
+		small_map->remove_all();
+	small_map->add_child(small_terrain);
 }
 
 void IslandScene::generate_small_map()
 {
-	if (!small_map_model)
-		small_map_model = new SceneModel(this);
-	else
-		small_map_model->meshes.clear();
-
-	Material small_land_material;
-	small_land_material.diffuse = small_land_material.ambient = color::windwaker_green;
-	small_land_material.shadows = false;
-	Mesh small_land_mesh = { land_geo, small_land_material, ShaderManager::get_default(), glm::mat4(1.f) };
-	small_land_mesh.no_culling = true;
-	Material small_plateau_material;
-	small_plateau_material.diffuse = small_plateau_material.ambient = color::bone_white;
-	small_plateau_material.shadows = false;
-	Mesh small_plateau_mesh = { plateau_geo, small_plateau_material, ShaderManager::get_default(), glm::mat4(1.f) };
-	small_plateau_mesh.no_culling = true;
-	Material small_sand_material;
-	small_sand_material.diffuse = small_sand_material.ambient = color::windwaker_sand;
-	small_sand_material.shadows = false;
-	Mesh small_sand_mesh = { sand_geo, small_sand_material, ShaderManager::get_default(), glm::mat4(1.f) };
-	small_sand_mesh.no_culling = true;
-	small_map_model->add_mesh(small_land_mesh);
-	small_map_model->add_mesh(small_sand_mesh);
-	small_map_model->add_mesh(small_plateau_mesh);
+	place_small_map(build_terrain(height_map, true));
 }
 
 void IslandScene::generate_small_forest()
@@ -366,18 +512,20 @@ void IslandScene::generate_small_forest()
 	else
 		small_forest->remove_all();
 
-	float seed = Util::random(0, 1000.f);
+	// Every tree gets a copy of the same stream, so they grow alike and only differ in depth.
+	Random small_rng = rng.fork();
+	Random tree_rng = small_rng.fork();
 
 	Material branch_material, leaf_material;
 	glm::vec3 leaf_colors[] = { color::olive_green, color::olive_green, color::olive_green, color::autumn_orange, color::purple, color::bone_white, color::indian_red };
 	glm::vec3 branch_colors[] = { color::brown, color::wood_saddle, color::wood_sienna, color::wood_tan, color::wood_tan_light };
-	leaf_material.diffuse = leaf_material.ambient = leaf_colors[(int)Util::random(0, 7)];
-	branch_material.diffuse = branch_material.ambient = branch_colors[(int)Util::random(0, 5)];
+	leaf_material.diffuse = leaf_material.ambient = leaf_colors[(int)small_rng.random(0, 7)];
+	branch_material.diffuse = branch_material.ambient = branch_colors[(int)small_rng.random(0, 5)];
 	branch_material.shadows = false;
 	leaf_material.shadows = false;
 	for (int i = 0; i < NUM_SMALL_TREES; ++i)
 	{
-		SceneGroup *small_tree = Tree::generate_tree(this, cylinder_geo, diamond_geo, 2 + i, 0, 20.f, 2.f, branch_material, leaf_material, false, glm::vec3(0.f), (int) seed);
+		SceneGroup *small_tree = Tree::generate_tree(this, cylinder_geo, diamond_geo, 2 + i, 0, 20.f, 2.f, branch_material, leaf_material, false, glm::vec3(0.f), tree_rng);
 		SceneTransform *small_tree_scale = new SceneTransform(this, glm::scale(glm::mat4(1.f), glm::vec3(SMALL_TREE_SCALE)));
 		SceneAnimation *small_tree_anim = new SceneAnimation(this, 0.f, FLT_MAX, 0.f, SMALL_ROT_SPEED, glm::vec3(0.f, 1.f, 0.f), glm::vec3(0.f, 0.f, 0.f));
 		// Display in a half-circle arc.
@@ -400,7 +548,7 @@ void IslandScene::generate_small_village()
 
 	for (int i = 0; i < NUM_SMALL_BUILDINGS; ++i)
 	{
-		SceneModel *building = ShapeGrammar::generate_building(this, false, 0);
+		SceneModel *building = ShapeGrammar::generate_building(this, false, rng.fork());
 		SceneTransform *small_building_scale = new SceneTransform(this, glm::scale(glm::mat4(1.f), glm::vec3(SMALL_BUILDING_SCALE)));		
 		float angle = glm::radians(360.f / NUM_SMALL_BUILDINGS * i);
 		SceneTransform *small_building_rot = new SceneTransform(this, glm::rotate(glm::mat4(1.f), glm::radians(-90.f + glm::degrees(angle)), glm::vec3(0.f, 1.f, 0.f)));
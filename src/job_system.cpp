@@ -0,0 +1,289 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+typedef std::chrono::steady_clock Clock;
+
+// How long the main thread sleeps in wait() before looking for new work in the awaited tree.
+const std::chrono::milliseconds MAIN_WAIT_POLL(1);
+
+// One per thread. The owner pushes and pops at the back and thieves take from the front;
+// jobs are coarse enough that a plain lock per queue is not the bottleneck.
+struct WorkQueue
+{
+	std::mutex mutex;
+	std::deque<Job *> jobs;
+	std::atomic<unsigned int> jobs_run;
+	std::atomic<unsigned int> jobs_stolen;
+	std::atomic<long long> busy_ns;
+};
+
+std::vector<std::unique_ptr<WorkQueue>> queues;
+std::vector<std::thread> workers;
+std::atomic<bool> running(false);
+// Jobs sitting in any queue, so idle workers know when to sleep.
+std::atomic<int> queued(0);
+std::mutex sleep_mutex;
+std::condition_variable wake;
+// Signalled under sleep_mutex whenever a job without a parent finishes.
+std::condition_variable root_done;
+Clock::time_point stats_start;
+
+// Index of the queue the current thread owns; the main thread and any thread the
+// system did not start use queue 0.
+thread_local unsigned int thread_index = 0;
+// Jobs that wait run others inside their own execute(); only the outermost one is timed.
+thread_local unsigned int nesting = 0;
+
+void JobSystem::init(unsigned int num_workers)
+{
+	if (num_workers == 0)
+		num_workers = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+
+	queues.clear();
+	for (unsigned int i = 0; i <= num_workers; ++i)
+	{
+		queues.emplace_back(new WorkQueue());
+		queues.back()->jobs_run = 0;
+		queues.back()->jobs_stolen = 0;
+		queues.back()->busy_ns = 0;
+	}
+	stats_start = Clock::now();
+
+	running = true;
+	for (unsigned int i = 1; i <= num_workers; ++i)
+		workers.push_back(std::thread(worker_loop, i));
+}
+
+void JobSystem::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		running = false;
+	}
+	wake.notify_all();
+	for (std::thread &worker : workers)
+		worker.join();
+	workers.clear();
+	queues.clear();
+}
+
+unsigned int JobSystem::num_threads()
+{
+	return std::max((unsigned int) queues.size(), 1u);
+}
+
+Job *JobSystem::create(std::function<void()> work, Job *parent)
+{
+	Job *job = new Job();
+	job->work = std::move(work);
+	job->parent = parent;
+	job->unfinished = 1;
+	if (parent)
+		parent->unfinished++;
+	return job;
+}
+
+void JobSystem::run(Job *job)
+{
+	// Without init() there is nobody to hand the job to.
+	if (queues.empty())
+	{
+		if (job->work)
+			job->work();
+		finish(job);
+		return;
+	}
+
+	WorkQueue &queue = *queues[thread_index];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(job);
+	}
+	queued++;
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	wake.notify_one();
+}
+
+void JobSystem::wait(Job *job)
+{
+	// Workers help with anything. The main thread only helps with the job's own tree, so
+	// a frame never picks up another scene's construction, and otherwise sleeps.
+	bool main_thread = thread_index == 0 && queues.size() > 1;
+	while (job->unfinished > 0)
+	{
+		Job *other = queues.empty() ? nullptr : next_job(thread_index, main_thread ? job : nullptr);
+		if (other)
+			execute(other, thread_index);
+		else if (main_thread)
+		{
+			std::unique_lock<std::mutex> lock(sleep_mutex);
+			root_done.wait_for(lock, MAIN_WAIT_POLL, [job]() { return job->unfinished == 0; });
+		}
+		else
+			std::this_thread::yield();
+	}
+	delete job;
+}
+
+bool JobSystem::is_done(Job *job)
+{
+	return job->unfinished == 0;
+}
+
+void JobSystem::parallel_for(unsigned int count, unsigned int grain, const std::function<void(unsigned int, unsigned int)> &body)
+{
+	grain = std::max(grain, 1u);
+	if (count <= grain || num_threads() == 1)
+	{
+		if (count)
+			body(0, count);
+		return;
+	}
+
+	Job *root = create(nullptr);
+	for (unsigned int begin = 0; begin < count; begin += grain)
+	{
+		unsigned int end = std::min(begin + grain, count);
+		run(create([&body, begin, end]() { body(begin, end); }, root));
+	}
+	run(root);
+	wait(root);
+}
+
+void JobSystem::worker_loop(unsigned int index)
+{
+	thread_index = index;
+	while (running)
+	{
+		Job *job = next_job(index);
+		if (job)
+		{
+			execute(job, index);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wake.wait(lock, []() { return queued > 0 || !running; });
+	}
+}
+
+bool JobSystem::in_tree(const Job *job, const Job *root)
+{
+	// A queued job keeps all its ancestors unfinished, so none of them can have been freed.
+	for (; job; job = job->parent)
+	{
+		if (job == root)
+			return true;
+	}
+	return false;
+}
+
+Job *JobSystem::next_job(unsigned int index, const Job *root)
+{
+	// Own work first, newest first, while it is still in cache.
+	{
+		WorkQueue &queue = *queues[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		for (auto it = queue.jobs.rbegin(); it != queue.jobs.rend(); ++it)
+		{
+			if (root && !in_tree(*it, root))
+				continue;
+			Job *job = *it;
+			queue.jobs.erase(std::next(it).base());
+			queued--;
+			return job;
+		}
+	}
+
+	// Then the oldest job of someone else, which tends to be the biggest piece left.
+	unsigned int count = (unsigned int) queues.size();
+	for (unsigned int i = 1; i < count; ++i)
+	{
+		WorkQueue &victim = *queues[(index + i) % count];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		for (auto it = victim.jobs.begin(); it != victim.jobs.end(); ++it)
+		{
+			if (root && !in_tree(*it, root))
+				continue;
+			Job *job = *it;
+			victim.jobs.erase(it);
+			queued--;
+			queues[index]->jobs_stolen++;
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+void JobSystem::execute(Job *job, unsigned int index)
+{
+	Clock::time_point start = Clock::now();
+	nesting++;
+	if (job->work)
+		job->work();
+	nesting--;
+	WorkQueue &queue = *queues[index];
+	if (nesting == 0)
+		queue.busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+	queue.jobs_run++;
+	finish(job);
+}
+
+void JobSystem::finish(Job *job)
+{
+	// Read before the count drops; a finished root may be freed by its waiter right away.
+	Job *parent = job->parent;
+	if (--job->unfinished > 0)
+		return;
+	if (parent)
+	{
+		delete job;
+		finish(parent);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	root_done.notify_all();
+}
+
+void JobSystem::reset_stats()
+{
+	for (std::unique_ptr<WorkQueue> &queue : queues)
+	{
+		queue->jobs_run = 0;
+		queue->jobs_stolen = 0;
+		queue->busy_ns = 0;
+	}
+	stats_start = Clock::now();
+}
+
+std::vector<WorkerStats> JobSystem::stats()
+{
+	double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - stats_start).count();
+	std::vector<WorkerStats> result;
+	for (std::unique_ptr<WorkQueue> &queue : queues)
+	{
+		WorkerStats s = { queue->jobs_run, queue->jobs_stolen, elapsed > 0.0 ? queue->busy_ns / elapsed : 0.0 };
+		result.push_back(s);
+	}
+	return result;
+}
+
+void JobSystem::print_stats()
+{
+	std::vector<WorkerStats> all = stats();
+	std::cerr << "Jobs on " << all.size() << " threads:";
+	for (unsigned int i = 0; i < all.size(); ++i)
+		std::cerr << " [" << i << "] " << all[i].jobs_run << " run, " << all[i].jobs_stolen << " stolen, " << (int) (all[i].utilization * 100.0) << "% busy;";
+	std::cerr << std::endl;
+}
@@ -1,7 +1,31 @@
 #include "greed.h"
+#include "asset_pack.h"
+#include "geometry_generator.h"
+#include "skybox_shader.h"
+#include "determinism_check.h"
 
-int main()
+#include <cstring>
+
+int main(int argc, char *argv[])
 {
+	// Packs every texture and skybox the game loads into the asset pack, then exits.
+	if (argc > 1 && strcmp(argv[1], "--bake-assets") == 0)
+	{
+		std::vector<std::string> textures, cubemaps;
+		for (int type = NONE; type <= STONE; ++type)
+		{
+			if (GeometryGenerator::texture_path(type))
+				textures.push_back(GeometryGenerator::texture_path(type));
+		}
+		for (int i = 0; i < NUM_SKYBOXES; ++i)
+			cubemaps.push_back(SkyboxShader::cubemap_dir(i));
+		exit(AssetPack::bake(ASSET_PACK_PATH, textures, cubemaps) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// Generates the same content serially and on the job system, and fails if they differ.
+	if (argc > 1 && strcmp(argv[1], "--verify-determinism") == 0)
+		exit(DeterminismCheck::run() ? EXIT_SUCCESS : EXIT_FAILURE);
+
 	Greed island;
 	island.go();
 	exit(EXIT_SUCCESS);
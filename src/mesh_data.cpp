@@ -0,0 +1,46 @@
+#include "mesh_data.h"
+#include "procedural_cache.h"
+
+void MeshData::attach_texture(const char *texture_loc)
+{
+	has_texture = true;
+	texture_path = texture_loc;
+}
+
+void MeshData::compute_bounds()
+{
+	// Local bounds for culling.
+	bounds.reset();
+	for (glm::vec3 v : vertices)
+		bounds.expand(v);
+}
+
+void MeshData::write(CacheWriter &writer) const
+{
+	writer.write(has_texture);
+	writer.write(has_normals);
+	writer.write(add_texture_noise);
+	writer.write(draw_type);
+	writer.write(wrap_type);
+	writer.write(filter_type);
+	writer.write_vector(vertices);
+	writer.write_vector(normals);
+	writer.write_vector(tex_coords);
+	writer.write_vector(indices);
+}
+
+bool MeshData::read(CacheReader &reader)
+{
+	reader.read(has_texture);
+	reader.read(has_normals);
+	reader.read(add_texture_noise);
+	reader.read(draw_type);
+	reader.read(wrap_type);
+	reader.read(filter_type);
+	reader.read_vector(vertices);
+	reader.read_vector(normals);
+	reader.read_vector(tex_coords);
+	reader.read_vector(indices);
+	texture_path = nullptr;
+	return reader.ok;
+}
@@ -0,0 +1,111 @@
+#include "multi_draw.h"
+#include "gl_state.h"
+
+#include <algorithm>
+
+// Layout of glMultiDrawElementsIndirect commands.
+struct DrawCommand
+{
+	GLuint count;
+	GLuint instance_count;
+	GLuint first_index;
+	GLint base_vertex;
+	GLuint base_instance;
+};
+
+// Per-draw data: the model matrix as three rows, then the normal matrix as three.
+const GLuint TEXELS_PER_DRAW = 6;
+
+GLuint MultiDraw::draws_merged = 0;
+GLuint MultiDraw::calls_made = 0;
+
+MultiDraw::~MultiDraw()
+{
+	if (!command_buffer)
+		return;
+	GLuint buffers[] = { command_buffer, data_buffer };
+	glDeleteBuffers(2, buffers);
+	glDeleteTextures(1, &data_texture);
+}
+
+bool MultiDraw::supported()
+{
+	return GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance;
+}
+
+void MultiDraw::reset_stats()
+{
+	draws_merged = 0;
+	calls_made = 0;
+}
+
+void MultiDraw::add(Geometry *g, const glm::mat4 &model)
+{
+	draws.push_back({ g, model });
+}
+
+void MultiDraw::submit()
+{
+	if (draws.empty())
+		return;
+	if (!command_buffer)
+	{
+		glGenBuffers(1, &command_buffer);
+		glGenBuffers(1, &data_buffer);
+		glGenTextures(1, &data_texture);
+		// The texture keeps pointing at the buffer however often its storage is replaced.
+		GLState::bind_texture(DRAWS_TEXTURE_UNIT, GL_TEXTURE_BUFFER, data_texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, data_buffer);
+	}
+
+	// Each call covers one arena, so one vertex format and index type, and one primitive type.
+	std::stable_sort(draws.begin(), draws.end(), [](const Draw &a, const Draw &b) {
+		if (a.geometry->arena != b.geometry->arena)
+			return a.geometry->arena < b.geometry->arena;
+		return a.geometry->draw_type < b.geometry->draw_type;
+	});
+
+	for (size_t start = 0; start < draws.size(); start += MAX_MULTI_DRAWS)
+	{
+		size_t count = std::min(draws.size() - start, (size_t) MAX_MULTI_DRAWS);
+		std::vector<glm::vec4> data(count * TEXELS_PER_DRAW);
+		std::vector<DrawCommand> commands(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const Draw &draw = draws[start + i];
+			glm::mat4 rows = glm::transpose(draw.model);
+			glm::mat3 normal_rows = glm::inverse(glm::mat3(draw.model));
+			for (int r = 0; r < 3; ++r)
+			{
+				data[i * TEXELS_PER_DRAW + r] = rows[r];
+				data[i * TEXELS_PER_DRAW + 3 + r] = glm::vec4(normal_rows[r], 0.f);
+			}
+			const ArenaRange &range = draw.geometry->range;
+			commands[i] = { range.num_indices, 1, range.first_index, (GLint) range.first_vertex, (GLuint) i };
+		}
+
+		// Orphaned every time, so the driver never waits on the previous batch.
+		glBindBuffer(GL_TEXTURE_BUFFER, data_buffer);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4) * data.size(), data.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		GLState::bind_texture(DRAWS_TEXTURE_UNIT, GL_TEXTURE_BUFFER, data_texture);
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawCommand) * commands.size(), commands.data(), GL_STREAM_DRAW);
+		size_t run = 0;
+		while (run < count)
+		{
+			Geometry *g = draws[start + run].geometry;
+			size_t end = run + 1;
+			while (end < count && draws[start + end].geometry->arena == g->arena && draws[start + end].geometry->draw_type == g->draw_type)
+				end++;
+			g->bind();
+			glMultiDrawElementsIndirect(g->draw_type, g->arena->index_type, (GLvoid *) (sizeof(DrawCommand) * run), (GLsizei) (end - run), 0);
+			calls_made++;
+			run = end;
+		}
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+	draws_merged += (GLuint) draws.size();
+	draws.clear();
+}
@@ -0,0 +1,283 @@
+#include "procedural_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <utime.h>
+#endif
+
+const uint64_t FNV_OFFSET = 14695981039346656037ull;
+const uint64_t FNV_PRIME = 1099511628211ull;
+const char CACHE_MAGIC[4] = { 'G', 'P', 'C', 'E' };
+// Regenerating makes new entries every time, so the directory would otherwise only grow.
+const uint64_t CACHE_SIZE_LIMIT = 256ull << 20;
+
+// Precedes every payload; entries whose header does not match are ignored.
+struct CacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint64_t size;
+};
+
+std::string cache_directory;
+bool cache_enabled = false;
+std::atomic<unsigned int> cache_hits(0);
+std::atomic<unsigned int> cache_misses(0);
+std::atomic<unsigned int> cache_temp_files(0);
+unsigned int cache_pruned = 0;
+
+struct CacheFile
+{
+	std::string path;
+	uint64_t size;
+	time_t modified;
+};
+
+CacheKey::CacheKey(const char *generator)
+{
+	hash = FNV_OFFSET;
+	add(generator, strlen(generator));
+	*this << PROCEDURAL_CACHE_VERSION;
+}
+
+CacheKey &CacheKey::add(const void *data, size_t size)
+{
+	const unsigned char *p = (const unsigned char *) data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= p[i];
+		hash *= FNV_PRIME;
+	}
+	return *this;
+}
+
+void CacheWriter::write(const void *data, size_t size)
+{
+	const unsigned char *p = (const unsigned char *) data;
+	bytes.insert(bytes.end(), p, p + size);
+}
+
+CacheReader::CacheReader()
+{
+	cursor = end = nullptr;
+	ok = false;
+}
+
+CacheReader::CacheReader(const unsigned char *data, size_t size)
+{
+	cursor = data;
+	end = data + size;
+	ok = true;
+}
+
+bool CacheReader::read(void *out, size_t size)
+{
+	if (!ok || size > (size_t) (end - cursor))
+		return ok = false;
+	memcpy(out, cursor, size);
+	cursor += size;
+	return true;
+}
+
+std::string entry_path(const CacheKey &key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) key.value());
+	return cache_directory + "/" + name;
+}
+
+// Regular files directly in directory.
+std::vector<CacheFile> list_files(const std::string &directory)
+{
+	std::vector<CacheFile> files;
+#ifdef _WIN32
+	struct _finddata_t data;
+	intptr_t handle = _findfirst((directory + "/*").c_str(), &data);
+	if (handle == -1)
+		return files;
+	do
+	{
+		if (!(data.attrib & _A_SUBDIR))
+			files.push_back({ directory + "/" + data.name, (uint64_t) data.size, data.time_write });
+	} while (_findnext(handle, &data) == 0);
+	_findclose(handle);
+#else
+	DIR *dir = opendir(directory.c_str());
+	if (!dir)
+		return files;
+	while (dirent *entry = readdir(dir))
+	{
+		std::string path = directory + "/" + entry->d_name;
+		struct stat info;
+		if (stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode))
+			files.push_back({ path, (uint64_t) info.st_size, info.st_mtime });
+	}
+	closedir(dir);
+#endif
+	return files;
+}
+
+bool ends_with(const std::string &s, const char *suffix)
+{
+	size_t length = strlen(suffix);
+	return s.size() >= length && s.compare(s.size() - length, length, suffix) == 0;
+}
+
+// Runs before any job can store, so every temporary file is left over from a crash.
+void prune_entries()
+{
+	std::vector<CacheFile> entries;
+	uint64_t total = 0;
+	for (const CacheFile &file : list_files(cache_directory))
+	{
+		if (file.path.find(".bin.tmp") != std::string::npos)
+			remove(file.path.c_str());
+		else if (ends_with(file.path, ".bin"))
+		{
+			entries.push_back(file);
+			total += file.size;
+		}
+	}
+
+	// Hits refresh an entry's time, so the oldest are the least recently used.
+	std::sort(entries.begin(), entries.end(), [](const CacheFile &a, const CacheFile &b) {
+		return a.modified < b.modified;
+	});
+	for (const CacheFile &entry : entries)
+	{
+		if (total <= CACHE_SIZE_LIMIT)
+			break;
+		if (remove(entry.path.c_str()) == 0)
+		{
+			total -= entry.size;
+			cache_pruned++;
+		}
+	}
+}
+
+void ProceduralCache::init(const std::string &directory)
+{
+	cache_directory = directory;
+#ifdef _WIN32
+	_mkdir(directory.c_str());
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+	cache_enabled = true;
+	prune_entries();
+}
+
+unsigned int ProceduralCache::world_seed()
+{
+	if (!cache_enabled)
+		return 0;
+
+	std::string path = cache_directory + "/seed";
+	unsigned int seed = 0;
+	FILE *in = fopen(path.c_str(), "r");
+	if (in)
+	{
+		if (fscanf(in, "%u", &seed) != 1)
+			seed = 0;
+		fclose(in);
+	}
+	if (seed == 0)
+	{
+		seed = (unsigned int) time(NULL);
+		FILE *out = fopen(path.c_str(), "w");
+		if (out)
+		{
+			fprintf(out, "%u\n", seed);
+			fclose(out);
+		}
+	}
+	return seed;
+}
+
+bool ProceduralCache::load(const CacheKey &key, MappedFile &file, CacheReader &reader)
+{
+	if (!cache_enabled)
+		return false;
+
+	CacheHeader header;
+	if (!file.open(entry_path(key)) || file.size() < sizeof(header))
+	{
+		file.close();
+		cache_misses++;
+		return false;
+	}
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != PROCEDURAL_CACHE_VERSION
+		|| header.key != key.value() || header.size != file.size() - sizeof(header))
+	{
+		file.close();
+		cache_misses++;
+		return false;
+	}
+	reader = CacheReader(file.data() + sizeof(header), (size_t) header.size);
+	cache_hits++;
+	// Marks the entry as used for pruning; harmless if the platform refuses while it is mapped.
+#ifdef _WIN32
+	_utime(entry_path(key).c_str(), nullptr);
+#else
+	utime(entry_path(key).c_str(), nullptr);
+#endif
+	return true;
+}
+
+void ProceduralCache::store(const CacheKey &key, const CacheWriter &writer)
+{
+	if (!cache_enabled)
+		return;
+
+	CacheHeader header;
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = PROCEDURAL_CACHE_VERSION;
+	header.key = key.value();
+	header.size = writer.bytes.size();
+
+	// Written under a name of its own and renamed into place, so a reader never maps a
+	// half-written entry, even when two jobs store the same one.
+	std::string path = entry_path(key);
+	std::ostringstream temp;
+	temp << path << ".tmp" << cache_temp_files++;
+	FILE *out = fopen(temp.str().c_str(), "wb");
+	if (!out)
+		return;
+	bool written = fwrite(&header, sizeof(header), 1, out) == 1
+		&& (writer.bytes.empty() || fwrite(writer.bytes.data(), writer.bytes.size(), 1, out) == 1);
+	written = fclose(out) == 0 && written;
+	if (!written)
+	{
+		remove(temp.str().c_str());
+		return;
+	}
+#ifdef _WIN32
+	// Windows will not rename over an existing file.
+	remove(path.c_str());
+#endif
+	if (rename(temp.str().c_str(), path.c_str()) != 0)
+		remove(temp.str().c_str());
+}
+
+void ProceduralCache::print_stats()
+{
+	if (!cache_enabled)
+		return;
+	std::cerr << "Procedural cache: " << cache_hits << " hits, " << cache_misses << " misses, " << cache_pruned << " pruned" << std::endl;
+}
@@ -0,0 +1,56 @@
+#include "random.h"
+
+const uint64_t PCG_MULTIPLIER = 6364136223846793005ULL;
+
+Random::Random(uint64_t seed, uint64_t stream)
+{
+	origin = seed;
+	state = 0;
+	// The increment picks the sequence and has to be odd.
+	increment = (stream << 1) | 1;
+	next();
+	state += seed;
+	next();
+}
+
+uint64_t Random::mix(uint64_t v)
+{
+	// SplitMix64 finalizer, so neighbouring ids give unrelated seeds.
+	v += 0x9E3779B97F4A7C15ULL;
+	v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	v = (v ^ (v >> 27)) * 0x94D049BB133111EBULL;
+	return v ^ (v >> 31);
+}
+
+uint32_t Random::next()
+{
+	uint64_t old = state;
+	state = old * PCG_MULTIPLIER + increment;
+	uint32_t xorshifted = (uint32_t) (((old >> 18) ^ old) >> 27);
+	uint32_t rot = (uint32_t) (old >> 59);
+	return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+}
+
+float Random::random(float min, float max)
+{
+	// Top 24 bits, which a float holds exactly, so the result never rounds up to max.
+	float r = (float) (next() >> 8) / 16777216.f;
+	return min + r * (max - min);
+}
+
+uint32_t Random::below(uint32_t n)
+{
+	return (uint32_t) (((uint64_t) next() * n) >> 32);
+}
+
+Random Random::derive(uint64_t id) const
+{
+	return Random(mix(origin ^ mix(id)), id);
+}
+
+Random Random::fork()
+{
+	uint64_t id = next();
+	id = (id << 32) | next();
+	return derive(id);
+}
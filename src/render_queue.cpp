@@ -0,0 +1,139 @@
+#include "render_queue.h"
+#include "gl_state.h"
+#include "scene_node.h"
+
+#include <algorithm>
+#include <cstring>
+
+void RenderQueue::clear()
+{
+	packets.clear();
+}
+
+void RenderQueue::push(Shader *shader, Geometry *geometry, const Material &material, glm::mat4 to_world, glm::mat4 mesh_model, bool no_culling, GLfloat depth)
+{
+	GLuint pass = shader->background ? PASS_BACKGROUND : PASS_OPAQUE;
+	uint64_t geometry_id = (uint64_t) ((uintptr_t) geometry >> 4);
+	InstanceBatch no_batch = { 0, 0, 0, 0 };
+	DrawPacket packet = { make_key(pass, shader, material, geometry_id, depth), shader, geometry, no_batch, material, to_world, mesh_model, no_culling, nullptr };
+	packets.push_back(packet);
+}
+
+void RenderQueue::push_instanced(Shader *shader, Geometry *geometry, const InstanceBatch &batch, const Material &material, glm::mat4 to_world, bool no_culling, GLfloat depth)
+{
+	GLuint pass = shader->background ? PASS_BACKGROUND : PASS_OPAQUE;
+	DrawPacket packet = { make_key(pass, shader, material, batch.vao, depth), shader, geometry, batch, material, to_world, glm::mat4(1.f), no_culling, nullptr };
+	packets.push_back(packet);
+}
+
+void RenderQueue::push_custom(Shader *shader, SceneNode *owner, const Material &material, glm::mat4 to_world, bool no_culling, GLfloat depth)
+{
+	GLuint pass = shader->background ? PASS_BACKGROUND : PASS_OPAQUE;
+	uint64_t geometry_id = (uint64_t) ((uintptr_t) owner >> 4);
+	InstanceBatch no_batch = { 0, 0, 0, 0 };
+	DrawPacket packet = { make_key(pass, shader, material, geometry_id, depth), shader, nullptr, no_batch, material, to_world, glm::mat4(1.f), no_culling, owner };
+	packets.push_back(packet);
+}
+
+void RenderQueue::sort()
+{
+	// Stable so packets with equal keys keep traversal order.
+	std::stable_sort(packets.begin(), packets.end(), [](const DrawPacket &a, const DrawPacket &b) {
+		return a.key < b.key;
+	});
+}
+
+void RenderQueue::submit()
+{
+	program_switches = 0;
+	material_switches = 0;
+
+	Shader *curr_shader = nullptr;
+	const Material *curr_material = nullptr;
+	bool batch_no_culling = false;
+	GLState::cull_face(GL_BACK);
+
+	for (const DrawPacket &packet : packets)
+	{
+		bool batched = !packet.owner && !packet.batch.vao && packet.geometry && packet.shader->batchable(packet.geometry);
+		// The batch is drawn before anything it shares state with changes.
+		if (!batch.empty() && (!batched || packet.shader != curr_shader || !same_material(*curr_material, packet.material)
+			|| packet.no_culling != batch_no_culling || !same_texture(batch.first(), packet.geometry)))
+			curr_shader->draw_multi(batch);
+
+		if (packet.shader != curr_shader)
+		{
+			packet.shader->use();
+			curr_shader = packet.shader;
+			curr_material = nullptr;
+			program_switches++;
+		}
+		if (!curr_material || !same_material(*curr_material, packet.material))
+		{
+			packet.shader->set_material(packet.material);
+			curr_material = &packet.material;
+			material_switches++;
+		}
+		GLState::set_cull_face(!packet.no_culling);
+		if (batched)
+		{
+			batch.add(packet.geometry, packet.to_world * packet.mesh_model);
+			batch_no_culling = packet.no_culling;
+			continue;
+		}
+		if (packet.owner)
+		{
+			packet.owner->submit(packet.shader, packet.to_world);
+			continue;
+		}
+		if (packet.batch.vao)
+		{
+			packet.shader->draw_instanced(packet.geometry, packet.batch, packet.to_world);
+			continue;
+		}
+		packet.shader->send_mesh_model(packet.mesh_model);
+		packet.shader->draw(packet.geometry, packet.to_world);
+	}
+	if (!batch.empty())
+		curr_shader->draw_multi(batch);
+
+	GLState::set_cull_face(true);
+}
+
+uint64_t RenderQueue::make_key(GLuint pass, Shader *shader, const Material &material, uint64_t geometry_id, GLfloat depth)
+{
+	// Material values are hashed; a collision only costs a redundant set_material.
+	uint32_t material_hash = 2166136261u;
+	const GLfloat fields[] = {
+		material.ambient.x, material.ambient.y, material.ambient.z,
+		material.diffuse.x, material.diffuse.y, material.diffuse.z,
+		material.specular.x, material.specular.y, material.specular.z,
+		material.shininess, material.shadows ? 1.f : 0.f
+	};
+	const unsigned char *bytes = (const unsigned char *) fields;
+	for (size_t i = 0; i < sizeof(fields); ++i)
+		material_hash = (material_hash ^ bytes[i]) * 16777619u;
+	material_hash ^= material_hash >> 12;
+
+	// Non-negative floats sort like their bit patterns, so the top bits give a front-to-back order.
+	uint32_t depth_bits;
+	depth = std::max(depth, 0.f);
+	std::memcpy(&depth_bits, &depth, sizeof(depth_bits));
+
+	return ((uint64_t) (pass & 0x3) << 62)
+		| ((uint64_t) (shader->shader_id & 0x3FF) << 52)
+		| ((uint64_t) (material_hash & 0xFFF) << 40)
+		| ((geometry_id & 0xFFFF) << 24)
+		| (uint64_t) (depth_bits >> 8);
+}
+
+bool RenderQueue::same_material(const Material &a, const Material &b)
+{
+	return a.ambient == b.ambient && a.diffuse == b.diffuse && a.specular == b.specular
+		&& a.shininess == b.shininess && a.shadows == b.shadows;
+}
+
+bool RenderQueue::same_texture(const Geometry *a, const Geometry *b)
+{
+	return a->has_texture == b->has_texture && (!a->has_texture || a->texture == b->texture);
+}
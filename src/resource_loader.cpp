@@ -0,0 +1,192 @@
+#include "resource_loader.h"
+#include "job_system.h"
+
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// How long flush() blocks on a fence before checking it again.
+const GLuint64 FENCE_TIMEOUT = 1000000000;
+
+struct LoaderTask
+{
+	std::function<void(GLuint)> upload;
+	std::function<void()> ready;
+};
+
+struct PendingTask
+{
+	GLsync fence;
+	std::function<void()> ready;
+};
+
+GLFWwindow *loader_window = nullptr;
+std::thread loader_thread;
+std::mutex loader_mutex;
+std::condition_variable loader_wake;
+std::condition_variable loader_idle;
+std::deque<LoaderTask> loader_tasks;
+std::vector<PendingTask> pending_tasks;
+bool loader_busy = false;
+bool loader_stopping = false;
+
+bool ResourceLoader::init(GLFWwindow *main_window)
+{
+	if (!GLEW_ARB_sync)
+		return false;
+
+	// GLFW only creates windows on the main thread; the loader just borrows the context.
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	loader_window = glfwCreateWindow(1, 1, "Loader", nullptr, main_window);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+	if (!loader_window)
+	{
+		std::cerr << "Could not create a shared context, loading on the main thread." << std::endl;
+		return false;
+	}
+	loader_stopping = false;
+	loader_thread = std::thread(loader_loop);
+	return true;
+}
+
+void ResourceLoader::shutdown()
+{
+	if (!running())
+		return;
+	flush();
+	{
+		std::lock_guard<std::mutex> lock(loader_mutex);
+		loader_stopping = true;
+	}
+	loader_wake.notify_all();
+	loader_thread.join();
+	glfwDestroyWindow(loader_window);
+	loader_window = nullptr;
+}
+
+bool ResourceLoader::running()
+{
+	return loader_window != nullptr;
+}
+
+void ResourceLoader::loader_loop()
+{
+	glfwMakeContextCurrent(loader_window);
+	GLuint unpack_buffer;
+	glGenBuffers(1, &unpack_buffer);
+
+	std::unique_lock<std::mutex> lock(loader_mutex);
+	while (true)
+	{
+		loader_wake.wait(lock, []() { return loader_stopping || !loader_tasks.empty(); });
+		if (loader_tasks.empty())
+			break;
+		LoaderTask task = std::move(loader_tasks.front());
+		loader_tasks.pop_front();
+		loader_busy = true;
+		lock.unlock();
+
+		task.upload(unpack_buffer);
+		GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		// The main thread can only see the fence signal once it has been submitted.
+		glFlush();
+
+		lock.lock();
+		pending_tasks.push_back({ fence, std::move(task.ready) });
+		loader_busy = false;
+		if (loader_tasks.empty())
+			loader_idle.notify_all();
+	}
+
+	glDeleteBuffers(1, &unpack_buffer);
+	glfwMakeContextCurrent(nullptr);
+}
+
+void ResourceLoader::submit(std::function<void(GLuint)> upload, std::function<void()> ready)
+{
+	{
+		std::lock_guard<std::mutex> lock(loader_mutex);
+		loader_tasks.push_back({ std::move(upload), std::move(ready) });
+	}
+	loader_wake.notify_one();
+}
+
+void ResourceLoader::finish(bool wait)
+{
+	std::vector<PendingTask> tasks;
+	{
+		std::lock_guard<std::mutex> lock(loader_mutex);
+		tasks.swap(pending_tasks);
+	}
+
+	std::vector<PendingTask> unfinished;
+	for (PendingTask &task : tasks)
+	{
+		GLenum status = glClientWaitSync(task.fence, 0, 0);
+		while (wait && status == GL_TIMEOUT_EXPIRED)
+			status = glClientWaitSync(task.fence, 0, FENCE_TIMEOUT);
+		if (status == GL_TIMEOUT_EXPIRED)
+		{
+			unfinished.push_back(std::move(task));
+			continue;
+		}
+		glDeleteSync(task.fence);
+		task.ready();
+	}
+
+	std::lock_guard<std::mutex> lock(loader_mutex);
+	pending_tasks.insert(pending_tasks.begin(), unfinished.begin(), unfinished.end());
+}
+
+void ResourceLoader::process()
+{
+	if (running())
+		finish(false);
+}
+
+void ResourceLoader::flush()
+{
+	if (!running())
+		return;
+	{
+		std::unique_lock<std::mutex> lock(loader_mutex);
+		loader_idle.wait(lock, []() { return loader_tasks.empty() && !loader_busy; });
+	}
+	finish(true);
+}
+
+void upload_texture(GLuint texture, const TextureData &data, GLuint unpack_buffer)
+{
+	glBindTexture(data.target, texture);
+	data.upload(unpack_buffer);
+	glBindTexture(data.target, 0);
+}
+
+void ResourceLoader::load_texture(GLuint texture, std::function<void(TextureData &)> decode, std::function<void(size_t)> ready)
+{
+	std::shared_ptr<TextureData> data = std::make_shared<TextureData>();
+	if (JobSystem::num_threads() <= 1)
+	{
+		submit([texture, data, decode](GLuint unpack_buffer) {
+			decode(*data);
+			upload_texture(texture, *data, unpack_buffer);
+		}, [data, ready]() { ready(data->size()); });
+		return;
+	}
+
+	// The job submits the upload as its last act; it is waited on, and so freed, once ready.
+	std::shared_ptr<Job *> job = std::make_shared<Job *>(nullptr);
+	*job = JobSystem::create([texture, data, decode, ready, job]() {
+		decode(*data);
+		submit([texture, data](GLuint unpack_buffer) { upload_texture(texture, *data, unpack_buffer); },
+			[data, ready, job]() {
+				JobSystem::wait(*job);
+				ready(data->size());
+			});
+	});
+	JobSystem::run(*job);
+}
@@ -1,14 +1,24 @@
 #include "scene.h"
 #include "util.h"
 #include "terrain.h"
+#include "uniform_blocks.h"
+#include "job_system.h"
+#include "upload_queue.h"
 
 #include "global.h"
 const GLfloat PLAYER_HEIGHT = Global::PLAYER_HEIGHT;
 
+Scene *Scene::active;
+GLuint Scene::meshes_drawn;
+GLuint Scene::meshes_culled;
+GLuint Scene::terrain_triangles;
+RenderQueue Scene::queue;
+
 Scene::Scene()
 {
 	root = new SceneGroup(this);
 	camera = new SceneCamera(this);
+	rng = Util::stream();
 }
 
 Scene::~Scene()
@@ -19,7 +29,49 @@ Scene::~Scene()
 
 void Scene::render()
 {
+	// Planes are rebuilt per render so each VR eye culls against its own projection.
+	update_frustum_planes();
+	UniformBlocks::update_view(camera->V, P, camera->cam_pos);
+	active = this;
+	queue.clear();
 	root->draw(glm::mat4(1.f));
+	queue.sort();
+	queue.submit();
+}
+
+void Scene::update_bounds()
+{
+	// Cheap enough to refresh every frame, and the graph is edited from many places
+	// (regeneration, VR grabbing, animations), so there is no dirty tracking.
+	root->update_bounds();
+}
+
+bool Scene::in_frustum(const BoundingBox &b, glm::mat4 m)
+{
+	if (b.infinite)
+		return true;
+	if (b.empty)
+		return false;
+
+	BoundingBox world = b.transform(m);
+	glm::vec3 c = world.center();
+	glm::vec3 e = world.extent();
+	for (int i = 0; i < 6; i++)
+	{
+		// Normals point out of the frustum, so the box is outside if even its nearest corner is in front.
+		glm::vec3 n = frustum_planes[i].normal;
+		float r = e.x * glm::abs(n.x) + e.y * glm::abs(n.y) + e.z * glm::abs(n.z);
+		if (glm::dot(n, c) - r > frustum_planes[i].d)
+			return false;
+	}
+	return true;
+}
+
+void Scene::reset_cull_stats()
+{
+	meshes_drawn = 0;
+	meshes_culled = 0;
+	terrain_triangles = 0;
 }
 
 void Scene::pass(Shader * s)
@@ -176,4 +228,66 @@ glm::mat4 Scene::frustum_ortho()
 	}
 
 	return glm::ortho(min.x-FRINGE_X, max.x+FRINGE_X, min.y-FRINGE_Y, max.y+FRINGE_Y, -max.z-FRINGE_Z, -min.z+FRINGE_Z);
-}
\ No newline at end of file
+}
+
+bool Scene::regenerate(std::function<void()> build, std::function<void()> swap)
+{
+	if (regeneration)
+		return false;
+	regeneration = JobSystem::create([this, build]() {
+		UploadQueue::Batch batch(regeneration_uploads);
+		build();
+	});
+	regeneration_swap = swap;
+	JobSystem::run(regeneration);
+	return true;
+}
+
+void Scene::finish_regeneration()
+{
+	// Buildings and other geometry are queued during build; wait for them so nothing pops in,
+	// but not for whatever other scenes queued meanwhile.
+	if (!regeneration || !JobSystem::is_done(regeneration) || regeneration_uploads > 0)
+		return;
+	JobSystem::wait(regeneration);
+	regeneration = nullptr;
+	regeneration_swap();
+	regeneration_swap = nullptr;
+}
+
+void Scene::construct_async()
+{
+	if (construction || constructed)
+		return;
+	construction = JobSystem::create([this]() {
+		prepare();
+		setup();
+	});
+	JobSystem::run(construction);
+}
+
+void Scene::finish_construction()
+{
+	if (constructed)
+		return;
+	construct_async();
+	JobSystem::wait(construction);
+	construction = nullptr;
+	constructed = true;
+}
+
+void Scene::wait_for_jobs()
+{
+	if (construction)
+	{
+		JobSystem::wait(construction);
+		construction = nullptr;
+		constructed = true;
+	}
+	if (regeneration)
+	{
+		JobSystem::wait(regeneration);
+		regeneration = nullptr;
+		regeneration_swap = nullptr;
+	}
+}
@@ -1,6 +1,7 @@
 #include "scene_animation.h"
 #include <GLFW/glfw3.h>
 #include <cfloat>
+#include <cstring>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
@@ -11,6 +12,13 @@ SceneAnimation::SceneAnimation(Scene * scene, GLfloat min, GLfloat max, GLfloat
 {
 	this->scene = scene;
 	prev_time = glfwGetTime();
+
+	// Seeded from the pivot and axis so animations step out of sync, without touching the
+	// scene's stream from whichever thread builds the node.
+	uint32_t bits[6];
+	std::memcpy(bits, &axis[0], sizeof(GLfloat) * 3);
+	std::memcpy(bits + 3, &pivot[0], sizeof(GLfloat) * 3);
+	rng = Random(((uint64_t) (bits[0] ^ bits[1] ^ bits[2]) << 32) | (bits[3] ^ bits[4] ^ bits[5]));
 }
 
 SceneAnimation::SceneAnimation()
@@ -32,7 +40,7 @@ void SceneAnimation::draw(glm::mat4 m)
 	double curr_time = glfwGetTime();
 	if ((curr_time - prev_time) > 1.f / 60.f)
 	{
-		curr += Util::random(1, 2) * step;
+		curr += rng.random(1, 2) * step;
 		// reverse step when hitting min/max
 		if (curr >= max || curr <= min)
 			step = -step;
@@ -43,6 +51,36 @@ void SceneAnimation::draw(glm::mat4 m)
 	SceneGroup::draw(new_matrix);
 }
 
+void SceneAnimation::update_bounds()
+{
+	SceneGroup::update_bounds();
+	if (bounds.empty)
+		return;
+
+	// Points rotate about -pivot, so they never leave a sphere around it.
+	glm::vec3 center = -pivot;
+	GLfloat radius = 0.f;
+	for (int i = 0; i < 8; ++i)
+	{
+		glm::vec3 corner((i & 1) ? bounds.max_pt.x : bounds.min_pt.x,
+			(i & 2) ? bounds.max_pt.y : bounds.min_pt.y,
+			(i & 4) ? bounds.max_pt.z : bounds.min_pt.z);
+		radius = glm::max(radius, glm::distance(corner, center));
+	}
+
+	// Small swings (trees) only move points by about radius * angle; full spins need the whole sphere.
+	GLfloat max_angle = glm::radians(glm::max(glm::abs(min), glm::abs(max)) + 2.f * glm::abs(step));
+	if (max_angle < glm::pi<float>())
+	{
+		bounds.inflate(radius * max_angle);
+	}
+	else
+	{
+		bounds.min_pt = center - glm::vec3(radius);
+		bounds.max_pt = center + glm::vec3(radius);
+	}
+}
+
 void SceneAnimation::pass(glm::mat4 m, Shader *s)
 {
 	glm::mat4 new_mat = m * transformation;
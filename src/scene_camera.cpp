@@ -17,6 +17,12 @@ void SceneCamera::update()
 {
 }
 
+void SceneCamera::update_bounds()
+{
+	bounds.reset();
+	num_meshes = 0;
+}
+
 void SceneCamera::recalculate()
 {
 	V = glm::lookAt(cam_pos, cam_pos + cam_front, cam_up);
@@ -1,4 +1,5 @@
 #include "scene_group.h"
+#include "scene.h"
 #include "shader.h"
 
 SceneGroup::SceneGroup() {}
@@ -29,7 +30,15 @@ void SceneGroup::remove_all()
 void SceneGroup::draw(glm::mat4 m)
 {
 	for (auto it = children.begin(); it != children.end(); ++it)
+	{
+		// Drop the whole subtree if its bounds are outside the frustum.
+		if (!Scene::active->in_frustum((*it)->bounds, m))
+		{
+			Scene::meshes_culled += (*it)->num_meshes;
+			continue;
+		}
 		(*it)->draw(m);
+	}
 }
 
 void SceneGroup::update()
@@ -38,6 +47,18 @@ void SceneGroup::update()
 		(*it)->update();
 }
 
+void SceneGroup::update_bounds()
+{
+	bounds.reset();
+	num_meshes = 0;
+	for (auto it = children.begin(); it != children.end(); ++it)
+	{
+		(*it)->update_bounds();
+		bounds.expand((*it)->bounds);
+		num_meshes += (*it)->num_meshes;
+	}
+}
+
 void SceneGroup::pass(glm::mat4 m, Shader *s)
 {
 	for (auto it = children.begin(); it != children.end(); ++it)
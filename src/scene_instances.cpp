@@ -0,0 +1,171 @@
+#include "scene_instances.h"
+#include "gl_state.h"
+
+#include <cstddef>
+
+Matrix4x3::Matrix4x3(const glm::mat4 &m)
+{
+	for (int r = 0; r < 3; ++r)
+		rows[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+}
+
+glm::mat4 Matrix4x3::to_mat4() const
+{
+	glm::mat4 m(1.f);
+	for (int r = 0; r < 3; ++r)
+		for (int c = 0; c < 4; ++c)
+			m[c][r] = rows[r][c];
+	return m;
+}
+
+SceneInstances::SceneInstances(Scene *scene, Mesh mesh)
+{
+	this->scene = scene;
+	this->mesh = mesh;
+	VAO = 0;
+	IBO = 0;
+	parts_buffer = 0;
+	parts_texture = 0;
+	dirty = false;
+}
+
+SceneInstances::~SceneInstances()
+{
+	if (VAO)
+	{
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &IBO);
+	}
+	if (parts_texture)
+	{
+		glDeleteTextures(1, &parts_texture);
+		glDeleteBuffers(1, &parts_buffer);
+	}
+}
+
+void SceneInstances::add_instance(Instance i)
+{
+	instances.push_back(i);
+}
+
+void SceneInstances::upload()
+{
+	// Bounds of one instance's worth of parts, in instance space.
+	BoundingBox pattern_bounds;
+	if (parts.empty())
+		pattern_bounds = mesh.geometry->bounds;
+	for (const Matrix4x3 &part : parts)
+		pattern_bounds.expand(mesh.geometry->bounds.transform(part.to_mat4()));
+
+	// Instance matrices carry the mesh transform, so the shader only needs the graph matrix.
+	instance_data = instances;
+	instance_bounds.reset();
+	for (Instance &i : instance_data)
+	{
+		i.model = i.model * mesh.to_world;
+		BoundingBox b = pattern_bounds.transform(i.model);
+		// Swaying points move at most |p| * angle.
+		if (i.sway.w > 0.f)
+			b.inflate((glm::length(b.center()) + glm::length(b.extent())) * glm::radians(i.sway.w));
+		instance_bounds.expand(b);
+	}
+	dirty = true;
+}
+
+void SceneInstances::upload_buffers()
+{
+	dirty = false;
+	if (!VAO)
+	{
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &IBO);
+	}
+
+	if (!parts.empty())
+	{
+		if (!parts_texture)
+		{
+			glGenBuffers(1, &parts_buffer);
+			glGenTextures(1, &parts_texture);
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, parts_buffer);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(Matrix4x3) * parts.size(), parts.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		GLState::bind_texture(PARTS_TEXTURE_UNIT, GL_TEXTURE_BUFFER, parts_texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, parts_buffer);
+	}
+
+	// Every part of an instance shares its attributes, so they advance once per pattern.
+	GLuint divisor = parts.empty() ? 1 : (GLuint) parts.size();
+
+	// The instances read the base geometry's buffers, so it cannot wait in the upload queue.
+	mesh.geometry->upload();
+	GLState::bind_vertex_array(VAO);
+	mesh.geometry->bind_attributes();
+
+	glBindBuffer(GL_ARRAY_BUFFER, IBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(Instance) * instance_data.size(), instance_data.data(), GL_STATIC_DRAW);
+	for (GLuint i = 0; i < 4; ++i)
+	{
+		glEnableVertexAttribArray(3 + i);
+		glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (GLvoid *) (offsetof(Instance, model) + sizeof(glm::vec4) * i));
+		glVertexAttribDivisor(3 + i, divisor);
+	}
+	glEnableVertexAttribArray(7);
+	glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (GLvoid *) offsetof(Instance, color));
+	glVertexAttribDivisor(7, divisor);
+	glEnableVertexAttribArray(8);
+	glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (GLvoid *) offsetof(Instance, sway));
+	glVertexAttribDivisor(8, divisor);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::bind_vertex_array(0);
+	instance_data.clear();
+	instance_data.shrink_to_fit();
+}
+
+InstanceBatch SceneInstances::batch()
+{
+	GLsizei part_count = (GLsizei) parts.size();
+	GLsizei count = (GLsizei) instances.size() * (part_count ? part_count : 1);
+	InstanceBatch b = { VAO, count, parts_texture, part_count };
+	return b;
+}
+
+void SceneInstances::draw(glm::mat4 m)
+{
+	if (instances.empty())
+		return;
+	if (!Scene::active->in_frustum(instance_bounds, m))
+	{
+		Scene::meshes_culled++;
+		return;
+	}
+	Scene::meshes_drawn++;
+	if (dirty)
+		upload_buffers();
+
+	glm::vec3 center = glm::vec3(m * glm::vec4(instance_bounds.center(), 1.f));
+	GLfloat depth = glm::length(center - Scene::active->camera->cam_pos);
+	Scene::queue.push_instanced(mesh.shader, mesh.geometry, batch(), mesh.material, m, mesh.no_culling, depth);
+}
+
+void SceneInstances::update()
+{
+
+}
+
+void SceneInstances::update_bounds()
+{
+	bounds = instance_bounds;
+	num_meshes = instances.empty() ? 0 : 1;
+}
+
+void SceneInstances::pass(glm::mat4 m, Shader *s)
+{
+	if (instances.empty())
+		return;
+	if (dirty)
+		upload_buffers();
+	s->draw_instanced(mesh.geometry, batch(), m);
+}
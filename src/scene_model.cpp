@@ -1,13 +1,20 @@
 #include "scene_model.h"
 
 #include "util.h"
+#include "upload_queue.h"
 
 SceneModel::SceneModel(Scene *scene)
 {
 	this->scene = scene;
 }
 
-SceneModel::~SceneModel() {}
+SceneModel::~SceneModel()
+{
+	if (!owns_geometry)
+		return;
+	for (Mesh &mesh : meshes)
+		delete(mesh.geometry);
+}
 
 void SceneModel::add_mesh(Mesh m)
 {
@@ -16,24 +23,26 @@ void SceneModel::add_mesh(Mesh m)
 
 void SceneModel::draw(glm::mat4 m)
 {
-	// Loop over meshes and their respective shader programs.
-	for (Mesh mesh : meshes)
+	// Queue meshes; the scene sorts and draws them once traversal is done.
+	glm::vec3 cam_pos = Scene::active->camera->cam_pos;
+	for (const Mesh &mesh : meshes)
 	{
-        mesh.shader->use();
-        mesh.shader->set_VP(scene->camera->V, scene->P);
-		mesh.shader->send_cam_pos(scene->camera->cam_pos);
-		mesh.shader->send_mesh_model(mesh.to_world);
-
-        mesh.shader->set_material(mesh.material);
-		if (mesh.no_culling)
-			glDisable(GL_CULL_FACE);
-		else {
-			glEnable(GL_CULL_FACE);
-			glCullFace(GL_BACK);
+		GLfloat depth = 0.f;
+		if (mesh.geometry)
+		{
+			if (!mesh.geometry->uploaded)
+				continue;
+			if (!Scene::active->in_frustum(mesh.geometry->bounds, m * mesh.to_world))
+			{
+				Scene::meshes_culled++;
+				continue;
+			}
+			glm::vec3 center = glm::vec3(m * mesh.to_world * glm::vec4(mesh.geometry->bounds.center(), 1.f));
+			depth = glm::length(center - cam_pos);
 		}
-        mesh.shader->draw(mesh.geometry, m);
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
+		Scene::meshes_drawn++;
+
+		Scene::queue.push(mesh.shader, mesh.geometry, mesh.material, m, mesh.to_world, mesh.no_culling, depth);
 	}
 }
 
@@ -41,7 +50,7 @@ void SceneModel::pass(glm::mat4 m, Shader * s)
 {
 	for (Mesh mesh : meshes)
 	{
-		if (mesh.geometry) {
+		if (mesh.geometry && mesh.geometry->uploaded) {
 			s->send_mesh_model(mesh.to_world);
 			s->draw(mesh.geometry, m);
 		}
@@ -53,6 +62,20 @@ void SceneModel::update()
 
 }
 
+void SceneModel::update_bounds()
+{
+	bounds.reset();
+	num_meshes = (GLuint) meshes.size();
+	for (Mesh mesh : meshes)
+	{
+		// Meshes without geometry (the skybox) are drawn everywhere.
+		if (mesh.geometry)
+			bounds.expand(mesh.geometry->bounds.transform(mesh.to_world));
+		else
+			bounds.infinite = true;
+	}
+}
+
 void SceneModel::combine_meshes()
 {
 	// Stop if one or zero meshes.
@@ -79,7 +102,7 @@ void SceneModel::combine_meshes()
 			mega_geometry->indices.push_back(i+index_offset);
 		index_offset += (unsigned int) mesh.geometry->indices.size();
 	}
-	mega_geometry->populate_buffers();
+	UploadQueue::push(mega_geometry);
 	meshes.clear();
 	add_mesh(mega_mesh);
 }
@@ -0,0 +1,289 @@
+#include "scene_terrain.h"
+#include "geometry_generator.h"
+#include "shader_manager.h"
+#include "terrain_shader.h"
+#include "gl_state.h"
+#include "texture_cache.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstddef>
+
+// Level 0 is drawn up to this many leaf chunk widths away, and each level doubles it.
+// Anything below about 2.8 lets chunks two levels apart touch and crack.
+const GLfloat LOD_RANGE_FACTOR = 4.f;
+// Fraction of a level's range after which its vertices start morphing into the parent grid.
+const GLfloat MORPH_START = 0.7f;
+// Height error, in terrain units, below which a node is drawn as is.
+const GLfloat DEFAULT_ERROR_TOLERANCE = 0.05f;
+
+Geometry *SceneTerrain::patch = nullptr;
+
+SceneTerrain::SceneTerrain(Scene *scene, GLfloat size, const HeightMap &height_map, Material material)
+{
+	this->scene = scene;
+	this->size = size;
+	this->material = material;
+	error_tolerance = DEFAULT_ERROR_TOLERANCE;
+	height_map_size = height_map.size();
+
+	// One node per patch-sized block of cells at the finest level.
+	GLuint root_level = 0;
+	while ((TERRAIN_PATCH_QUADS << root_level) < height_map_size - 1)
+		root_level++;
+	nodes.resize(1);
+	build_node(0, 0, 0, root_level, height_map);
+	lod_ranges.resize(root_level + 1);
+
+	// Heights for the texture, rows along x like the height map; uploaded on first draw.
+	heights.resize((size_t) height_map_size * height_map_size);
+	height_map.copy_rows(heights.data());
+	VAO = 0;
+}
+
+SceneTerrain::~SceneTerrain()
+{
+	if (!VAO)
+		return;
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &chunk_buffer);
+	glDeleteTextures(1, &height_texture);
+	for (TerrainBand &band : bands)
+		TextureCache::release(band.texture);
+}
+
+void SceneTerrain::upload()
+{
+	if (VAO)
+		return;
+
+	glGenTextures(1, &height_texture);
+	GLState::bind_texture(HEIGHT_TEXTURE_UNIT, GL_TEXTURE_2D, height_texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, height_map_size, height_map_size, 0, GL_RED, GL_FLOAT, heights.data());
+	heights.clear();
+	heights.shrink_to_fit();
+
+	for (TerrainBand &band : bands)
+		band.texture = TextureCache::acquire(GeometryGenerator::texture_path(band.texture_type), GL_REPEAT, GL_NEAREST_MIPMAP_LINEAR);
+
+	if (!patch)
+		patch = GeometryGenerator::generate_grid_patch(TERRAIN_PATCH_QUADS);
+	patch->upload();
+
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &chunk_buffer);
+	GLState::bind_vertex_array(VAO);
+	patch->bind_attributes();
+	glBindBuffer(GL_ARRAY_BUFFER, chunk_buffer);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(TerrainChunk), (GLvoid *) offsetof(TerrainChunk, area));
+	glVertexAttribDivisor(1, 1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(TerrainChunk), (GLvoid *) offsetof(TerrainChunk, morph));
+	glVertexAttribDivisor(2, 1);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::bind_vertex_array(0);
+}
+
+void SceneTerrain::add_band(GLfloat min_height, GLfloat max_height, int texture_type, bool normals_up)
+{
+	if (bands.size() == MAX_TERRAIN_BANDS)
+	{
+		fprintf(stderr, "Terrain already has %u bands!\n", MAX_TERRAIN_BANDS);
+		return;
+	}
+	TerrainBand band = { min_height, max_height, 0, texture_type, normals_up };
+	bands.push_back(band);
+}
+
+void SceneTerrain::build_node(GLuint index, GLuint x, GLuint z, GLuint level, const HeightMap &height_map)
+{
+	GLuint cells = TERRAIN_PATCH_QUADS << level;
+	GLfloat cell_size = size / (GLfloat) (height_map_size - 1);
+
+	TerrainNode n;
+	n.x = -size / 2.f + x * cell_size;
+	n.z = -size / 2.f + z * cell_size;
+	n.size = cells * cell_size;
+	n.level = level;
+	n.children = 0;
+	n.min_height = FLT_MAX;
+	n.max_height = -FLT_MAX;
+	n.error = grid_error(x, z, cells, cells / TERRAIN_PATCH_QUADS, height_map);
+
+	if (level == 0)
+	{
+		GLuint last = height_map_size - 1;
+		for (GLuint i = x; i <= std::min(x + cells, last); ++i)
+		{
+			for (GLuint j = z; j <= std::min(z + cells, last); ++j)
+			{
+				n.min_height = std::min(n.min_height, height_map.at(i, j));
+				n.max_height = std::max(n.max_height, height_map.at(i, j));
+			}
+		}
+	}
+	else
+	{
+		// Children are stored together so a node only needs the index of the first.
+		n.children = (GLuint) nodes.size();
+		nodes.resize(nodes.size() + 4);
+		GLuint half = cells / 2;
+		for (GLuint i = 0; i < 4; ++i)
+		{
+			build_node(n.children + i, x + (i & 1) * half, z + (i >> 1) * half, level - 1, height_map);
+			n.min_height = std::min(n.min_height, nodes[n.children + i].min_height);
+			n.max_height = std::max(n.max_height, nodes[n.children + i].max_height);
+		}
+	}
+	nodes[index] = n;
+}
+
+GLfloat SceneTerrain::grid_error(GLuint x, GLuint z, GLuint cells, GLuint step, const HeightMap &height_map)
+{
+	// Finer than the height map, the grid only interpolates it.
+	if (step <= 1)
+		return 0.f;
+
+	// Compare every sample against the two triangles of the grid quad it falls in,
+	// split along the same diagonal as the patch.
+	GLuint last = height_map_size - 1;
+	GLfloat error = 0.f;
+	for (GLuint qx = x; qx < std::min(x + cells, last); qx += step)
+	{
+		for (GLuint qz = z; qz < std::min(z + cells, last); qz += step)
+		{
+			GLuint qx1 = std::min(qx + step, last);
+			GLuint qz1 = std::min(qz + step, last);
+			GLfloat h1 = height_map.at(qx, qz);
+			GLfloat h2 = height_map.at(qx1, qz);
+			GLfloat h3 = height_map.at(qx, qz1);
+			GLfloat h4 = height_map.at(qx1, qz1);
+			for (GLuint i = qx; i <= qx1; ++i)
+			{
+				for (GLuint j = qz; j <= qz1; ++j)
+				{
+					GLfloat u = (GLfloat) (i - qx) / step;
+					GLfloat w = (GLfloat) (j - qz) / step;
+					GLfloat h = u + w <= 1.f
+						? h1 + u * (h2 - h1) + w * (h3 - h1)
+						: h4 + (1.f - u) * (h3 - h4) + (1.f - w) * (h2 - h4);
+					error = std::max(error, glm::abs(height_map.at(i, j) - h));
+				}
+			}
+		}
+	}
+	return error;
+}
+
+BoundingBox SceneTerrain::node_bounds(const TerrainNode &n)
+{
+	BoundingBox b;
+	b.expand(glm::vec3(n.x, n.min_height, n.z));
+	b.expand(glm::vec3(n.x + n.size, n.max_height, n.z + n.size));
+	return b;
+}
+
+BoundingBox SceneTerrain::neighbourhood_bounds(const TerrainNode &n)
+{
+	BoundingBox b;
+	b.expand(glm::vec3(n.x - n.size, nodes[0].min_height, n.z - n.size));
+	b.expand(glm::vec3(n.x + 2.f * n.size, nodes[0].max_height, n.z + 2.f * n.size));
+	return b;
+}
+
+void SceneTerrain::select(GLuint index, glm::mat4 m, bool cull)
+{
+	const TerrainNode &n = nodes[index];
+	BoundingBox b = node_bounds(n);
+	if (cull && !Scene::active->in_frustum(b, m))
+		return;
+
+	// Refine while any part of the node is within the next finer level's range, unless the
+	// node's grid already matches the height map. Stopping early is only allowed where no
+	// neighbour is in range of a level finer than the next, so adjacent chunks stay at most
+	// one level apart.
+	bool in_range = n.level > 0 && b.transform(m).distance(lod_origin) <= lod_ranges[n.level - 1];
+	bool flat = n.error <= error_tolerance
+		&& (n.level <= 1 || neighbourhood_bounds(n).transform(m).distance(lod_origin) > lod_ranges[n.level - 2]);
+	if (in_range && !flat)
+	{
+		for (GLuint i = 0; i < 4; ++i)
+			select(n.children + i, m, cull);
+		return;
+	}
+
+	GLfloat range_start = n.level > 0 ? lod_ranges[n.level - 1] : 0.f;
+	GLfloat range_end = lod_ranges[n.level];
+	TerrainChunk chunk = { glm::vec4(n.x, n.z, n.size, 0.f), glm::vec4(range_start + (range_end - range_start) * MORPH_START, range_end, 0.f, 0.f) };
+	chunks.push_back(chunk);
+}
+
+void SceneTerrain::select_chunks(glm::mat4 m, bool cull)
+{
+	lod_origin = scene->camera->cam_pos;
+
+	// Ranges are in world units, so scaled copies (like the miniature) get coarser on their own.
+	GLfloat leaf_size = nodes[0].size / (GLfloat) (1 << nodes[0].level) * glm::length(glm::vec3(m[0]));
+	for (GLuint level = 0; level < lod_ranges.size(); ++level)
+		lod_ranges[level] = LOD_RANGE_FACTOR * leaf_size * (GLfloat) (1 << level);
+
+	chunks.clear();
+	select(0, m, cull);
+
+	glBindBuffer(GL_ARRAY_BUFFER, chunk_buffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(TerrainChunk) * chunks.size(), chunks.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+InstanceBatch SceneTerrain::batch()
+{
+	InstanceBatch b = { VAO, (GLsizei) chunks.size(), 0, 0 };
+	return b;
+}
+
+void SceneTerrain::draw(glm::mat4 m)
+{
+	upload();
+	select_chunks(m, true);
+	if (chunks.empty())
+	{
+		Scene::meshes_culled++;
+		return;
+	}
+	Scene::meshes_drawn++;
+	Scene::terrain_triangles += (GLuint) chunks.size() * TERRAIN_PATCH_QUADS * TERRAIN_PATCH_QUADS * 2;
+
+	Scene::queue.push_custom(ShaderManager::get_shader_program("terrain"), this, material, m, no_culling, 0.f);
+}
+
+void SceneTerrain::update()
+{
+
+}
+
+void SceneTerrain::update_bounds()
+{
+	bounds = node_bounds(nodes[0]);
+	num_meshes = 1;
+}
+
+void SceneTerrain::pass(glm::mat4 m, Shader *s)
+{
+	// The depth pass needs the same displacement, so it has a terrain program of its own.
+	upload();
+	select_chunks(m, false);
+	TerrainShader *ts = (TerrainShader *) ShaderManager::get_shader_program("terrain_shadow");
+	ts->use();
+	ts->draw_terrain(this, m);
+	s->use();
+}
+
+void SceneTerrain::submit(Shader *s, glm::mat4 m)
+{
+	((TerrainShader *) s)->draw_terrain(this, m);
+}
@@ -55,6 +55,15 @@ void SceneTransAnim::draw(glm::mat4 m)
 	SceneGroup::draw(new_matrix);
 }
 
+void SceneTransAnim::update_bounds()
+{
+	SceneGroup::update_bounds();
+
+	// Cover the full slide, which runs until curr_percent passes 100.
+	BoundingBox end = bounds.transform(glm::translate(glm::mat4(1.f), dir * 101.f));
+	bounds.expand(end);
+}
+
 void SceneTransAnim::pass(glm::mat4 m, Shader *s)
 {
 	glm::mat4 new_mat = m * transformation;
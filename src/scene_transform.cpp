@@ -21,6 +21,12 @@ void SceneTransform::update()
 
 }
 
+void SceneTransform::update_bounds()
+{
+	SceneGroup::update_bounds();
+	bounds = bounds.transform(transformation);
+}
+
 void SceneTransform::pass(glm::mat4 m, Shader *s)
 {
 	glm::mat4 new_mat = m * transformation;
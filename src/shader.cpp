@@ -1,24 +1,93 @@
 #include "shader.h"
+#include "uniform_blocks.h"
+#include "gl_state.h"
 
 #include <iostream>
+#include <vector>
 
 Shader::Shader(GLuint shader_id)
-    : shader_id(shader_id) {}
+    : shader_id(shader_id)
+{
+	reflect_uniforms();
+	UniformBlocks::bind_program(shader_id);
+}
 
 void Shader::use()
 {
-    glUseProgram(shader_id);
+    GLState::use_program(shader_id);
+}
+
+void Shader::reflect_uniforms()
+{
+	uniforms.clear();
+
+	GLint num_uniforms = 0, max_length = 0;
+	glGetProgramiv(shader_id, GL_ACTIVE_UNIFORMS, &num_uniforms);
+	glGetProgramiv(shader_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+	if (max_length <= 0)
+		return;
+
+	std::vector<GLchar> name(max_length);
+	for (GLint i = 0; i < num_uniforms; ++i)
+	{
+		GLint size;
+		GLenum type;
+		glGetActiveUniform(shader_id, (GLuint) i, max_length, NULL, &size, &type, &name[0]);
+		GLint location = glGetUniformLocation(shader_id, &name[0]);
+		// Members of uniform blocks have no location.
+		if (location == -1)
+			continue;
+
+		// Arrays are reported as "name[0]"; register the bare name too.
+		std::string uniform_name(&name[0]);
+		uniforms[uniform_name] = location;
+		size_t bracket = uniform_name.find("[0]");
+		if (bracket != std::string::npos && bracket + 3 == uniform_name.size())
+			uniforms[uniform_name.substr(0, bracket)] = location;
+	}
+}
+
+GLint Shader::uniform(const char *name)
+{
+	auto it = uniforms.find(name);
+	if (it == uniforms.end())
+		return -1;
+	return it->second;
+}
+
+void Shader::set_uniform(GLint location, GLint value)
+{
+	glUniform1i(location, value);
 }
 
-void Shader::send_cam_pos(glm::vec3 cam_pos)
+void Shader::set_uniform(GLint location, GLfloat value)
 {
-	this->cam_pos = cam_pos;
+	glUniform1f(location, value);
 }
 
-void Shader::set_VP(glm::mat4 V, glm::mat4 P)
+void Shader::set_uniform(GLint location, const glm::vec2 &value)
 {
-    this->V = V;
-    this->P = P;
+	glUniform2f(location, value.x, value.y);
+}
+
+void Shader::set_uniform(GLint location, const glm::vec3 &value)
+{
+	glUniform3f(location, value.x, value.y, value.z);
+}
+
+void Shader::set_uniform(GLint location, const glm::vec4 *values, GLsizei count)
+{
+	glUniform4fv(location, count, &values[0][0]);
+}
+
+void Shader::set_uniform(GLint location, const glm::mat3 &value)
+{
+	glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]);
+}
+
+void Shader::set_uniform(GLint location, const glm::mat4 &value)
+{
+	glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
 }
 
 void Shader::send_mesh_model(glm::mat4 mesh_model)
@@ -28,4 +97,13 @@ void Shader::send_mesh_model(glm::mat4 mesh_model)
 
 void Shader::set_material(Material m) {}
 
-void Shader::draw(Geometry *g, glm::mat4 to_world) {}
\ No newline at end of file
+void Shader::draw(Geometry *g, glm::mat4 to_world) {}
+
+void Shader::draw_instanced(Geometry *, const InstanceBatch &, glm::mat4) {}
+
+bool Shader::batchable(Geometry *)
+{
+	return false;
+}
+
+void Shader::draw_multi(MultiDraw &) {}
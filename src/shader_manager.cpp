@@ -2,6 +2,7 @@
 #include "skybox_shader.h"
 #include "basic_shader.h"
 #include "shadow_shader.h"
+#include "terrain_shader.h"
 
 std::map<const char*, Shader*> ShaderManager::shaders;
 Shader * ShaderManager::default_shader;
@@ -96,8 +97,7 @@ void ShaderManager::create_shader_program(const char *type)
 	glDeleteShader(VertexShaderID);
 	glDeleteShader(FragmentShaderID);
 
-	printf("Compiled and linked shader: %s\n", type);
-
+    // Constructing the wrapper reflects the program's active uniforms.
     Shader *s;
     std::string name = std::string(type);
 	if (name == "basic")
@@ -106,6 +106,8 @@ void ShaderManager::create_shader_program(const char *type)
 		s = new SkyboxShader(ProgramID);
 	else if (name == "shadow")
 		s = new ShadowShader(ProgramID);
+	else if (name == "terrain" || name == "terrain_shadow")
+		s = new TerrainShader(ProgramID);
 	else if (name == "debug_shadow")
 		s = new Shader(ProgramID);
     else {
@@ -113,6 +115,7 @@ void ShaderManager::create_shader_program(const char *type)
         return;
     }
 	shaders[type] = s;
+	printf("Compiled and linked shader: %s (%u uniforms)\n", type, (unsigned int) s->uniforms.size());
 }
 
 Shader* ShaderManager::get_shader_program(const char *type)
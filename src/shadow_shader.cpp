@@ -1,16 +1,26 @@
 #include "shadow_shader.h"
+#include "gl_state.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 
 ShadowShader::ShadowShader(GLuint shader_id) : Shader(shader_id)
 {
+	model_loc = uniform("model");
+	instanced_loc = uniform("instanced");
+	part_count_loc = uniform("part_count");
+	multi_draw_loc = uniform("multi_draw");
+	GLState::use_program(shader_id);
+	set_uniform(uniform("parts"), (GLint) PARTS_TEXTURE_UNIT);
+	set_uniform(uniform("draws"), (GLint) DRAWS_TEXTURE_UNIT);
+	GLState::use_program(0);
+
 	glGenFramebuffers(1, &FBO);
 	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
 
 	// Generate shadow map texture.
 	size = 4096;
 	glGenTextures(1, &shadow_map_tex);
-	glBindTexture(GL_TEXTURE_2D, shadow_map_tex);
+	GLState::bind_texture(0, GL_TEXTURE_2D, shadow_map_tex);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -30,16 +40,45 @@ void ShadowShader::set_material(Material m)
 {
 }
 
-void ShadowShader::draw(Geometry *g, glm::mat4 to_world)
+void ShadowShader::update_light_matrix()
 {
 	// Recalculate light matrix based on current light position and light projection matrix
 	glm::mat4 light_view = glm::lookAt(light_pos, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
 	light_matrix = light_proj * light_view;
+}
 
-	glUniformMatrix4fv(glGetUniformLocation(shader_id, "view_projection"), 1, GL_FALSE, &light_matrix[0][0]);
-	glUniformMatrix4fv(glGetUniformLocation(shader_id, "model"), 1, GL_FALSE, &to_world[0][0]);
-	glUniformMatrix4fv(glGetUniformLocation(shader_id, "mesh_model"), 1, GL_FALSE, &mesh_model[0][0]);
+void ShadowShader::draw(Geometry *g, glm::mat4 to_world)
+{
+	// Depth has no material, so every plain draw of the pass can share one batch.
+	if (MultiDraw::supported())
+	{
+		deferred.add(g, to_world * mesh_model);
+		return;
+	}
+	set_uniform(model_loc, to_world * mesh_model);
+	set_uniform(instanced_loc, 0);
 	g->bind();
 	g->draw();
-	glBindVertexArray(0);
-}
\ No newline at end of file
+}
+
+void ShadowShader::draw_instanced(Geometry *g, const InstanceBatch &batch, glm::mat4 to_world)
+{
+	set_uniform(model_loc, to_world);
+	set_uniform(instanced_loc, 1);
+	set_uniform(part_count_loc, (GLint) batch.part_count);
+	if (batch.parts_texture)
+		GLState::bind_texture(PARTS_TEXTURE_UNIT, GL_TEXTURE_BUFFER, batch.parts_texture);
+	GLState::bind_vertex_array(batch.vao);
+	g->draw_instanced(batch.count);
+}
+
+void ShadowShader::flush()
+{
+	if (deferred.empty())
+		return;
+	use();
+	set_uniform(instanced_loc, 0);
+	set_uniform(multi_draw_loc, 1);
+	deferred.submit();
+	set_uniform(multi_draw_loc, 0);
+}
@@ -1,6 +1,8 @@
 #include "shape_grammar.h"
 #include "util.h"
 #include "global.h"
+#include "upload_queue.h"
+#include "procedural_cache.h"
 
 const float PLAYER_HEIGHT = Global::PLAYER_HEIGHT;
 const float DOOR_HEIGHT = 25.0f/20.f * PLAYER_HEIGHT; //Should be larger than size of human
@@ -13,35 +15,91 @@ const float MIN_DIAMETER = 60.0f/20.f * PLAYER_HEIGHT;
 const float MAX_DIAMETER = 70.0f/20.f * PLAYER_HEIGHT;
 const int NUM_DIVISIONS = 15;
 
-bool in_shadow;
+// Buildings may be generated on several threads at once.
+thread_local bool in_shadow;
 
 //Main Generation Function
-SceneModel *ShapeGrammar::generate_building(Scene * scene, bool shadowed, int seed)
+SceneModel *ShapeGrammar::generate_building(Scene * scene, bool shadowed, Random rng)
 {
 	in_shadow = shadowed;
 	SceneModel *building = new SceneModel(scene);
+	building->owns_geometry = true;
 
-	//Set seed if necessary
-	if (seed != 0)
-		srand(seed);
+	CacheKey key("building");
+	key << rng.seed() << rng.stream() << shadowed;
+	if (load_building(key, building))
+		return building;
 
 	//Recursively adds levels to the building, starting with the base
-	create_base(building); 
+	create_base(building, rng); 
 
+	CacheWriter writer;
+	writer.write((uint64_t) building->meshes.size());
+	for (const Mesh &mesh : building->meshes)
+	{
+		writer.write(mesh.material.ambient);
+		writer.write(mesh.material.diffuse);
+		writer.write(mesh.material.specular);
+		writer.write(mesh.material.shininess);
+		writer.write(mesh.material.shadows);
+		writer.write(mesh.to_world);
+		writer.write(mesh.no_culling);
+		mesh.geometry->write(writer);
+	}
+	ProceduralCache::store(key, writer);
 	return building;
 }
 
-void ShapeGrammar::create_base(SceneModel * building)
+bool ShapeGrammar::load_building(const CacheKey &key, SceneModel *building)
+{
+	MappedFile file;
+	CacheReader reader;
+	uint64_t num_meshes;
+	if (!ProceduralCache::load(key, file, reader) || !reader.read(num_meshes))
+		return false;
+
+	std::vector<Mesh> meshes;
+	for (uint64_t i = 0; i < num_meshes && reader.ok; ++i)
+	{
+		Mesh mesh = { nullptr, Material(), ShaderManager::get_default() };
+		reader.read(mesh.material.ambient);
+		reader.read(mesh.material.diffuse);
+		reader.read(mesh.material.specular);
+		reader.read(mesh.material.shininess);
+		reader.read(mesh.material.shadows);
+		reader.read(mesh.to_world);
+		reader.read(mesh.no_culling);
+		Geometry *geometry = new Geometry();
+		meshes.push_back(mesh);
+		meshes.back().geometry = geometry;
+		geometry->read(reader);
+	}
+	if (!reader.done())
+	{
+		for (Mesh &mesh : meshes)
+			delete(mesh.geometry);
+		return false;
+	}
+
+	for (Mesh &mesh : meshes)
+	{
+		UploadQueue::push(mesh.geometry);
+		building->add_mesh(mesh);
+	}
+	return true;
+}
+
+void ShapeGrammar::create_base(SceneModel * building, Random &rng)
 {
 	//Base is always starting from the origin, and building upwards above the x_z_plane
 	//Randomly choose a base type, with constrained random parameters
-	int base_type = (int) floor(Util::random(0, 2));	
+	int base_type = (int) floor(rng.random(0, 2));	
 
 	if (base_type == BOX) 
 	{
 		//Randomize Height and Width
-		float width = Util::random(MIN_WIDTH, MAX_WIDTH);
-		float height = Util::random(MIN_HEIGHT, MAX_HEIGHT);
+		float width = rng.random(MIN_WIDTH, MAX_WIDTH);
+		float height = rng.random(MIN_HEIGHT, MAX_HEIGHT);
 
 		//Make Geometry: Vertices, Normals, Indices, Triangles for Box
 		Geometry *box = new Geometry();
@@ -116,27 +174,27 @@ void ShapeGrammar::create_base(SceneModel * building)
 		for (int i = 0; i < box->vertices.size(); ++i)
 			box->indices.push_back(i);
 		
-		box->populate_buffers();
+		UploadQueue::push(box);
 
-		Mesh box_mesh = { box, random_material(), ShaderManager::get_default() };
+		Mesh box_mesh = { box, random_material(rng), ShaderManager::get_default() };
 		box_mesh.no_culling = true;
 		
 		building->add_mesh(box_mesh);
 
 		//Add Next layer
 		int variations[] = { BOX, PYRAMID, PLANE };
-		int next_level = variations[(int) Util::random(0, 3)];
+		int next_level = variations[(int) rng.random(0, 3)];
 
 		switch (next_level)
 		{
 		case BOX:
-			add_box(building, height, width);
+			add_box(building, rng, height, width);
 			break;
 		case PYRAMID:
-			add_pyramid(building, height, width);
+			add_pyramid(building, rng, height, width);
 			break;
 		case PLANE:
-			add_plane(building, height, width, BOX);
+			add_plane(building, rng, height, width, BOX);
 			break;
 		default:
 			break;
@@ -145,8 +203,8 @@ void ShapeGrammar::create_base(SceneModel * building)
 	else if (base_type == CYLINDER)
 	{
 		//Randomize Height and Width
-		float diameter = Util::random(MIN_DIAMETER, MAX_DIAMETER);
-		float height = Util::random(MIN_HEIGHT, MAX_HEIGHT);
+		float diameter = rng.random(MIN_DIAMETER, MAX_DIAMETER);
+		float height = rng.random(MIN_HEIGHT, MAX_HEIGHT);
 		float radius = diameter / 2.f;
 		//float divisions = ceilf(2.f * glm::pi<float>() * radius / DOOR_WIDTH) * 2.f; //Two Division is the width of the door
 		float divisions = (float)NUM_DIVISIONS;
@@ -213,30 +271,30 @@ void ShapeGrammar::create_base(SceneModel * building)
 		for (int i = 0; i < cylinder->vertices.size(); i++)
 			cylinder->indices.push_back(i);
 
-		cylinder->populate_buffers();
+		UploadQueue::push(cylinder);
 
-		Mesh cylinder_mesh = { cylinder, random_material(), ShaderManager::get_default() };
+		Mesh cylinder_mesh = { cylinder, random_material(rng), ShaderManager::get_default() };
 		cylinder_mesh.no_culling = true;
 
 		building->add_mesh(cylinder_mesh);
 
 		//Add Next layer
 		int variations[] = { CYLINDER, HEMISPHERE, CONE, PLANE };
-		int next_level = variations[(int)Util::random(0, 4)];
+		int next_level = variations[(int)rng.random(0, 4)];
 
 		switch (next_level)
 		{
 		case CYLINDER:
-			add_cylinder(building, height, diameter, num_divisions_for_width / 2.f);
+			add_cylinder(building, rng, height, diameter, num_divisions_for_width / 2.f);
 			break;
 		case HEMISPHERE:
-			add_hemisphere(building, height, diameter, num_divisions_for_width / 2.f);
+			add_hemisphere(building, rng, height, diameter, num_divisions_for_width / 2.f);
 			break;
 		case CONE:
-			add_cone(building, height, diameter, num_divisions_for_width / 2.f);
+			add_cone(building, rng, height, diameter, num_divisions_for_width / 2.f);
 			break;
 		case PLANE:
-			add_plane(building, height, diameter, CYLINDER, num_divisions_for_width / 2.f);
+			add_plane(building, rng, height, diameter, CYLINDER, num_divisions_for_width / 2.f);
 			break;
 		default:
 			break;
@@ -245,7 +303,7 @@ void ShapeGrammar::create_base(SceneModel * building)
 	else if (base_type == HEMISPHERE)
 	{
 		//Randomize Height and Width
-		float diameter = Util::random(MIN_DIAMETER, MAX_DIAMETER);
+		float diameter = rng.random(MIN_DIAMETER, MAX_DIAMETER);
 		float radius = diameter / 2.f;
 		//float divisions = ceilf(2.f * glm::pi<float>() * radius / DOOR_WIDTH) * 2.f; //Two Division is the width of the door
 		float divisions = (float)NUM_DIVISIONS;
@@ -345,8 +403,8 @@ void ShapeGrammar::create_base(SceneModel * building)
 		for (int i = 0; i < hemisphere->vertices.size(); i++)
 			hemisphere->indices.push_back(i);
 
-		hemisphere->populate_buffers();
-		Mesh hemisphere_mesh = { hemisphere, random_material(), ShaderManager::get_default() };
+		UploadQueue::push(hemisphere);
+		Mesh hemisphere_mesh = { hemisphere, random_material(rng), ShaderManager::get_default() };
 		hemisphere_mesh.no_culling = true;
 
 		building->add_mesh(hemisphere_mesh);
@@ -357,11 +415,11 @@ void ShapeGrammar::create_base(SceneModel * building)
 	//TODO: Garbage Collector for Created Geometries
 }
 
-void ShapeGrammar::add_box(SceneModel * building, float last_height, float last_width)
+void ShapeGrammar::add_box(SceneModel * building, Random &rng, float last_height, float last_width)
 {
 	//Randomize Height and Width
 	float width = last_width;
-	float height = Util::random(MIN_HEIGHT, MAX_HEIGHT);
+	float height = rng.random(MIN_HEIGHT, MAX_HEIGHT);
 
 	//Make Geometry: Vertices, Normals, Indices, Triangles for Box
 	Geometry *box = new Geometry();
@@ -418,38 +476,38 @@ void ShapeGrammar::add_box(SceneModel * building, float last_height, float last_
 	for (int i = 0; i < box->vertices.size(); ++i)
 		box->indices.push_back(i);
 
-	box->populate_buffers();
+	UploadQueue::push(box);
 
-	Mesh box_mesh = { box, random_material(), ShaderManager::get_default() };
+	Mesh box_mesh = { box, random_material(rng), ShaderManager::get_default() };
 	box_mesh.no_culling = true;
 
 	building->add_mesh(box_mesh);
 
 	//Add Next layer
 	int variations[] = { BOX, PYRAMID, PLANE };
-	int next_level = variations[(int)Util::random(0, 3)];
+	int next_level = variations[(int)rng.random(0, 3)];
 
 	switch (next_level)
 	{
 	case BOX:
-		add_box(building, last_height + height, width);
+		add_box(building, rng, last_height + height, width);
 		break;
 	case PYRAMID:
-		add_pyramid(building, last_height + height, width);
+		add_pyramid(building, rng, last_height + height, width);
 		break;
 	case PLANE:
-		add_plane(building, last_height + height, width, BOX);
+		add_plane(building, rng, last_height + height, width, BOX);
 		break;
 	default:
 		break;
 	}
 }
 
-void ShapeGrammar::add_cylinder(SceneModel * building, float last_height, float last_width, float offset)
+void ShapeGrammar::add_cylinder(SceneModel * building, Random &rng, float last_height, float last_width, float offset)
 {
 	//Randomize Height and Width
 	float diameter = last_width;
-	float height = Util::random(MIN_HEIGHT, MAX_HEIGHT);
+	float height = rng.random(MIN_HEIGHT, MAX_HEIGHT);
 	float radius = diameter / 2.f;
 	float divisions = (float) NUM_DIVISIONS;
 
@@ -488,37 +546,37 @@ void ShapeGrammar::add_cylinder(SceneModel * building, float last_height, float
 	for (int i = 0; i < cylinder->vertices.size(); i++)
 		cylinder->indices.push_back(i);
 
-	cylinder->populate_buffers();
+	UploadQueue::push(cylinder);
 
-	Mesh cylinder_mesh = { cylinder, random_material(), ShaderManager::get_default() };
+	Mesh cylinder_mesh = { cylinder, random_material(rng), ShaderManager::get_default() };
 	cylinder_mesh.no_culling = true;
 
 	building->add_mesh(cylinder_mesh);
 
 	//Add Next layer
 	int variations[] = { CYLINDER, HEMISPHERE, CONE, PLANE };
-	int next_level = variations[(int)Util::random(0, 4)];
+	int next_level = variations[(int)rng.random(0, 4)];
 
 	switch (next_level)
 	{
 	case CYLINDER:
-		add_cylinder(building, last_height + height, diameter, offset);
+		add_cylinder(building, rng, last_height + height, diameter, offset);
 		break;
 	case HEMISPHERE:
-		add_hemisphere(building, last_height + height, diameter, offset);
+		add_hemisphere(building, rng, last_height + height, diameter, offset);
 		break;
 	case CONE:
-		add_cone(building, last_height + height, diameter, offset);
+		add_cone(building, rng, last_height + height, diameter, offset);
 		break;
 	case PLANE:
-		add_plane(building, last_height + height, diameter, CYLINDER, offset);
+		add_plane(building, rng, last_height + height, diameter, CYLINDER, offset);
 		break;
 	default:
 		break;
 	}
 }
 
-void ShapeGrammar::add_hemisphere(SceneModel * building, float last_height, float last_width, float offset)
+void ShapeGrammar::add_hemisphere(SceneModel * building, Random &rng, float last_height, float last_width, float offset)
 {
 	//Randomize
 	float diameter = last_width;
@@ -576,18 +634,18 @@ void ShapeGrammar::add_hemisphere(SceneModel * building, float last_height, floa
 	for (int i = 0; i < hemisphere->vertices.size(); i++)
 		hemisphere->indices.push_back(i);
 
-	hemisphere->populate_buffers();
-	Mesh hemisphere_mesh = { hemisphere, random_material(), ShaderManager::get_default() };
+	UploadQueue::push(hemisphere);
+	Mesh hemisphere_mesh = { hemisphere, random_material(rng), ShaderManager::get_default() };
 	hemisphere_mesh.no_culling = true;
 
 	building->add_mesh(hemisphere_mesh);
 }
 
-void ShapeGrammar::add_pyramid(SceneModel * building, float last_height, float last_width)
+void ShapeGrammar::add_pyramid(SceneModel * building, Random &rng, float last_height, float last_width)
 {
 	//Randomize Height and Width
 	float width = last_width;
-	float height = Util::random(MIN_HEIGHT, MAX_HEIGHT);
+	float height = rng.random(MIN_HEIGHT, MAX_HEIGHT);
 
 	//Make Geometry: Vertices, Normals, Indices, Triangles for Box
 	Geometry *pyramid = new Geometry();
@@ -599,7 +657,7 @@ void ShapeGrammar::add_pyramid(SceneModel * building, float last_height, float l
 
 	//Randomize Top Point Location (To add more roof variety. If not at center, it becomes a slanted roof)
 	glm::vec2 top_point_loc[] = { {0.f, 0.f}, {width / 2.f, width / 2.f}, {-width / 2.f, width / 2.f}, {width / 2.f, -width / 2.f} };
-	int loc = (int)Util::random(0, 2);
+	int loc = (int)rng.random(0, 2);
 	glm::vec3 v4 = { top_point_loc[loc].x, last_height + height, top_point_loc[loc].y }; //Top Point
 
 	//Left Wall
@@ -633,19 +691,19 @@ void ShapeGrammar::add_pyramid(SceneModel * building, float last_height, float l
 	for (int i = 0; i < pyramid->vertices.size(); ++i)
 		pyramid->indices.push_back(i);
 
-	pyramid->populate_buffers();
+	UploadQueue::push(pyramid);
 
-	Mesh pyramid_mesh = { pyramid, random_material(), ShaderManager::get_default() };
+	Mesh pyramid_mesh = { pyramid, random_material(rng), ShaderManager::get_default() };
 	pyramid_mesh.no_culling = true;
 
 	building->add_mesh(pyramid_mesh);
 }
 
-void ShapeGrammar::add_cone(SceneModel * building, float last_height, float last_width, float offset)
+void ShapeGrammar::add_cone(SceneModel * building, Random &rng, float last_height, float last_width, float offset)
 {
 	//Randomize Height and Width
 	float diameter = last_width;
-	float height = Util::random(MIN_HEIGHT, MAX_HEIGHT);
+	float height = rng.random(MIN_HEIGHT, MAX_HEIGHT);
 	float radius = diameter / 2.f;
 	float divisions = (float)NUM_DIVISIONS;
 
@@ -678,15 +736,15 @@ void ShapeGrammar::add_cone(SceneModel * building, float last_height, float last
 	for (int i = 0; i < cone->vertices.size(); i++)
 		cone->indices.push_back(i);
 
-	cone->populate_buffers();
+	UploadQueue::push(cone);
 
-	Mesh cone_mesh = { cone, random_material(), ShaderManager::get_default() };
+	Mesh cone_mesh = { cone, random_material(rng), ShaderManager::get_default() };
 	cone_mesh.no_culling = true;
 
 	building->add_mesh(cone_mesh);
 }
 
-void ShapeGrammar::add_plane(SceneModel * building, float last_height, float last_width, int shape, float offset)
+void ShapeGrammar::add_plane(SceneModel * building, Random &rng, float last_height, float last_width, int shape, float offset)
 {
 	//Closes Previous Shape
 
@@ -714,9 +772,9 @@ void ShapeGrammar::add_plane(SceneModel * building, float last_height, float las
 		for (int i = 0; i < plane->vertices.size(); ++i)
 			plane->indices.push_back(i);
 
-		plane->populate_buffers();
+		UploadQueue::push(plane);
 
-		Mesh plane_mesh = { plane, random_material(), ShaderManager::get_default() };
+		Mesh plane_mesh = { plane, random_material(rng), ShaderManager::get_default() };
 		plane_mesh.no_culling = true;
 
 		building->add_mesh(plane_mesh);
@@ -754,21 +812,21 @@ void ShapeGrammar::add_plane(SceneModel * building, float last_height, float las
 		for (int i = 0; i < cylinder->vertices.size(); i++)
 			cylinder->indices.push_back(i);
 
-		cylinder->populate_buffers();
+		UploadQueue::push(cylinder);
 
-		Mesh cylinder_mesh = { cylinder, random_material(), ShaderManager::get_default() };
+		Mesh cylinder_mesh = { cylinder, random_material(rng), ShaderManager::get_default() };
 		cylinder_mesh.no_culling = true;
 
 		building->add_mesh(cylinder_mesh);
 	}
 }
 
-Material ShapeGrammar::random_material()
+Material ShapeGrammar::random_material(Random &rng)
 {
 	Material material;
 
 	glm::vec3 leaf_colors[] = { color::olive_green, color::autumn_orange, color::purple, color::wood_tan_light, color::indian_red };
-	material.diffuse = material.ambient = leaf_colors[(int)Util::random(0, 5)];
+	material.diffuse = material.ambient = leaf_colors[(int)rng.random(0, 5)];
 	material.shadows = in_shadow;
 
 	return material;	
@@ -1,5 +1,8 @@
 #include "skybox_shader.h"
 #include "util.h"
+#include "gl_state.h"
+#include "asset_pack.h"
+#include "resource_loader.h"
 
 #include <vector>
 
@@ -48,72 +51,150 @@ const GLfloat skybox_vertices[] = {
 	1.0f, -1.0f,  1.0f
 };
 
-const int NUM_SKYBOXES = 5;
-
 SkyboxShader::SkyboxShader(GLuint shader_id) : Shader(shader_id)
 {
+	background = true;
+	GLState::use_program(shader_id);
+	set_uniform(uniform("skybox"), 0);
+	GLState::use_program(0);
+
 	glGenVertexArrays(1, &VAO);
 	glGenBuffers(1, &VBO);
-	glBindVertexArray(VAO);
+	GLState::bind_vertex_array(VAO);
 
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(skybox_vertices), &skybox_vertices, GL_STATIC_DRAW);
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
 
-	glBindVertexArray(0);
+	GLState::bind_vertex_array(0);
+
+	// Only the first skybox is loaded up front, and before the first frame.
+	cubemaps.resize(NUM_SKYBOXES);
+	load(0, false);
+}
+
+std::string SkyboxShader::cubemap_dir(int skybox)
+{
+	const char *skybox_names[NUM_SKYBOXES] = { "low-res-cloudy", "sahara", "snow", "space", "violent-days" };
+	return std::string("assets/skybox/") + skybox_names[skybox];
+}
 
-	for (int i = 0; i < NUM_SKYBOXES; ++i)
+bool SkyboxShader::load_faces(int skybox, TextureData &data)
+{
+	if (AssetPack::load_cubemap(cubemap_dir(skybox), data))
+		return true;
+
+	const char *faces[] = { "/right.ppm", "/left.ppm", "/top.ppm", "/bottom.ppm", "/back.ppm", "/front.ppm" };
+	int widths[6], heights[6];
+	data.target = GL_TEXTURE_CUBE_MAP;
+	data.format = GL_RGB;
+	data.type = GL_UNSIGNED_BYTE;
+	data.generate_mipmaps = false;
+	data.storage.clear();
+	data.levels.clear();
+	for (GLuint j = 0; j < 6; ++j)
 	{
-		GLuint texture_id;
-		glGenTextures(1, &texture_id);
-		texture_ids.push_back(texture_id);
+		std::string path = cubemap_dir(skybox) + faces[j];
+		unsigned char *image = Util::loadPPM(path.c_str(), widths[j], heights[j]);
+		if (!image)
+			return false;
+		data.storage.insert(data.storage.end(), image, image + (size_t) widths[j] * heights[j] * 3);
+		delete[] image;
 	}
-	load_cubemap();
+	// Levels point into storage, so they are added once it has stopped growing.
+	size_t offset = 0;
+	for (GLuint j = 0; j < 6; ++j)
+	{
+		size_t size = (size_t) widths[j] * heights[j] * 3;
+		data.levels.push_back({ GL_TEXTURE_CUBE_MAP_POSITIVE_X + j, 0, widths[j], heights[j], data.storage.data() + offset, size });
+		offset += size;
+	}
+	return true;
 }
 
-void SkyboxShader::load_cubemap()
+void SkyboxShader::load(GLuint skybox, bool async)
 {
-	std::vector<const char*> faces;
-	faces.push_back("\\right.ppm");
-	faces.push_back("\\left.ppm");
-	faces.push_back("\\top.ppm");
-	faces.push_back("\\bottom.ppm");
-	faces.push_back("\\back.ppm");
-	faces.push_back("\\front.ppm");
-
-	int width, height;
-	unsigned char *image;
-
-	std::string prefix = "assets\\skybox\\";
-
-	std::vector<std::string> skybox_names;
-	skybox_names.push_back("low-res-cloudy");
-	skybox_names.push_back("sahara");
-	skybox_names.push_back("snow");
-	skybox_names.push_back("space");
-	skybox_names.push_back("violent-days");
-
-	for (int i = 0; i < NUM_SKYBOXES; ++i)
+	Cubemap &cubemap = cubemaps[skybox];
+	if (cubemap.texture)
+		return;
+
+	glGenTextures(1, &cubemap.texture);
+	GLState::bind_texture(0, GL_TEXTURE_CUBE_MAP, cubemap.texture);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	if (async && ResourceLoader::running())
 	{
-		glBindTexture(GL_TEXTURE_CUBE_MAP, texture_ids[i]);
-		for (GLuint j = 0; j < faces.size(); ++j) {
-			std::string path = prefix + skybox_names[i] + std::string(faces[j]);
-			image = Util::loadPPM(path.c_str(), width, height);
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + j, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-			delete image;
-		}
+		GLState::bind_texture(0, GL_TEXTURE_CUBE_MAP, 0);
+		ResourceLoader::load_texture(cubemap.texture, [skybox](TextureData &data) { load_faces(skybox, data); },
+			[this, skybox](size_t size) { loaded(skybox, size); });
+		return;
+	}
+
+	TextureData data;
+	load_faces(skybox, data);
+	data.upload();
+	GLState::bind_texture(0, GL_TEXTURE_CUBE_MAP, 0);
+	loaded(skybox, data.size());
+}
+
+void SkyboxShader::loaded(GLuint skybox, size_t size)
+{
+	Cubemap &cubemap = cubemaps[skybox];
+	cubemap.ready = true;
+	cubemap.size = size;
+	cubemap.last_used = ++use_clock;
+	if (!cubemaps[shown_skybox].ready)
+		shown_skybox = skybox;
+	evict();
+}
+
+void SkyboxShader::evict()
+{
+	size_t resident = 0;
+	for (const Cubemap &cubemap : cubemaps)
+		resident += cubemap.size;
 
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	// Least recently shown first; what is on screen or about to be stays, even over budget.
+	while (resident > vram_budget)
+	{
+		Cubemap *oldest = nullptr;
+		for (GLuint i = 0; i < cubemaps.size(); ++i)
+		{
+			if (cubemaps[i].ready && i != current_texture_id && i != shown_skybox && i != prefetched_skybox && (!oldest || cubemaps[i].last_used < oldest->last_used))
+				oldest = &cubemaps[i];
+		}
+		if (!oldest)
+			break;
+		glDeleteTextures(1, &oldest->texture);
+		// The name may come back for another texture while still shadowed as bound.
+		GLState::invalidate();
+		resident -= oldest->size;
+		*oldest = Cubemap();
 	}
 }
 
+void SkyboxShader::select(GLuint skybox)
+{
+	current_texture_id = skybox % NUM_SKYBOXES;
+	if (current_texture_id == prefetched_skybox)
+		prefetched_skybox = NUM_SKYBOXES;
+	load(current_texture_id, true);
+}
+
+void SkyboxShader::prefetch(GLuint skybox)
+{
+	// Called every tick near a portal; the target cannot be evicted, so one request is enough.
+	skybox %= NUM_SKYBOXES;
+	if (skybox == prefetched_skybox || skybox == current_texture_id)
+		return;
+	prefetched_skybox = skybox;
+	load(skybox, true);
+}
+
 void SkyboxShader::set_material(Material m)
 {
 
@@ -121,19 +202,17 @@ void SkyboxShader::set_material(Material m)
 
 void SkyboxShader::draw(Geometry *g, glm::mat4 to_world)
 {
-	glDepthMask(GL_FALSE);
-	// Strip translation from view matrix.
-	glm::mat4 view = glm::mat4(glm::mat3(V));
-
-	// Send projection and view matrices
-	glUniformMatrix4fv(glGetUniformLocation(shader_id, "projection"), 1, GL_FALSE, &P[0][0]);
-	glUniformMatrix4fv(glGetUniformLocation(shader_id, "view"), 1, GL_FALSE, &view[0][0]);
+	GLState::depth_mask(GL_FALSE);
 	// Bind geometry and draw
-	glBindVertexArray(VAO);
-	glActiveTexture(GL_TEXTURE0);
-	glUniform1i(glGetUniformLocation(shader_id, "skybox"), 0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, texture_ids[current_texture_id]);
+	GLState::bind_vertex_array(VAO);
+	// Until the selected skybox arrives, the last one shown stays up.
+	Cubemap &current = cubemaps[current_texture_id];
+	if (current.ready)
+	{
+		current.last_used = ++use_clock;
+		shown_skybox = current_texture_id;
+	}
+	GLState::bind_texture(0, GL_TEXTURE_CUBE_MAP, cubemaps[shown_skybox].texture);
 	glDrawArrays(GL_TRIANGLES, 0, 36);
-	glBindVertexArray(0);
-	glDepthMask(GL_TRUE);
+	GLState::depth_mask(GL_TRUE);
 }
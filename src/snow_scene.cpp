@@ -4,6 +4,7 @@
 #include "util.h"
 #include "terrain.h"
 #include "geometry_generator.h"
+#include "scene_terrain.h"
 #include "shape_grammar.h"
 #include "tree.h"
 #include "scene_animation.h"
@@ -13,11 +14,11 @@ const GLfloat PLAYER_HEIGHT = Global::PLAYER_HEIGHT;
 const GLuint    HEIGHT_MAP_POWER = 8;
 const GLuint    HEIGHT_MAP_SIZE = (unsigned int)glm::pow(2, HEIGHT_MAP_POWER) + 1;
 const GLint     VILLAGE_DIAMETER = 1;
-const GLuint    TERRAIN_RESOLUTION = 400;
 
 const GLuint    NUM_TREES = 100;
 const GLfloat   PERCENT_TREE_ANIM = 0.9f;
 const GLfloat   TREE_SCALE = 1.5f;
+const GLuint    NUM_TREE_VARIANTS = 8;
 
 const GLfloat   SIZE = 30.f * PLAYER_HEIGHT;
 const GLfloat   HEIGHT_MAP_MAX = 0.f;
@@ -61,7 +62,7 @@ void SnowScene::setup()
 	float z = 30.f;
 	float y = Terrain::height_lookup(x, z, SIZE * 2, height_map);
 	glm::vec3 location = { x, y, z };
-	SceneModel *building = ShapeGrammar::generate_building(this, true, 0);
+	SceneModel *building = ShapeGrammar::generate_building(this, true, rng.fork());
 	SceneTransform *building_rotate = new SceneTransform(this, glm::rotate(glm::mat4(1.f), glm::radians(-87.f), glm::vec3(0.f, 1.f, 0.f)));
 	SceneTransform *building_translate = new SceneTransform(this, glm::translate(glm::mat4(1.f), location));
 	building_rotate->add_child(building);
@@ -80,7 +81,7 @@ void SnowScene::generate_planes()
 {
 	/*
 	// Curvy beach plane, named Bezier Beach Resort
-	Geometry *beach_geo = GeometryGenerator::generate_bezier_plane(SIZE*1.5f, 50, 150, 0.1f, SAND, 0);
+	Geometry *beach_geo = GeometryGenerator::generate_bezier_plane(SIZE*1.5f, 50, 150, 0.1f, SAND, rng.next());
 	Material beach_material;
 	beach_material.diffuse = beach_material.ambient = color::windwaker_sand;
 	beach_material.shadows = false;
@@ -95,6 +96,11 @@ void SnowScene::generate_planes()
 	*/
 }
 
+void SnowScene::prepare()
+{
+	height_map = Terrain::generate_height_map(HEIGHT_MAP_SIZE, HEIGHT_MAP_MAX, VILLAGE_DIAMETER, HEIGHT_RANDOMNESS_SCALE, false, true, TERRAIN_SMOOTHNESS, rng.next());
+}
+
 void SnowScene::generate_map()
 {
 	std::cerr << "Generating Map...";
@@ -109,16 +115,11 @@ void SnowScene::generate_map()
 		map->remove_all();
 	}
 
-	height_map = Terrain::generate_height_map(HEIGHT_MAP_SIZE, HEIGHT_MAP_MAX, VILLAGE_DIAMETER, HEIGHT_RANDOMNESS_SCALE, false, true, TERRAIN_SMOOTHNESS, 0);
-
-	Geometry *sand_geo = GeometryGenerator::generate_terrain(TERRAIN_SIZE, TERRAIN_RESOLUTION, -100.f, 100.f, false, SNOW, height_map);
 	Material sand_material;
 	sand_material.diffuse = sand_material.ambient = color::windwaker_sand;
-	Mesh sand_mesh = { sand_geo, sand_material, ShaderManager::get_default(), glm::mat4(1.f) };
-
-	SceneModel *terrain_model = new SceneModel(this);
-	terrain_model->add_mesh(sand_mesh);
-	map->add_child(terrain_model);
+	SceneTerrain *terrain = new SceneTerrain(this, TERRAIN_SIZE, height_map, sand_material);
+	terrain->add_band(-100.f, 100.f, SNOW, false);
+	map->add_child(terrain);
 	std::cerr << "OK." << std::endl;
 }
 void SnowScene::generate_forest()
@@ -140,7 +141,8 @@ void SnowScene::generate_forest()
 
 	glm::vec3 leaf_colors[] = { color::bone_white};
 	glm::vec3 branch_colors[] = { color::brown, color::wood_saddle, color::wood_sienna, color::wood_tan, color::wood_tan_light };
-	Material branch_material, leaf_material;
+	std::vector<TreeInstance> trees;
+	Random forest_rng = rng.fork();
 	float angle = 0.0f;
 	for (int i = 0; i < NUM_TREES; ++i)
 	{
@@ -148,15 +150,16 @@ void SnowScene::generate_forest()
 			std::cerr << " . ";
 
 		// Randomise colours, animation, location.
-		leaf_material.diffuse = leaf_material.ambient = leaf_colors[0];
-		branch_material.diffuse = branch_material.ambient = branch_colors[(int)Util::random(0, 5)];
+		TreeInstance tree;
+		tree.leaf_color = leaf_colors[0];
+		tree.branch_color = branch_colors[(int)forest_rng.random(0, 5)];
 		bool animated = false;
 		if (i % (NUM_TREES / (int)(NUM_TREES*PERCENT_TREE_ANIM)) == 0)
 			animated = true;
 		float x, z;
 
 		angle += 360.f / NUM_TREES;
-		float distance = Util::random(FOREST_INNER_CIRCLE, FOREST_RADIUS);
+		float distance = forest_rng.random(FOREST_INNER_CIRCLE, FOREST_RADIUS);
 
 		x = glm::cos(glm::radians(angle)) * distance;
 		z = glm::sin(glm::radians(angle)) * distance;
@@ -164,15 +167,11 @@ void SnowScene::generate_forest()
 		float y = Terrain::height_lookup(x, z, SIZE * 2, height_map);
 		glm::vec3 location = { x, y, z };
 
-		// Ugly code below.
-		SceneGroup *tree = Tree::generate_tree(this, cylinder_geo, diamond_geo, 7, 1, 20.f, 2.f, branch_material, leaf_material, animated, location, 0);
-		((SceneModel *)(tree->children[0]))->meshes[0].to_world = glm::translate(glm::mat4(1.f), location) * glm::scale(glm::mat4(1.f), glm::vec3(TREE_SCALE));
-		if (animated)
-			((SceneModel *)((SceneAnimation *)(tree->children[1]))->children[0])->meshes[0].to_world = glm::translate(glm::mat4(1.f), location) * glm::scale(glm::mat4(1.f), glm::vec3(TREE_SCALE));
-		else
-			((SceneModel *)(tree->children[1]))->meshes[0].to_world = glm::translate(glm::mat4(1.f), location) * glm::scale(glm::mat4(1.f), glm::vec3(TREE_SCALE));
-		// Phew.
-		forest->add_child(tree);
+		// Spin each instance so repeated variants don't line up.
+		tree.to_world = glm::translate(glm::mat4(1.f), location) * glm::rotate(glm::mat4(1.f), glm::radians(forest_rng.random(0, 360)), glm::vec3(0.f, 1.f, 0.f)) * glm::scale(glm::mat4(1.f), glm::vec3(TREE_SCALE));
+		tree.animated = animated;
+		trees.push_back(tree);
 	}
+	forest->add_child(Tree::generate_forest(this, cylinder_geo, diamond_geo, NUM_TREE_VARIANTS, 7, 1, 20.f, 2.f, trees, forest_rng.fork()));
 	std::cerr << "OK." << std::endl;
 }
\ No newline at end of file
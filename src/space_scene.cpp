@@ -4,6 +4,7 @@
 #include "util.h"
 #include "terrain.h"
 #include "geometry_generator.h"
+#include "scene_terrain.h"
 #include "shape_grammar.h"
 
 const GLfloat PLAYER_HEIGHT = Global::PLAYER_HEIGHT;
@@ -11,7 +12,6 @@ const GLfloat PLAYER_HEIGHT = Global::PLAYER_HEIGHT;
 const GLuint    HEIGHT_MAP_POWER = 8;
 const GLuint    HEIGHT_MAP_SIZE = (unsigned int)glm::pow(2, HEIGHT_MAP_POWER) + 1;
 const GLint     VILLAGE_DIAMETER = 120;
-const GLuint    TERRAIN_RESOLUTION = 400;
 
 const GLfloat   SIZE = 80.f * PLAYER_HEIGHT;
 const GLfloat   WATER_SCALE = SIZE * 4;
@@ -52,7 +52,7 @@ void SpaceScene::setup()
 	float z = -20.f;
 	float y = Terrain::height_lookup(x, z, SIZE * 2, height_map);
 	glm::vec3 location = { x, y, z };
-	SceneModel *building = ShapeGrammar::generate_building(this, true, 0);
+	SceneModel *building = ShapeGrammar::generate_building(this, true, rng.fork());
 	SceneTransform *building_rotate = new SceneTransform(this, glm::rotate(glm::mat4(1.f), glm::radians(27.f), glm::vec3(0.f, 1.f, 0.f)));
 	SceneTransform *building_translate = new SceneTransform(this, glm::translate(glm::mat4(1.f), location));
 	building_rotate->add_child(building);
@@ -71,7 +71,7 @@ void SpaceScene::generate_planes()
 {
 	/*
 	// Curvy beach plane, named Bezier Beach Resort
-	Geometry *beach_geo = GeometryGenerator::generate_bezier_plane(SIZE*1.5f, 50, 150, 0.1f, SAND, 0);
+	Geometry *beach_geo = GeometryGenerator::generate_bezier_plane(SIZE*1.5f, 50, 150, 0.1f, SAND, rng.next());
 	Material beach_material;
 	beach_material.diffuse = beach_material.ambient = color::windwaker_sand;
 	beach_material.shadows = false;
@@ -86,22 +86,22 @@ void SpaceScene::generate_planes()
 	*/
 }
 
+void SpaceScene::prepare()
+{
+	height_map = Terrain::generate_height_map(HEIGHT_MAP_SIZE, 0.f, VILLAGE_DIAMETER, HEIGHT_RANDOMNESS_SCALE, false, false, TERRAIN_SMOOTHNESS, rng.next());
+}
+
 void SpaceScene::generate_map()
 {
 	std::cerr << "Generating Map...";
 
 	SceneTransform *map = new SceneTransform(this, glm::scale(glm::mat4(1.f), glm::vec3(TERRAIN_SCALE, 1.f, TERRAIN_SCALE)));
 	root->add_child(map);
-
-	height_map = Terrain::generate_height_map(HEIGHT_MAP_SIZE, 0.f, VILLAGE_DIAMETER, HEIGHT_RANDOMNESS_SCALE, false, false, TERRAIN_SMOOTHNESS, 0);
 	
-	Geometry *sand_geo = GeometryGenerator::generate_terrain(TERRAIN_SIZE, TERRAIN_RESOLUTION, -HEIGHT_MAP_MAX, HEIGHT_MAP_MAX, false, ROCK, height_map);
 	Material sand_material;
 	sand_material.diffuse = sand_material.ambient = color::windwaker_sand;
-	Mesh sand_mesh = { sand_geo, sand_material, ShaderManager::get_default(), glm::mat4(1.f) };
-
-	SceneModel *terrain_model = new SceneModel(this);
-	terrain_model->add_mesh(sand_mesh);
-	map->add_child(terrain_model);
+	SceneTerrain *terrain = new SceneTerrain(this, TERRAIN_SIZE, height_map, sand_material);
+	terrain->add_band(-HEIGHT_MAP_MAX, HEIGHT_MAP_MAX, ROCK, false);
+	map->add_child(terrain);
 	std::cerr << "OK." << std::endl;
 }
\ No newline at end of file
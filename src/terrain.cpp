@@ -1,44 +1,63 @@
 #include "terrain.h"
 #include "util.h"
+#include "job_system.h"
+#include "procedural_cache.h"
 
-float smoothness = 1.2f; //Previously called roughness. higher is smoother, lower is rougher
-bool allow_below_ground = false;
+#include <algorithm>
+#include <cstdint>
 
-std::vector<std::vector<GLfloat> > Terrain::generate_height_map(GLuint size, GLfloat max_height, GLint village_diameter, GLfloat scale, bool ramp, bool allow_dips, float smooth_value, GLuint seed = 0)
-{
-	std::vector<std::vector<GLfloat> > height_map;
-	unsigned int middle = ((size - 1) / 2); //Size is always odd
+// Maps with more samples per side than this are stored tiled.
+const GLuint TILED_HEIGHT_MAP_SIZE = 1025;
+// Fewest rows of a level handed to each generation job.
+const unsigned int MIN_ROWS_PER_JOB = 16;
 
-	smoothness = smooth_value;
-	allow_below_ground = allow_dips;
-	
-	//All points initialized at -1
-	for (unsigned int i = 0; i < size; i++)
+HeightMap Terrain::generate_height_map(GLuint size, GLfloat max_height, GLint village_diameter, GLfloat scale, bool ramp, bool allow_dips, float smooth_value, GLuint seed = 0)
+{
+	CacheKey key("height_map");
+	key << size << max_height << village_diameter << scale << ramp << allow_dips << smooth_value << seed;
+	MappedFile file;
+	CacheReader reader;
+	if (ProceduralCache::load(key, file, reader))
 	{
-		height_map.push_back(std::vector<GLfloat>());
-		for (unsigned int j = 0; j < size; j++)
-		{
-			height_map[i].push_back(-1.f);
-		}
+		// Stored in memory order, so the layout has to match too.
+		HeightMap height_map(size, 0.f, size > TILED_HEIGHT_MAP_SIZE);
+		uint64_t count;
+		if (reader.read(count) && count == height_map.storage_size()
+			&& reader.read(height_map.storage(), height_map.storage_size() * sizeof(GLfloat)) && reader.done())
+			return height_map;
 	}
 
+	HeightMap height_map = build_height_map(size, max_height, village_diameter, scale, ramp, allow_dips, smooth_value, seed);
+	CacheWriter writer;
+	writer.write((uint64_t) height_map.storage_size());
+	writer.write(height_map.storage(), height_map.storage_size() * sizeof(GLfloat));
+	ProceduralCache::store(key, writer);
+	return height_map;
+}
+
+HeightMap Terrain::build_height_map(GLuint size, GLfloat max_height, GLint village_diameter, GLfloat scale, bool ramp, bool allow_dips, float smooth_value, GLuint seed)
+{
+	// Large maps are tiled so the neighbourhoods read by each step share cache lines.
+	HeightMap height_map(size, -1.f, size > TILED_HEIGHT_MAP_SIZE); //All points initialized at -1
+	unsigned int middle = ((size - 1) / 2); //Size is always odd
+
 	//fprintf(stderr, "Height Map Size: %d\t%d\t%d\n", size, height_map.size(), height_map[1].size());
-	//fprintf(stderr, "Test Value: %f\n", height_map[0][0]);
+	//fprintf(stderr, "Test Value: %f\n", height_map.at(0, 0));
 	//fprintf(stderr, "Height Map Size: %d\t%f\n", test.size(), test[0]);
 
 	//Initialize Four corners to be ground level
-	height_map[0][0] = 0;
-	height_map[0][size - 1] = 0;
-	height_map[size - 1][0] = 0;
-	height_map[size - 1][size - 1] = 0;
+	height_map.at(0, 0) = 0;
+	height_map.at(0, size - 1) = 0;
+	height_map.at(size - 1, 0) = 0;
+	height_map.at(size - 1, size - 1) = 0;
 
 	//Initialize all sides ot be ground level
 	for (unsigned int i = 0; i < size; i++)
 	{
-		height_map[0][i] = 0;
-		height_map[size - 1][i] = 0;
-		height_map[i][0] = 0;
-		height_map[i][size - 1] = 0;
+		height_map.at(0, i) = 0;
+		height_map.at(size - 1, i) = 0;
+		height_map.at(i, 0) = 0;
+		height_map.at(i, size - 1) = 0;
 	}
 
 	//Offset of Village on Island, Round Plateau.
@@ -57,32 +76,32 @@ std::vector<std::vector<GLfloat> > Terrain::generate_height_map(GLuint size, GLf
 			//fprintf(stderr, "Dist: %f\n", dist);
 			if (dist <= radius)
 			{
-				height_map[r][c] = max_height;
+				height_map.at(r, c) = max_height;
 			}
 		}
 	}
 	
 	//Square Plateau
-	//height_map[middle][middle] = max_height;
+	//height_map.at(middle, middle) = max_height;
 	////For now, square plateau
 	//unsigned int village_mid = village_diameter / 2;
 	//for (unsigned int i = middle - village_mid; i <= middle + village_mid; i++)
 	//{
 	//	for (unsigned int j = middle - village_mid; j <= middle + village_mid; j++)
 	//	{
-	//		height_map[i][j] = max_height;
+	//		height_map.at(i, j) = max_height;
 	//	}
 	//}
 
 
 	//Diamond Square Algorithm
-	if (seed != 0)
-		srand(seed);
-
-	unsigned int stepsize = size - 1;
+	//Noise is hashed from the seed, so the same seed always gives the same map. Without one,
+	//draw a fresh seed so regenerating still changes the map.
+	if (seed == 0)
+		seed = (GLuint) Util::random(1.f, 16777216.f);
 
-	//Recursively creates height map
-	diamond_square(stepsize, size, scale, height_map);
+	//Creates height map level by level
+	diamond_square(size, scale, smooth_value, allow_dips, seed, height_map);
 
 	//Depresses the Plateau for a cooler effect!
 	max_height *= 0.8f; //Amount of depression.
@@ -95,7 +114,7 @@ std::vector<std::vector<GLfloat> > Terrain::generate_height_map(GLuint size, GLf
 			//fprintf(stderr, "Dist: %f\n", dist);
 			if (dist <= radius)
 			{
-				height_map[r][c] = max_height;
+				height_map.at(r, c) = max_height;
 			}
 		}
 	}	
@@ -117,12 +136,12 @@ std::vector<std::vector<GLfloat> > Terrain::generate_height_map(GLuint size, GLf
 			{
 				if (c <= village_mid_c + radius + start_slope)
 				{
-					height_map[r][c] = max_height;
+					height_map.at(r, c) = max_height;
 				}
 				else
 				{
-					float diff = max_height - height_map[r][c];
-					height_map[r][c] = max_height - (diff * (1.f - ratio));
+					float diff = max_height - height_map.at(r, c);
+					height_map.at(r, c) = max_height - (diff * (1.f - ratio));
 				}
 			}
 		}
@@ -131,40 +150,57 @@ std::vector<std::vector<GLfloat> > Terrain::generate_height_map(GLuint size, GLf
 	return height_map;
 }
 
-void Terrain::diamond_square(unsigned int step, unsigned int size, float scale, std::vector<std::vector<GLfloat> > &height_map)
+void Terrain::diamond_square(unsigned int size, float scale, float smoothness, bool allow_dips, GLuint seed, HeightMap &height_map)
 {
-	if (step <= 1)
-		return;
+	for (unsigned int step = size - 1; step > 1; step /= 2)
+	{
+		unsigned int halfstep = step / 2;
+		unsigned int squares = (size - 1) / step;
 
-	unsigned int halfstep = step / 2;
+		//Diamond steps only read corners from earlier levels, so every row can run at once
+		JobSystem::parallel_for(squares, MIN_ROWS_PER_JOB, [&](unsigned int begin, unsigned int end) {
+			for (unsigned int i = begin; i < end; ++i)
+			{
+				unsigned int x = halfstep + i * step;
+				for (unsigned int y = halfstep; y < size; y += step)
+					diamond_step(x, y, step, size, scale, allow_dips, seed, height_map);
+			}
+		});
 
-	for (unsigned int x = halfstep; x < size; x += step)
-	{
-		for (unsigned int y = halfstep; y < size; y += step)
-		{
-			diamond_step(x, y, step, size, Util::random(-1.f, 1.f) * scale, height_map);
-		}
-	}
+		//Square steps only read corners and this level's diamond centres
+		JobSystem::parallel_for(squares + 1, MIN_ROWS_PER_JOB, [&](unsigned int begin, unsigned int end) {
+			for (unsigned int i = begin; i < end; ++i)
+			{
+				unsigned int x = i * step;
+				for (unsigned int y = 0; y < size; y += step)
+				{
+					if (x + halfstep < size)
+						square_step(x + halfstep, y, step, size, scale, allow_dips, seed, height_map);
+					if (y + halfstep < size)
+						square_step(x, y + halfstep, step, size, scale, allow_dips, seed, height_map);
+				}
+			}
+		});
 
-	for (unsigned int x = 0; x < size; x += step)
-	{
-		for (unsigned int y = 0; y < size; y += step)
-		{
-			if (x + halfstep < size)
-				square_step(x + halfstep, y, step, size, Util::random(-1.f, 1.f)  *scale, height_map);
-			if (y + halfstep < size)
-				square_step(x, y + halfstep, step, size, Util::random(-1.f, 1.f)  *scale, height_map);
-		}
+		scale *= (float)glm::pow(2.f, -smoothness);
 	}
+}
 
-	scale *= (float)glm::pow(2.f, -smoothness);
-
-	diamond_square(step / 2, size, scale, height_map);
+float Terrain::noise(GLuint seed, unsigned int x, unsigned int y, unsigned int step, unsigned int channel)
+{
+	//Counter-based: a SplitMix64 finaliser over the point's coordinates, so values never depend on evaluation order
+	uint64_t h = ((uint64_t) seed << 32) ^ ((uint64_t) step << 8) ^ channel;
+	h ^= ((uint64_t) x << 32 | y) * 0x9E3779B97F4A7C15ull;
+	h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+	h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+	h ^= h >> 31;
+	//Top 24 bits give an exact float in [0, 1)
+	return (float) (h >> 40) / 16777216.f;
 }
 
-void Terrain::diamond_step(unsigned int x, unsigned int y, unsigned int step, unsigned int size, float scale, std::vector<std::vector<GLfloat> > &height_map)
+void Terrain::diamond_step(unsigned int x, unsigned int y, unsigned int step, unsigned int size, float scale, bool allow_dips, GLuint seed, HeightMap &height_map)
 {
-	if (height_map[x][y] != -1)
+	if (height_map.at(x, y) != -1)
 		return;
 
 	//fprintf(stderr, "Diamond on point %u, %u\n", x, y, size);
@@ -181,38 +217,37 @@ void Terrain::diamond_step(unsigned int x, unsigned int y, unsigned int step, un
 	float num = 4.0f;	
 
 	if (x >= halfstep && y >= halfstep)
-		a = height_map[x - halfstep][y - halfstep];
+		a = height_map.at(x - halfstep, y - halfstep);
 	else
 		a = 0;
 	if (x + halfstep < size && y >= halfstep)
-		b = height_map[x + halfstep][y - halfstep];
+		b = height_map.at(x + halfstep, y - halfstep);
 	else
 		b = 0;
 	if (x >= halfstep && y + halfstep < size)
-		c = height_map[x - halfstep][y + halfstep];
+		c = height_map.at(x - halfstep, y + halfstep);
 	else
 		c = 0;
 	if (x + halfstep < size && y + halfstep < size)
-		d = height_map[x + halfstep][y + halfstep];
+		d = height_map.at(x + halfstep, y + halfstep);
 	else
 		d = 0;
 
-	//float r = (float)(rand() % 101) / 100.f;
-	float r = Util::random(0.f, 1.f);
-	//fprintf(stderr, "Random: %f\n", r);
+	//Same distribution as before: a uniform [-1, 1] amplitude times a uniform [0, 1] offset
+	float r = (noise(seed, x, y, step, 0) * 2.f - 1.f) * noise(seed, x, y, step, 1);
 
 	//fprintf(stderr, "Using: %.2f, %.2f, %.2f, %.2f and %.2f\n", a, b, c, d, num);
 
 	float sum = (a + b + c + d);
 
-	height_map[x][y] = (sum / num) +(r * scale);
-	if (!allow_below_ground && height_map[x][y] < 0)
-		height_map[x][y] = 0;
+	height_map.at(x, y) = (sum / num) +(r * scale);
+	if (!allow_dips && height_map.at(x, y) < 0)
+		height_map.at(x, y) = 0;
 }
 
-void Terrain::square_step(unsigned int x, unsigned int y, unsigned int step, unsigned int size, float scale, std::vector<std::vector<GLfloat> > &height_map)
+void Terrain::square_step(unsigned int x, unsigned int y, unsigned int step, unsigned int size, float scale, bool allow_dips, GLuint seed, HeightMap &height_map)
 {
-	if (height_map[x][y] != -1)
+	if (height_map.at(x, y) != -1)
 		return;
 
 	//fprintf(stderr, "Square on point %u, %u\n", x, y);
@@ -229,66 +264,36 @@ void Terrain::square_step(unsigned int x, unsigned int y, unsigned int step, uns
 	float num = 4.0f;
 
 	if (x >= halfstep)
-		a = height_map[x - halfstep][y];
+		a = height_map.at(x - halfstep, y);
 	else
 		a = 0;
 	if (x + halfstep < size)
-		b = height_map[x + halfstep][y];
+		b = height_map.at(x + halfstep, y);
 	else
 		b = 0;	
 	if (y >= halfstep)
-		c = height_map[x][y - halfstep];
+		c = height_map.at(x, y - halfstep);
 	else
 		c = 0;	
 	if (y + halfstep < size)
-		d = height_map[x][y + halfstep];
+		d = height_map.at(x, y + halfstep);
 	else
 		d = 0;
 
 	if (x == 0 || y == 0 || x == size - 1 || y == size - 1)
 		num = 3.0f;
 		
-	float r = Util::random(0.f, 1.f);
+	float r = (noise(seed, x, y, step, 0) * 2.f - 1.f) * noise(seed, x, y, step, 1);
 
 	float sum = (a + b + c + d);
 
-	height_map[x][y] = (sum / num) +(r * scale);
-	if (!allow_below_ground && height_map[x][y] < 0)
-		height_map[x][y] = 0;
+	height_map.at(x, y) = (sum / num) +(r * scale);
+	if (!allow_dips && height_map.at(x, y) < 0)
+		height_map.at(x, y) = 0;
 }
 
-float Terrain::height_lookup(float x, float y, float length, std::vector<std::vector<GLfloat> > &height_map)
+float Terrain::height_lookup(float x, float y, float length, const HeightMap &height_map)
 {
 	//Assumes that terrain will be centered at origin and that terrain is square
-
-	//fprintf(stderr, "Orig: %f, %f\n", x, y);
-
-	//Translate to height_map coordinates
-	float mid = length / 2.f;
-	x = ((x + mid) / length) * ((float) height_map.size() - 1.f);
-	y = ((y + mid) / length) * ((float) height_map.size() - 1.f);
-
-	int x0 = (int) floorf(x);
-	int x1 = (int) ceilf(x);
-	int y0 = (int) floorf(y);
-	int y1 = (int) ceilf(y);
-
-	float rx, ry; //Ratios
-
-	//Bilinear Interpolation
-	if (x1 != x0)
-		rx = (x - x0) / (x1 - x0);
-	else
-		rx = 0.0f;
-	if (y1 != y0)
-		ry = (y - y0) / (y1 - y0);
-	else
-		ry = 0.0f;
-
-	//fprintf(stderr, "Test: %d, %d, %d, %d, %f, %f\n", x0, x1, y0, y1, x, y);
-
-	float h0 = (height_map[x0][y0] * (1.f - rx)) + (height_map[x1][y0] * rx);
-	float h1 = (height_map[x0][y1] * (1.f - rx)) + (height_map[x1][y1] * rx);
-
-	return (h0 * (1.f - ry)) + (h1 * ry);
+	return height_map.sample(x, y, length);
 }
@@ -0,0 +1,69 @@
+#include "terrain_shader.h"
+#include "scene_terrain.h"
+#include "shader_manager.h"
+#include "shadow_shader.h"
+#include "gl_state.h"
+#include "texture_cache.h"
+
+#include <string>
+
+TerrainShader::TerrainShader(GLuint shader_id) : Shader(shader_id)
+{
+	material_specular_loc = uniform("material.specular");
+	material_shininess_loc = uniform("material.shininess");
+	shadows_enabled_loc = uniform("shadows_enabled");
+	model_loc = uniform("model");
+	terrain_size_loc = uniform("terrain_size");
+	height_map_size_loc = uniform("height_map_size");
+	lod_origin_loc = uniform("lod_origin");
+	bands_loc = uniform("bands");
+	band_count_loc = uniform("band_count");
+	shadow_map_loc = uniform("shadow_map");
+
+	// Sampler units never change, so set them once.
+	GLState::use_program(shader_id);
+	set_uniform(shadow_map_loc, 0);
+	set_uniform(uniform("height_map"), (GLint) HEIGHT_TEXTURE_UNIT);
+	for (GLuint i = 0; i < MAX_TERRAIN_BANDS; ++i)
+		set_uniform(uniform(("band_texture" + std::to_string(i)).c_str()), (GLint) (BAND_TEXTURE_UNIT + i));
+	GLState::use_program(0);
+}
+
+void TerrainShader::set_material(Material m)
+{
+	// Bands are always textured, so only the specular terms are used.
+	set_uniform(material_specular_loc, m.specular);
+	set_uniform(material_shininess_loc, m.shininess);
+	set_uniform(shadows_enabled_loc, (GLint) m.shadows);
+}
+
+void TerrainShader::draw_terrain(SceneTerrain *terrain, glm::mat4 to_world)
+{
+	// Only the colour program samples the shadow map; the depth program renders into it.
+	ShadowShader * ss = (ShadowShader *) ShaderManager::get_shader_program("shadow");
+	if (ss && shadow_map_loc != -1)
+		GLState::bind_texture(0, GL_TEXTURE_2D, ss->shadow_map_tex);
+
+	set_uniform(model_loc, to_world);
+	set_uniform(terrain_size_loc, terrain->size);
+	set_uniform(height_map_size_loc, (GLfloat) terrain->height_map_size);
+	set_uniform(lod_origin_loc, terrain->lod_origin);
+	GLState::bind_texture(HEIGHT_TEXTURE_UNIT, GL_TEXTURE_2D, terrain->height_texture);
+
+	glm::vec4 bands[MAX_TERRAIN_BANDS];
+	GLsizei band_count = (GLsizei) terrain->bands.size();
+	for (GLsizei i = 0; i < band_count; ++i)
+	{
+		const TerrainBand &band = terrain->bands[i];
+		bands[i] = glm::vec4(band.min_height, band.max_height, band.normals_up ? 1.f : 0.f, 0.f);
+		if (band_count_loc != -1)
+			GLState::bind_texture(BAND_TEXTURE_UNIT + i, GL_TEXTURE_2D, TextureCache::drawable(band.texture));
+	}
+	set_uniform(band_count_loc, (GLint) band_count);
+	if (band_count)
+		set_uniform(bands_loc, bands, band_count);
+
+	InstanceBatch batch = terrain->batch();
+	GLState::bind_vertex_array(batch.vao);
+	SceneTerrain::patch->draw_instanced(batch.count);
+}
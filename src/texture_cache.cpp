@@ -0,0 +1,105 @@
+#include "texture_cache.h"
+#include "geometry.h"
+#include "gl_state.h"
+#include "resource_loader.h"
+#include "texture_data.h"
+
+#include <map>
+#include <set>
+#include <tuple>
+
+typedef std::tuple<std::string, GLint, GLint> TextureKey;
+
+struct CachedTexture
+{
+	GLuint texture;
+	int references;
+};
+
+std::map<TextureKey, CachedTexture> cached_textures;
+std::map<GLuint, TextureKey> texture_keys;
+// Textures still on their way.
+std::set<GLuint> loading_textures;
+// Released while loading; deleted once the loader is done with them.
+std::set<GLuint> orphaned_textures;
+GLuint placeholder_texture = 0;
+
+// Flat grey, bound in place of textures that are not ready.
+void create_placeholder()
+{
+	const unsigned char grey[] = { 128, 128, 128 };
+	placeholder_texture = Geometry::create_texture(GL_REPEAT, GL_NEAREST);
+	GLState::bind_texture(0, GL_TEXTURE_2D, placeholder_texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, grey);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	GLState::bind_texture(0, GL_TEXTURE_2D, 0);
+}
+
+void delete_texture(GLuint texture)
+{
+	glDeleteTextures(1, &texture);
+	// The name may come back for another texture while still shadowed as bound.
+	GLState::invalidate();
+}
+
+void finish_loading(GLuint texture)
+{
+	loading_textures.erase(texture);
+	if (orphaned_textures.erase(texture))
+		delete_texture(texture);
+}
+
+GLuint TextureCache::acquire(const std::string &path, GLint wrap_type, GLint filter_type)
+{
+	TextureKey key(path, wrap_type, filter_type);
+	auto it = cached_textures.find(key);
+	if (it != cached_textures.end())
+	{
+		it->second.references++;
+		return it->second.texture;
+	}
+
+	GLuint texture;
+	if (ResourceLoader::running())
+	{
+		if (!placeholder_texture)
+			create_placeholder();
+		texture = Geometry::create_texture(wrap_type, filter_type);
+		loading_textures.insert(texture);
+		ResourceLoader::load_texture(texture, [path](TextureData &data) { data.load(path); }, [texture](size_t) { finish_loading(texture); });
+	}
+	else
+	{
+		texture = Geometry::load_texture(path.c_str(), wrap_type, filter_type);
+	}
+	cached_textures[key] = { texture, 1 };
+	texture_keys[texture] = key;
+	return texture;
+}
+
+void TextureCache::release(GLuint texture)
+{
+	auto key = texture_keys.find(texture);
+	if (key == texture_keys.end())
+		return;
+	auto it = cached_textures.find(key->second);
+	if (--it->second.references > 0)
+		return;
+	cached_textures.erase(it);
+	texture_keys.erase(key);
+	if (loading_textures.count(texture))
+		orphaned_textures.insert(texture);
+	else
+		delete_texture(texture);
+}
+
+bool TextureCache::ready(GLuint texture)
+{
+	return loading_textures.find(texture) == loading_textures.end();
+}
+
+GLuint TextureCache::drawable(GLuint texture)
+{
+	return loading_textures.empty() || ready(texture) ? texture : placeholder_texture;
+}
@@ -0,0 +1,240 @@
+#include "texture_compression.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+extern "C" {
+#include "image_DXT.h"
+}
+
+const unsigned int DDS_MAGIC = 0x20534444; // "DDS "
+const unsigned int FOURCC_DXT1 = 0x31545844;
+const unsigned int FOURCC_DXT5 = 0x35545844;
+const unsigned int FOURCC_DX10 = 0x30315844;
+// DXGI formats that can follow a DX10 header.
+const unsigned int DXGI_BC1_UNORM = 71;
+const unsigned int DXGI_BC3_UNORM = 77;
+const unsigned int DXGI_BC7_UNORM = 98;
+const size_t DX10_HEADER_SIZE = 20;
+
+bool TextureCompression::supported(GLenum format)
+{
+	switch (format)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		return GLEW_EXT_texture_compression_s3tc != 0;
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+		return GLEW_ARB_texture_compression_bptc != 0;
+	default:
+		return !is_compressed(format);
+	}
+}
+
+bool TextureCompression::is_compressed(GLenum format)
+{
+	return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+		|| format == GL_COMPRESSED_RGBA_BPTC_UNORM;
+}
+
+size_t TextureCompression::level_size(GLenum format, GLuint width, GLuint height, GLuint level)
+{
+	size_t w = std::max(width >> level, 1u);
+	size_t h = std::max(height >> level, 1u);
+	switch (format)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		return ((w + 3) / 4) * ((h + 3) / 4) * 8;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+		return ((w + 3) / 4) * ((h + 3) / 4) * 16;
+	default:
+		return w * h * 3;
+	}
+}
+
+bool TextureCompression::parse_dds(const unsigned char *data, size_t size, CompressedImage &image)
+{
+	DDS_header header;
+	if (size < sizeof(header))
+		return false;
+	memcpy(&header, data, sizeof(header));
+	if (header.dwMagic != DDS_MAGIC || header.dwSize != sizeof(header) - sizeof(header.dwMagic)
+		|| !(header.sPixelFormat.dwFlags & DDPF_FOURCC) || (header.sCaps.dwCaps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)))
+		return false;
+
+	size_t offset = sizeof(header);
+	switch (header.sPixelFormat.dwFourCC)
+	{
+	case FOURCC_DXT1:
+		image.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		break;
+	case FOURCC_DXT5:
+		image.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		break;
+	case FOURCC_DX10:
+	{
+		unsigned int dxgi_format;
+		if (size < offset + DX10_HEADER_SIZE)
+			return false;
+		memcpy(&dxgi_format, data + offset, sizeof(dxgi_format));
+		offset += DX10_HEADER_SIZE;
+		if (dxgi_format == DXGI_BC1_UNORM)
+			image.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		else if (dxgi_format == DXGI_BC3_UNORM)
+			image.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		else if (dxgi_format == DXGI_BC7_UNORM)
+			image.format = GL_COMPRESSED_RGBA_BPTC_UNORM;
+		else
+			return false;
+		break;
+	}
+	default:
+		return false;
+	}
+
+	image.width = header.dwWidth;
+	image.height = header.dwHeight;
+	image.levels = (header.dwFlags & DDSD_MIPMAPCOUNT) && header.dwMipMapCount > 0 ? header.dwMipMapCount : 1;
+	image.data = data + offset;
+	if (image.width == 0 || image.height == 0)
+		return false;
+
+	size_t needed = offset;
+	for (GLuint level = 0; level < image.levels; ++level)
+		needed += level_size(image.format, image.width, image.height, level);
+	return size >= needed;
+}
+
+bool TextureCompression::load_dds(const std::string &path, TextureData &data)
+{
+	MappedFile file;
+	CompressedImage image;
+	if (!file.open(path))
+		return false;
+	if (!parse_dds(file.data(), file.size(), image))
+	{
+		std::cerr << path << " is not a DDS file the game can upload directly." << std::endl;
+		return false;
+	}
+	if (!supported(image.format))
+		return false;
+
+	data.target = GL_TEXTURE_2D;
+	data.format = image.format;
+	data.generate_mipmaps = false;
+	data.storage.assign(image.data, file.data() + file.size());
+	data.levels.clear();
+	GLuint levels = image.levels;
+	// GL cannot generate mipmaps for compressed textures, so a lone BC1 level gets its
+	// chain built here. Other formats keep the one level and upload caps the texture at it.
+	if (levels == 1 && image.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+	{
+		data.storage.resize(level_size(image.format, image.width, image.height, 0));
+		std::vector<unsigned char> pixels = decode_bc1(data.storage.data(), image.width, image.height);
+		while ((std::max(image.width, image.height) >> levels) > 0)
+		{
+			GLuint width = std::max(image.width >> (levels - 1), 1u);
+			GLuint height = std::max(image.height >> (levels - 1), 1u);
+			pixels = downsample(pixels, width, height);
+			std::vector<unsigned char> blocks = encode_bc1(pixels.data(), std::max(width / 2, 1u), std::max(height / 2, 1u));
+			if (blocks.size() != level_size(image.format, image.width, image.height, levels))
+			{
+				std::cerr << "Could not build mipmaps for " << path << std::endl;
+				return false;
+			}
+			data.storage.insert(data.storage.end(), blocks.begin(), blocks.end());
+			levels++;
+		}
+	}
+	size_t offset = 0;
+	for (GLuint level = 0; level < levels; ++level)
+	{
+		size_t size = level_size(image.format, image.width, image.height, level);
+		data.levels.push_back({ GL_TEXTURE_2D, (GLint) level, (GLsizei) std::max(image.width >> level, 1u), (GLsizei) std::max(image.height >> level, 1u), data.storage.data() + offset, size });
+		offset += size;
+	}
+	return true;
+}
+
+std::vector<unsigned char> TextureCompression::encode_bc1(const unsigned char *rgb, GLuint width, GLuint height)
+{
+	int size;
+	unsigned char *blocks = convert_image_to_DXT1(rgb, width, height, 3, &size);
+	std::vector<unsigned char> result;
+	if (blocks)
+	{
+		result.assign(blocks, blocks + size);
+		free(blocks);
+	}
+	return result;
+}
+
+std::vector<unsigned char> TextureCompression::decode_bc1(const unsigned char *blocks, GLuint width, GLuint height)
+{
+	std::vector<unsigned char> rgb((size_t) width * height * 3);
+	for (GLuint by = 0; by < height; by += 4)
+	{
+		for (GLuint bx = 0; bx < width; bx += 4, blocks += 8)
+		{
+			unsigned int c0 = blocks[0] | (blocks[1] << 8);
+			unsigned int c1 = blocks[2] | (blocks[3] << 8);
+			unsigned char palette[4][3];
+			for (int i = 0; i < 2; ++i)
+			{
+				unsigned int c = i == 0 ? c0 : c1;
+				palette[i][0] = (unsigned char) (((c >> 11) & 31) * 255 / 31);
+				palette[i][1] = (unsigned char) (((c >> 5) & 63) * 255 / 63);
+				palette[i][2] = (unsigned char) ((c & 31) * 255 / 31);
+			}
+			for (int c = 0; c < 3; ++c)
+			{
+				// The three-colour mode's fourth entry is transparent, which reads as black here.
+				if (c0 > c1)
+				{
+					palette[2][c] = (unsigned char) ((2 * palette[0][c] + palette[1][c] + 1) / 3);
+					palette[3][c] = (unsigned char) ((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+				}
+				else
+				{
+					palette[2][c] = (unsigned char) ((palette[0][c] + palette[1][c]) / 2);
+					palette[3][c] = 0;
+				}
+			}
+			for (GLuint y = 0; y < 4 && by + y < height; ++y)
+			{
+				unsigned char row = blocks[4 + y];
+				for (GLuint x = 0; x < 4 && bx + x < width; ++x)
+					memcpy(&rgb[((size_t) (by + y) * width + bx + x) * 3], palette[(row >> (x * 2)) & 3], 3);
+			}
+		}
+	}
+	return rgb;
+}
+
+std::vector<unsigned char> TextureCompression::downsample(const std::vector<unsigned char> &rgb, GLuint width, GLuint height)
+{
+	GLuint w = std::max(width / 2, 1u);
+	GLuint h = std::max(height / 2, 1u);
+	std::vector<unsigned char> result((size_t) w * h * 3);
+	for (GLuint y = 0; y < h; ++y)
+	{
+		GLuint y0 = std::min(y * 2, height - 1);
+		GLuint y1 = std::min(y * 2 + 1, height - 1);
+		for (GLuint x = 0; x < w; ++x)
+		{
+			GLuint x0 = std::min(x * 2, width - 1);
+			GLuint x1 = std::min(x * 2 + 1, width - 1);
+			for (GLuint c = 0; c < 3; ++c)
+			{
+				unsigned int sum = rgb[((size_t) y0 * width + x0) * 3 + c] + rgb[((size_t) y0 * width + x1) * 3 + c]
+					+ rgb[((size_t) y1 * width + x0) * 3 + c] + rgb[((size_t) y1 * width + x1) * 3 + c];
+				result[((size_t) y * w + x) * 3 + c] = (unsigned char) ((sum + 2) / 4);
+			}
+		}
+	}
+	return result;
+}
@@ -0,0 +1,94 @@
+#include "texture_data.h"
+#include "asset_pack.h"
+#include "texture_compression.h"
+#include "SOIL.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+bool TextureData::load(const std::string &path)
+{
+	if (AssetPack::load_texture(path, *this))
+		return true;
+	bool dds = path.size() > 4 && path.compare(path.size() - 4, 4, ".dds") == 0;
+	if (dds && TextureCompression::load_dds(path, *this))
+		return true;
+
+	int width, height, channels;
+	unsigned char *image = SOIL_load_image(path.c_str(), &width, &height, &channels, SOIL_LOAD_RGB);
+	if (!image)
+	{
+		std::cerr << "Could not load " << path << ": " << SOIL_last_result() << std::endl;
+		return false;
+	}
+	target = GL_TEXTURE_2D;
+	format = GL_RGB;
+	type = GL_UNSIGNED_BYTE;
+	storage.assign(image, image + (size_t) width * height * 3);
+	levels.push_back({ GL_TEXTURE_2D, 0, width, height, storage.data(), storage.size() });
+	generate_mipmaps = true;
+	SOIL_free_image_data(image);
+	return true;
+}
+
+size_t TextureData::size() const
+{
+	size_t total = 0;
+	for (const TextureLevel &level : levels)
+		total += level.size;
+	return total;
+}
+
+void TextureData::upload(GLuint unpack_buffer) const
+{
+	if (levels.empty())
+		return;
+
+	unsigned char *staging = nullptr;
+	if (unpack_buffer)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpack_buffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size(), nullptr, GL_STREAM_DRAW);
+		staging = (unsigned char *) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size(), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (staging)
+		{
+			size_t offset = 0;
+			for (const TextureLevel &level : levels)
+			{
+				memcpy(staging + offset, level.data, level.size);
+				offset += level.size;
+			}
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		else
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+	}
+
+	bool compressed = TextureCompression::is_compressed(format);
+	GLint max_level = 0;
+	size_t offset = 0;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (const TextureLevel &level : levels)
+	{
+		// With a bound unpack buffer the pointer is an offset into it.
+		const void *data = staging ? (const void *) (uintptr_t) offset : level.data;
+		if (compressed)
+			glCompressedTexImage2D(level.target, level.level, format, level.width, level.height, 0, (GLsizei) level.size, data);
+		else
+			glTexImage2D(level.target, level.level, format, level.width, level.height, 0, format, type, data);
+		offset += level.size;
+		max_level = std::max(max_level, level.level);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (staging)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (generate_mipmaps)
+		glGenerateMipmap(target);
+	else
+		glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, max_level);
+}
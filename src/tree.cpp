@@ -2,63 +2,160 @@
 #include "scene_animation.h"
 #include "util.h"
 #include "global.h"
-
-SceneModel *Tree::branch_model;
-SceneModel *Tree::leaf_model;
-Mesh Tree::branch_mesh;
-Mesh Tree::leaf_mesh;
-unsigned int Tree::leaf_layers;
-
-SceneTransform *Tree::translate;
-SceneTransform *Tree::rotate;
-SceneTransform *Tree::scale;
-
-GLfloat angle_delta;
-GLfloat geo_size;
+#include "job_system.h"
+#include "procedural_cache.h"
 
 const GLfloat PLAYER_HEIGHT = Global::PLAYER_HEIGHT;
 const GLfloat SCALE_MIN = PLAYER_HEIGHT * 0.4f;
 const GLfloat SCALE_MAX = PLAYER_HEIGHT * 0.55f;
+const GLfloat SWAY_AMPLITUDE = 3.f;
 
-SceneGroup *Tree::generate_tree(Scene *scene, Geometry *base_branch, Geometry *base_leaf, unsigned int num_iterations, unsigned int leaves, GLfloat angle, GLfloat size, Material branch_material, Material leaf_material, bool animated, glm::vec3 location, int seed = 0)
+SceneGroup *Tree::generate_tree(Scene *scene, Geometry *base_branch, Geometry *base_leaf, unsigned int num_iterations, unsigned int leaves, GLfloat angle, GLfloat size, Material branch_material, Material leaf_material, bool animated, glm::vec3 location, Random rng)
 {
-	angle_delta = angle;
-	leaf_layers = leaves;
-	geo_size = size;
 	SceneGroup *tree_group = new SceneGroup(scene);
 
-	//Set Random Seed
-	if (seed != 0)
-		srand(seed);
+	TreeParts parts;
+	generate_parts(parts, rng, num_iterations, leaves, angle, size);
 
-	//Set Basic Properties
-	branch_mesh = { base_branch, branch_material, ShaderManager::get_default(), glm::mat4(1.0f)};
-	leaf_mesh = { base_leaf, leaf_material, ShaderManager::get_default() , glm::mat4(1.0f) };
-	branch_model = new SceneModel(scene);
-	leaf_model = new SceneModel(scene);
+	// A single untinted instance; the base primitives are drawn once per part.
+	Instance instance = { glm::mat4(1.f), glm::vec4(0.f), glm::vec4(0.f) };
+	if (!parts.branches.empty())
+	{
+		SceneInstances *branches = new SceneInstances(scene, { base_branch, branch_material, ShaderManager::get_default(), glm::mat4(1.0f) });
+		branches->parts = parts.branches;
+		branches->add_instance(instance);
+		branches->upload();
+		tree_group->add_child(branches);
+	}
+	if (!parts.leaves.empty())
+	{
+		SceneInstances *leaf_instances = new SceneInstances(scene, { base_leaf, leaf_material, ShaderManager::get_default(), glm::mat4(1.0f) });
+		leaf_instances->parts = parts.leaves;
+		leaf_instances->add_instance(instance);
+		leaf_instances->upload();
+		if (animated)
+		{
+			SceneAnimation * anim_node = new SceneAnimation(scene, -3.f, 3.f, 0.f, -0.05f, location + glm::vec3(rng.random(0.75, 1), 0.f, rng.random(0.75, 1)), glm::vec3(0.f, 0.f, 0.f));
+			anim_node->add_child(leaf_instances);
+			tree_group->add_child(anim_node);
+		}
+		else {
+			tree_group->add_child(leaf_instances);
+		}
+	}
 
-	tree_group->add_child(branch_model); //Base of tree BUT IT'S NOT SCALED RIGHT
-	if (animated)
+	return tree_group;
+}
+
+SceneGroup *Tree::generate_forest(Scene *scene, Geometry *base_branch, Geometry *base_leaf, unsigned int num_variants, unsigned int num_iterations, unsigned int leaves, GLfloat angle, GLfloat size, const std::vector<TreeInstance> &trees, Random rng)
+{
+	// A small pool of variants, each only a list of part matrices; every tree is an instance of one of them.
+	// Growing them touches no GL, so all variants grow at once on the job system.
+	std::vector<TreeParts> variants(num_variants);
+	JobSystem::parallel_for(num_variants, 1, [&](unsigned int begin, unsigned int end) {
+		for (unsigned int v = begin; v < end; ++v)
+			grow_variant(variants[v], v, num_iterations, leaves, angle, size, rng);
+	});
+	return assemble_forest(scene, base_branch, base_leaf, variants, trees, rng);
+}
+
+void Tree::grow_variant(TreeParts &parts, unsigned int variant, unsigned int num_iterations, unsigned int leaves, GLfloat angle, GLfloat size, const Random &rng)
+{
+	CacheKey key("tree_variant");
+	key << rng.seed() << rng.stream() << variant << num_iterations << leaves << angle << size;
+	MappedFile file;
+	CacheReader reader;
+	if (ProceduralCache::load(key, file, reader))
 	{
-		SceneAnimation * anim_node = new SceneAnimation(scene, -3.f, 3.f, 0.f, -0.05f, location + glm::vec3(Util::random(0.75, 1), 0.f, Util::random(0.75, 1)), glm::vec3(0.f, 0.f, 0.f));
-		anim_node->add_child(leaf_model);
-		tree_group->add_child(anim_node);
+		reader.read(parts.angle_delta);
+		reader.read(parts.size);
+		reader.read(parts.leaf_layers);
+		reader.read_vector(parts.branches);
+		reader.read_vector(parts.leaves);
+		if (reader.done())
+			return;
 	}
-	else {
-		tree_group->add_child(leaf_model);
+
+	// Variants derive their own streams, so they come out the same whichever thread grows them.
+	Random variant_rng = rng.derive(variant);
+	generate_parts(parts, variant_rng, num_iterations, leaves, angle, size);
+
+	CacheWriter writer;
+	writer.write(parts.angle_delta);
+	writer.write(parts.size);
+	writer.write(parts.leaf_layers);
+	writer.write_vector(parts.branches);
+	writer.write_vector(parts.leaves);
+	ProceduralCache::store(key, writer);
+}
+
+SceneGroup *Tree::assemble_forest(Scene *scene, Geometry *base_branch, Geometry *base_leaf, const std::vector<TreeParts> &variants, const std::vector<TreeInstance> &trees, Random rng)
+{
+	SceneGroup *forest_group = new SceneGroup(scene);
+	std::vector<SceneInstances *> branch_sets, leaf_sets;
+	unsigned int num_variants = (unsigned int) variants.size();
+
+	Material material;
+	for (unsigned int v = 0; v < num_variants; ++v)
+	{
+		SceneInstances *branch_set = nullptr, *leaf_set = nullptr;
+		if (!variants[v].branches.empty())
+		{
+			branch_set = new SceneInstances(scene, { base_branch, material, ShaderManager::get_default(), glm::mat4(1.0f) });
+			branch_set->parts = variants[v].branches;
+			forest_group->add_child(branch_set);
+		}
+		if (!variants[v].leaves.empty())
+		{
+			leaf_set = new SceneInstances(scene, { base_leaf, material, ShaderManager::get_default(), glm::mat4(1.0f) });
+			leaf_set->parts = variants[v].leaves;
+			forest_group->add_child(leaf_set);
+		}
+		branch_sets.push_back(branch_set);
+		leaf_sets.push_back(leaf_set);
+	}
+
+	for (unsigned int i = 0; i < trees.size(); ++i)
+	{
+		const TreeInstance &tree = trees[i];
+		unsigned int v = i % num_variants;
+		if (branch_sets[v])
+			branch_sets[v]->add_instance({ tree.to_world, glm::vec4(tree.branch_color, 1.f), glm::vec4(0.f) });
+		if (leaf_sets[v])
+		{
+			// Leaves used to swing about an axis near the tree's location.
+			glm::vec4 sway(0.f);
+			if (tree.animated)
+				sway = glm::vec4(glm::vec3(tree.to_world[3]) + glm::vec3(rng.random(0.75, 1), 0.f, rng.random(0.75, 1)), SWAY_AMPLITUDE);
+			leaf_sets[v]->add_instance({ tree.to_world, glm::vec4(tree.leaf_color, 1.f), sway });
+		}
+	}
+
+	for (unsigned int v = 0; v < num_variants; ++v)
+	{
+		if (branch_sets[v])
+			branch_sets[v]->upload();
+		if (leaf_sets[v])
+			leaf_sets[v]->upload();
 	}
 
-	int total_iters = (int)(Util::random((float) num_iterations-1, (float) num_iterations+1));
+	return forest_group;
+}
 
-	tree_system(glm::mat4(1.0f), glm::vec3(0.f, 1.0f, 0.f), glm::vec3(0.f, 0.0f, 1.f), 0.f, 0.f, Util::random(SCALE_MIN, SCALE_MAX), 1, total_iters);
+void Tree::generate_parts(TreeParts &parts, Random &rng, unsigned int num_iterations, unsigned int leaves, GLfloat angle, GLfloat size)
+{
+	parts.angle_delta = angle;
+	parts.leaf_layers = leaves;
+	parts.size = size;
+	parts.branches.clear();
+	parts.leaves.clear();
 
-	branch_model->combine_meshes();
-	leaf_model->combine_meshes();
+	int total_iters = (int)(rng.random((float) num_iterations-1, (float) num_iterations+1));
 
-	return tree_group;
+	tree_system(parts, rng, glm::mat4(1.0f), glm::vec3(0.f, 1.0f, 0.f), glm::vec3(0.f, 0.0f, 1.f), 0.f, 0.f, rng.random(SCALE_MIN, SCALE_MAX), 1, total_iters);
 }
 
-void Tree::tree_system(glm::mat4 last_trans, glm::vec3 last_dir, glm::vec3 z_dir, float z_angle, float y_angle, float last_scale, unsigned int curr_iter, unsigned int max_iter)
+void Tree::tree_system(TreeParts &parts, Random &rng, glm::mat4 last_trans, glm::vec3 last_dir, glm::vec3 z_dir, float z_angle, float y_angle, float last_scale, unsigned int curr_iter, unsigned int max_iter)
 {
 	if (curr_iter > max_iter)
 		return;
@@ -66,12 +163,12 @@ void Tree::tree_system(glm::mat4 last_trans, glm::vec3 last_dir, glm::vec3 z_dir
 	float r;
 
 	//Handle Transformations
-	r = (rand() % 2 == 0) ? -1.f : 1.f; //Positive or Negative Angle Change
-	r *= (float)(rand() % 101 / 100.f);
+	r = (rng.below(2) == 0) ? -1.f : 1.f; //Positive or Negative Angle Change
+	r *= (float)(rng.below(101) / 100.f);
 	//fprintf(stderr, "Random: %f\n", r);
 
 	float scale_value_xz = last_scale * 0.8f;
-	float scale_value_y = scale_value_xz * Util::random(0.7f, 1.3f);
+	float scale_value_y = scale_value_xz * rng.random(0.7f, 1.3f);
 
 	if (curr_iter == 0) //Most of the random stuff is kinda just me messing around with numbers.
 	{
@@ -99,7 +196,7 @@ void Tree::tree_system(glm::mat4 last_trans, glm::vec3 last_dir, glm::vec3 z_dir
 	//Rotates around y-axis
 	rot_mat = glm::rotate(glm::mat4(1.f), (y_angle * 2 * glm::pi<float>()) / 180.f, last_dir) * rot_mat;
 
-	glm::vec3 dir = glm::vec3(rot_mat * glm::vec4(0.0f, geo_size * scale_value_y, 0.0f, 1.0f)); //Maybe should divide by fourth element instead	
+	glm::vec3 dir = glm::vec3(rot_mat * glm::vec4(0.0f, parts.size * scale_value_y, 0.0f, 1.0f)); //Maybe should divide by fourth element instead	
 
 	trans_mat = last_trans;
 
@@ -112,28 +209,19 @@ void Tree::tree_system(glm::mat4 last_trans, glm::vec3 last_dir, glm::vec3 z_dir
 
 	z_dir = glm::vec3(combined_mat * glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
 
-	Mesh mesh;
-	if (curr_iter+((int)Util::random(0,2)) < max_iter-leaf_layers)
-	{
-		mesh = branch_mesh;
-		mesh.to_world = combined_mat;
-		branch_model->add_mesh(mesh);
-	}
+	if (curr_iter+((int)rng.random(0,2)) < max_iter-parts.leaf_layers)
+		parts.branches.push_back(combined_mat);
 	else
-	{
-		mesh = leaf_mesh;
-		mesh.to_world = combined_mat;
-		leaf_model->add_mesh(mesh);
-	}
+		parts.leaves.push_back(combined_mat);
 
 	int iter_distr[] = { 3, 3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 5, 5 };
-	int iters = iter_distr[(int)Util::random(0, 13)];
+	int iters = iter_distr[(int)rng.random(0, 13)];
 	// Last two layers only use two iters.
-	if (curr_iter + 1 + leaf_layers == max_iter)
+	if (curr_iter + 1 + parts.leaf_layers == max_iter)
 		iters = 2;
 	for (int i = 0; i < iters; ++i)
 	{
-		float rand_angle_offset = Util::random(0.f, 5.f);
-		tree_system(trans_mat, dir, z_dir, z_angle + angle_delta, y_angle + i*(180.f / iters) + rand_angle_offset, scale_value_xz, curr_iter + 1, max_iter);
+		float rand_angle_offset = rng.random(0.f, 5.f);
+		tree_system(parts, rng, trans_mat, dir, z_dir, z_angle + parts.angle_delta, y_angle + i*(180.f / iters) + rand_angle_offset, scale_value_xz, curr_iter + 1, max_iter);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "uniform_blocks.h"
+
+GLuint UniformBlocks::per_frame_ubo;
+GLuint UniformBlocks::per_view_ubo;
+
+void UniformBlocks::init()
+{
+	glGenBuffers(1, &per_frame_ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, per_frame_ubo);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(PerFrameBlock), NULL, GL_DYNAMIC_DRAW);
+
+	glGenBuffers(1, &per_view_ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, per_view_ubo);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(PerViewBlock), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	// Bound once; later updates only rewrite the contents.
+	glBindBufferBase(GL_UNIFORM_BUFFER, PER_FRAME_BINDING, per_frame_ubo);
+	glBindBufferBase(GL_UNIFORM_BUFFER, PER_VIEW_BINDING, per_view_ubo);
+}
+
+void UniformBlocks::destroy()
+{
+	glDeleteBuffers(1, &per_frame_ubo);
+	glDeleteBuffers(1, &per_view_ubo);
+}
+
+void UniformBlocks::bind_program(GLuint shader_id)
+{
+	// Programs that don't declare a block simply skip it.
+	GLuint index = glGetUniformBlockIndex(shader_id, "PerFrame");
+	if (index != GL_INVALID_INDEX)
+		glUniformBlockBinding(shader_id, index, PER_FRAME_BINDING);
+	index = glGetUniformBlockIndex(shader_id, "PerView");
+	if (index != GL_INVALID_INDEX)
+		glUniformBlockBinding(shader_id, index, PER_VIEW_BINDING);
+}
+
+void UniformBlocks::update_frame(glm::mat4 light_matrix, glm::vec3 light_direction, glm::vec3 light_color, GLfloat ambient_coeff, GLfloat time)
+{
+	PerFrameBlock block;
+	block.light_matrix = light_matrix;
+	block.light_direction = glm::vec4(light_direction, 0.f);
+	block.light_color = glm::vec4(light_color, ambient_coeff);
+	block.time = glm::vec4(time, 0.f, 0.f, 0.f);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, per_frame_ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(PerFrameBlock), &block);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBlocks::update_view(glm::mat4 V, glm::mat4 P, glm::vec3 eye_pos)
+{
+	PerViewBlock block;
+	block.projection = P;
+	block.view = V;
+	block.eye_pos = glm::vec4(eye_pos, 1.f);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, per_view_ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(PerViewBlock), &block);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,76 @@
+#include "upload_queue.h"
+#include "geometry.h"
+#include "resource_loader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+std::mutex upload_mutex;
+std::deque<Geometry *> uploads;
+// Counter of the innermost Batch on this thread.
+thread_local std::atomic<unsigned int> *current_batch = nullptr;
+
+void UploadQueue::push(Geometry *g)
+{
+	g->compute_bounds();
+	if (current_batch && !g->batch)
+	{
+		g->batch = current_batch;
+		++*current_batch;
+	}
+	std::lock_guard<std::mutex> lock(upload_mutex);
+	uploads.push_back(g);
+}
+
+void UploadQueue::cancel(Geometry *g)
+{
+	std::lock_guard<std::mutex> lock(upload_mutex);
+	uploads.erase(std::remove(uploads.begin(), uploads.end(), g), uploads.end());
+}
+
+size_t UploadQueue::process(double budget)
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+	do
+	{
+		Geometry *g;
+		{
+			std::lock_guard<std::mutex> lock(upload_mutex);
+			if (uploads.empty())
+				return 0;
+			g = uploads.front();
+			uploads.pop_front();
+		}
+		if (ResourceLoader::running())
+			g->upload_async();
+		else
+			g->upload();
+	} while (std::chrono::duration<double>(Clock::now() - start).count() < budget);
+	return pending();
+}
+
+void UploadQueue::flush()
+{
+	while (process(1.0) > 0);
+	ResourceLoader::flush();
+}
+
+size_t UploadQueue::pending()
+{
+	std::lock_guard<std::mutex> lock(upload_mutex);
+	return uploads.size();
+}
+
+UploadQueue::Batch::Batch(std::atomic<unsigned int> &pending) :
+	previous(current_batch)
+{
+	current_batch = &pending;
+}
+
+UploadQueue::Batch::~Batch()
+{
+	current_batch = previous;
+}
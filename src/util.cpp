@@ -1,8 +1,10 @@
 #include "util.h"
+#include "gl_state.h"
 #include <time.h>
 
 GLuint Util::quadVAO;
 GLuint Util::quadVBO;
+Random Util::world_random;
 
 void Util::print_vec3(glm::vec3 v)
 {
@@ -122,7 +124,7 @@ void Util::render_quad()
 		// Setup plane VAO
 		glGenVertexArrays(1, &quadVAO);
 		glGenBuffers(1, &quadVBO);
-		glBindVertexArray(quadVAO);
+		GLState::bind_vertex_array(quadVAO);
 		glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
 		glEnableVertexAttribArray(0);
@@ -130,25 +132,25 @@ void Util::render_quad()
 		glEnableVertexAttribArray(1);
 		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
 	}
-	glBindVertexArray(quadVAO);
+	GLState::bind_vertex_array(quadVAO);
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	glBindVertexArray(0);
 }
 
 void Util::seed(unsigned int s)
 {
 	if (s == 0)
-		srand((unsigned int)time(NULL));
-	else
-		srand(s);
+		s = (unsigned int)time(NULL);
+	world_random = Random(s);
 }
 
 float Util::random(float min, float max)
 {
-	float random = ((float)rand()) / (float)(RAND_MAX + 1);
-	float diff = max - min;
-	float r = random * diff;
-	return min + r;
+	return world_random.random(min, max);
+}
+
+Random Util::stream()
+{
+	return world_random.fork();
 }
 
 bool Util::within_rect(glm::vec2 pos, glm::vec2 bottom_left, glm::vec2 top_right)
@@ -0,0 +1,45 @@
+#include "vertex_format.h"
+
+#include <algorithm>
+
+// Half floats round to within 1/2048 of a value's magnitude.
+const GLfloat HALF_PRECISION = 1.f / 2048.f;
+// Largest rounding error allowed, as a fraction of the mesh's size and in world units.
+const GLfloat POSITION_TOLERANCE = 1.f / 1024.f;
+const GLfloat MAX_POSITION_ERROR = 1.f / 64.f;
+// Texture coordinates may move by this much, about a texel of a 1024 texture.
+const GLfloat TEX_COORD_TOLERANCE = 1.f / 1024.f;
+
+// Normals are always packed; 10 bits per axis is finer than any lighting here shows.
+typedef VertexLayout<FloatPosition, PackedNormal, FloatTexCoord> FloatLayout;
+typedef VertexLayout<FloatPosition, PackedNormal, HalfTexCoord> FloatPositionLayout;
+typedef VertexLayout<HalfPosition, PackedNormal, FloatTexCoord> FloatTexCoordLayout;
+typedef VertexLayout<HalfPosition, PackedNormal, HalfTexCoord> HalfLayout;
+
+const VertexFormat *VertexFormat::choose(const MeshData &data)
+{
+	// Meshes modelled far from their own origin lose too much in halves.
+	GLfloat max_position = 0.f;
+	glm::vec3 low = data.vertices.empty() ? glm::vec3(0.f) : data.vertices[0];
+	glm::vec3 high = low;
+	for (const glm::vec3 &v : data.vertices)
+	{
+		max_position = std::max(max_position, glm::max(glm::abs(v.x), glm::max(glm::abs(v.y), glm::abs(v.z))));
+		low = glm::min(low, v);
+		high = glm::max(high, v);
+	}
+	glm::vec3 extent = high - low;
+	GLfloat size = glm::max(extent.x, glm::max(extent.y, extent.z));
+	GLfloat position_error = max_position * HALF_PRECISION;
+	bool half_positions = position_error <= size * POSITION_TOLERANCE && position_error <= MAX_POSITION_ERROR;
+
+	GLfloat max_tex_coord = 0.f;
+	if (data.has_texture)
+		for (const glm::vec2 &t : data.tex_coords)
+			max_tex_coord = std::max(max_tex_coord, glm::max(glm::abs(t.x), glm::abs(t.y)));
+	bool half_tex_coords = max_tex_coord * HALF_PRECISION <= TEX_COORD_TOLERANCE;
+
+	if (half_positions)
+		return half_tex_coords ? HalfLayout::format() : FloatTexCoordLayout::format();
+	return half_tex_coords ? FloatPositionLayout::format() : FloatLayout::format();
+}